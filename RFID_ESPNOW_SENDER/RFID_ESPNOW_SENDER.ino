@@ -7,6 +7,11 @@
 #define RST_PIN 0
 #define RXp2 16 //  RX pin for Serial2
 #define TXp2 17 // TX pin for Serial2
+#define WAKE_PREAMBLE_DELAY_MS 10 // time the player needs to come out of light sleep
+#define POLL_INTERVAL_MS       50 // how often the reader checks for a card
+#define REMOVE_AFTER_MISSES    4  // polls without an answer before a card counts as removed
+#define SEND_REMOVAL_EVENTS    false // also report "OFF:" when a card is taken away
+#define ESPNOW_MAX_ATTEMPTS    4  // a failed frame is resent on the next polls, one poll apart
 
 MFRC522 rfid(SS_PIN, RST_PIN); // Instance of the MFRC522 class
 MFRC522::MIFARE_Key key;
@@ -14,6 +19,101 @@ MFRC522::MIFARE_Key key;
 // ESP-NOW peer address
 uint8_t peer_mac[6] = {0x40, 0x4C, 0xCA, 0x51, 0x3A, 0xB0};
 
+// Card currently on the reader, a placement is reported once no matter how long it stays
+byte present_uid[10];
+byte present_len = 0;
+byte misses = 0;
+
+// Last ESP-NOW message, kept until the peer has acknowledged it
+char espnow_msg[4 + 3 * sizeof(present_uid) + 1];
+size_t espnow_len = 0;
+byte espnow_attempts = 0;
+volatile bool espnow_in_flight = false;
+volatile bool espnow_failed = false;
+
+// Runs on the Wi-Fi task once the peer has acked the frame or all MAC retries failed
+void on_espnow_sent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+  espnow_failed = status != ESP_NOW_SEND_SUCCESS;
+  espnow_in_flight = false;
+}
+
+void espnow_transmit() {
+  espnow_attempts++;
+  espnow_in_flight = true;
+  espnow_failed = false;
+  if (esp_now_send(peer_mac, (uint8_t *)espnow_msg, espnow_len) != ESP_OK) {
+    espnow_in_flight = false;
+    espnow_failed = true;
+  }
+}
+
+// A newer message replaces one still being retried, only the latest card matters
+void espnow_start(const char *msg, size_t len) {
+  memcpy(espnow_msg, msg, len);
+  espnow_len = len;
+  espnow_attempts = 0;
+  espnow_transmit();
+}
+
+// Resend only what failed
+void espnow_service() {
+  if (espnow_in_flight || !espnow_failed || espnow_attempts == 0) {
+    return;
+  }
+  if (espnow_attempts >= ESPNOW_MAX_ATTEMPTS) {
+    Serial.println("ESP-NOW delivery failed");
+    espnow_attempts = 0;
+    return;
+  }
+  espnow_transmit();
+}
+
+// Send "<prefix> 33 A4 1F 0B" to the player over UART and to the LED node over ESP-NOW
+void send_uid(const char *prefix, const byte *uid, byte uid_len) {
+  // Same format as uid_format_hex() in components/uid_codec. MFRC522 UIDs are at most 10 bytes.
+  char formatted_uid[3 * sizeof(present_uid) + 1];
+  size_t formatted_len = 0;
+  formatted_uid[0] = '\0'; // Start with an empty string
+  for (byte i = 0; i < uid_len && i < sizeof(present_uid); i++) {
+    formatted_len += snprintf(formatted_uid + formatted_len, sizeof(formatted_uid) - formatted_len,
+                              " %02X", uid[i]);
+  }
+  Serial.print(prefix);
+  Serial.println(formatted_uid);
+
+  // The player may be in light sleep, and the bytes that wake it are lost.
+  // Send a throwaway line of 0x55 (lots of edges) and give it time to wake up.
+  Serial2.print("UUUU\n");
+  Serial2.flush();
+  delay(WAKE_PREAMBLE_DELAY_MS);
+  Serial2.print(prefix);
+  Serial2.println(formatted_uid);
+
+  // The LED node takes the bare UID, other messages carry their prefix
+  char msg[sizeof(espnow_msg)];
+  int len = snprintf(msg, sizeof(msg), "%s%s", strcmp(prefix, "UID:") == 0 ? "" : prefix, formatted_uid);
+  espnow_start(msg, len);
+}
+
+// Look for a card, including one that was halted after an earlier read
+bool read_card(byte *uid, byte *uid_len) {
+  byte atqa[2];
+  byte atqa_size = sizeof(atqa);
+  // WUPA, unlike the REQA of PICC_IsNewCardPresent(), also wakes halted cards, so one left on the reader stays visible
+  MFRC522::StatusCode status = rfid.PICC_WakeupA(atqa, &atqa_size);
+  if ((status != MFRC522::STATUS_OK && status != MFRC522::STATUS_COLLISION) || !rfid.PICC_ReadCardSerial()) {
+    return false;
+  }
+  *uid_len = min((byte)rfid.uid.size, (byte)sizeof(present_uid));
+  memcpy(uid, rfid.uid.uidByte, *uid_len);
+
+  // Halt PICC
+  rfid.PICC_HaltA();
+  // Stop encryption on PCD
+  rfid.PCD_StopCrypto1();
+  return true;
+}
+
 void setup() {
   Serial.begin(115200);
   Serial2.begin(115200, SERIAL_8N1, RXp2, TXp2); // Initialize Serial2 communication
@@ -32,6 +132,7 @@ void setup() {
     Serial.println("Error initializing ESP-NOW");
     return;
   }
+  esp_now_register_send_cb(on_espnow_sent);
 
   // Add the peer to ESP-NOW
   esp_now_peer_info_t peer_info = {};
@@ -44,42 +145,25 @@ void setup() {
 
 
 void loop() {
-  if (rfid.PICC_IsNewCardPresent() && rfid.PICC_ReadCardSerial()) {
-    // Print UID to Serial (for logging)
-    Serial.print("UID:");
-    for (byte i = 0; i < rfid.uid.size; i++) {
-      Serial.print(rfid.uid.uidByte[i] < 0x10 ? " 0" : " ");
-      Serial.print(rfid.uid.uidByte[i], HEX);
+  espnow_service();
+
+  byte uid[sizeof(present_uid)];
+  byte uid_len;
+  if (read_card(uid, &uid_len)) {
+    misses = 0;
+    if (uid_len != present_len || memcmp(uid, present_uid, uid_len) != 0) {
+      // A new placement, or a different card swapped in without a gap
+      memcpy(present_uid, uid, uid_len);
+      present_len = uid_len;
+      send_uid("UID:", uid, uid_len);
     }
-    Serial.println();
-
-    // Print UID to Serial2 (for communication with external device)
-    Serial2.print("UID:");
-    for (byte i = 0; i < rfid.uid.size; i++) {
-        Serial2.print(rfid.uid.uidByte[i] < 0x10 ? " 0" : " ");
-        Serial2.print(rfid.uid.uidByte[i], HEX);
-    }
-    Serial2.println();
-
-    // Prepare the UID with spaces before each byte
-    char formatted_uid[20]; // Assuming a maximum UID size of 8 bytes
-    formatted_uid[0] = '\0'; // Start with an empty string
-    for (byte i = 0; i < rfid.uid.size; i++) {
-      char byte_str[4];
-      sprintf(byte_str, " %02X", rfid.uid.uidByte[i]);
-      strcat(formatted_uid, byte_str);
+  } else if (present_len > 0 && ++misses >= REMOVE_AFTER_MISSES) {
+    if (SEND_REMOVAL_EVENTS) {
+      send_uid("OFF:", present_uid, present_len);
     }
-
-    // Send the formatted UID via ESP-NOW
-    esp_now_send(peer_mac, (uint8_t *)formatted_uid, strlen(formatted_uid));
-    Serial.println(formatted_uid);
-
-
-    // Halt PICC
-    rfid.PICC_HaltA();
-    // Stop encryption on PCD
-    rfid.PCD_StopCrypto1();
+    present_len = 0;
+    misses = 0;
   }
 
-  delay(500);
-}
\ No newline at end of file
+  delay(POLL_INTERVAL_MS);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Binary ESP-NOW frames exchanged between the player and the LED nodes
+ *
+ * Card UIDs from the RFID sender stay plain hex text. Binary frames start with
+ * a magic word that can't be mistaken for hex digits, and are told apart by
+ * magic and length.
+ */
+
+#define ESPNOW_PROTO_PALETTE_MAGIC 0x314C4150 /* "PAL1" little-endian */
+#define ESPNOW_PROTO_PALETTE_MAX   4          /*!< Colors in a palette frame */
+
+/**
+ * @brief Dominant colors of the cover art of what a card started playing
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                              /*!< ESPNOW_PROTO_PALETTE_MAGIC */
+    uint8_t uid[4];                              /*!< Card the palette belongs to */
+    uint8_t count;                               /*!< Colors used, 1 to ESPNOW_PROTO_PALETTE_MAX */
+    uint8_t rgb[ESPNOW_PROTO_PALETTE_MAX][3];    /*!< Most common first */
+    uint8_t weight[ESPNOW_PROTO_PALETTE_MAX];    /*!< Share of the image, 0-255 */
+} espnow_proto_palette_t;
+
+#ifdef __cplusplus
+}
+#endif
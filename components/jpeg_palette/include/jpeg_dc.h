@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Input buffer of the decoder; the whole JPEG never has to be in memory
+ */
+#define JPEG_DC_INPUT_SIZE 256
+
+/**
+ * @brief Largest width or height accepted, bigger images are rejected up front
+ */
+#define JPEG_DC_MAX_DIMENSION 2048
+
+typedef enum {
+    JPEG_DC_OK = 0,
+    JPEG_DC_ERR_TRUNCATED,   /*!< Input ended before the image did */
+    JPEG_DC_ERR_FORMAT,      /*!< Not a well-formed JPEG */
+    JPEG_DC_ERR_UNSUPPORTED, /*!< Progressive, arithmetic coded, CMYK, 12-bit or too large */
+} jpeg_dc_result_t;
+
+/**
+ * @brief Pull more input, return the bytes stored in buf or 0 at the end
+ */
+typedef size_t (*jpeg_dc_read_fn)(void *ctx, uint8_t *buf, size_t len);
+
+/**
+ * @brief Receive the average color of one 8x8 pixel block
+ *
+ * @param bx Block column, 0 to ceil(width / 8) - 1
+ * @param by Block row, 0 to ceil(height / 8) - 1
+ */
+typedef void (*jpeg_dc_block_fn)(void *ctx, uint16_t bx, uint16_t by, const uint8_t rgb[3]);
+
+typedef struct {
+    uint8_t counts[16];   // codes of each length 1..16
+    uint8_t symbols[256];
+    int32_t maxcode[17];  // largest code of each length, -1 if none
+    int16_t valptr[17];   // index into symbols of the first code of each length
+    int32_t mincode[17];
+    uint8_t defined;
+} jpeg_dc_huffman_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;         // sampling factors
+    uint8_t quant;
+    uint8_t dc_table, ac_table;
+    int32_t dc_pred;
+} jpeg_dc_component_t;
+
+/**
+ * @brief Decoder state, about 2 KB; callers own it so no heap is needed
+ */
+typedef struct {
+    jpeg_dc_read_fn read;
+    void *read_ctx;
+    uint8_t input[JPEG_DC_INPUT_SIZE];
+    size_t input_pos;
+    size_t input_len;
+    uint32_t bits;        // bit buffer, next bit is the MSB of the low bit_count bits
+    uint8_t bit_count;
+    uint8_t marker;       // marker hit inside entropy-coded data, 0 if none
+
+    jpeg_dc_huffman_t dc_tables[2];
+    jpeg_dc_huffman_t ac_tables[2];
+    uint16_t quant_dc[4]; // DC entry of each quantization table
+
+    uint16_t width;
+    uint16_t height;
+    uint16_t restart_interval;
+    uint8_t component_count;
+    jpeg_dc_component_t components[3];
+    uint8_t scan_order[3]; // component index of each block in an MCU, as listed in SOS
+} jpeg_dc_decoder_t;
+
+/**
+ * @brief Decode a baseline JPEG at 1/8 scale
+ *
+ * Only the DC coefficient of each block is reconstructed, which is the block's
+ * average color. AC coefficients are entropy-decoded and dropped, so there is
+ * no IDCT and no pixel buffer. One callback is made per 8x8 luma block, left
+ * to right and top to bottom within each MCU.
+ *
+ * @param dec Decoder state, needs no initialization
+ * @param read Input callback
+ * @param read_ctx Passed to read
+ * @param block Output callback
+ * @param block_ctx Passed to block
+ * @param[out] width Image width in pixels, may be NULL
+ * @param[out] height Image height in pixels, may be NULL
+ */
+jpeg_dc_result_t jpeg_dc_decode(jpeg_dc_decoder_t *dec, jpeg_dc_read_fn read, void *read_ctx,
+                                jpeg_dc_block_fn block, void *block_ctx,
+                                uint16_t *width, uint16_t *height);
+
+#ifdef __cplusplus
+}
+#endif
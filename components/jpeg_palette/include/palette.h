@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Most colors palette_extract() returns
+ */
+#define PALETTE_MAX_COLORS 4
+
+/**
+ * @brief Samples kept by the sampler; 3 bytes each
+ */
+#define PALETTE_MAX_SAMPLES 256
+
+typedef struct {
+    uint8_t rgb[3];
+    uint8_t weight; /*!< Share of the image, 0-255 */
+} palette_color_t;
+
+/**
+ * @brief Fixed-size, evenly spread subset of an arbitrarily long color stream
+ *
+ * Keeps every stride-th color offered; whenever the buffer fills, every other
+ * sample is dropped and the stride doubles. The image never has to be held.
+ */
+typedef struct {
+    uint8_t samples[PALETTE_MAX_SAMPLES][3];
+    uint16_t count;
+    uint32_t stride;
+    uint32_t seen;
+} palette_sampler_t;
+
+/**
+ * @brief Empty the sampler
+ */
+void palette_sampler_init(palette_sampler_t *sampler);
+
+/**
+ * @brief Offer one color
+ */
+void palette_sampler_add(palette_sampler_t *sampler, const uint8_t rgb[3]);
+
+/**
+ * @brief Dominant colors of the sampled stream by integer k-means
+ *
+ * @param sampler Samples to cluster
+ * @param[out] colors Most common color first
+ * @param max_colors Capacity of colors, at most PALETTE_MAX_COLORS
+ * @return Number of colors stored; fewer than max_colors if the samples have
+ *         fewer distinct colors, 0 if there are no samples
+ */
+size_t palette_extract(const palette_sampler_t *sampler, palette_color_t *colors, size_t max_colors);
+
+#ifdef __cplusplus
+}
+#endif
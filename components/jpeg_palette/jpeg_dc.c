@@ -0,0 +1,552 @@
+#include <stdbool.h>
+#include <string.h>
+#include "jpeg_dc.h"
+
+#define JPEG_SOF0 0xC0 // baseline
+#define JPEG_SOF1 0xC1 // extended sequential, Huffman; decodes the same at 8 bits
+#define JPEG_DHT  0xC4
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+#define JPEG_SOI  0xD8
+#define JPEG_EOI  0xD9
+#define JPEG_SOS  0xDA
+#define JPEG_DQT  0xDB
+#define JPEG_DRI  0xDD
+
+#define JPEG_MAX_BLOCKS_PER_MCU 10 // limit set by the standard
+
+// Bit reader results below zero
+#define JD_EOF     -1
+#define JD_MARKER  -2
+#define JD_BADCODE -3
+
+static int jd_byte(jpeg_dc_decoder_t *dec)
+{
+    if (dec->input_pos == dec->input_len) {
+        size_t n = dec->read(dec->read_ctx, dec->input, sizeof(dec->input));
+        dec->input_pos = 0;
+        dec->input_len = n < sizeof(dec->input) ? n : sizeof(dec->input);
+        if (dec->input_len == 0) {
+            return JD_EOF;
+        }
+    }
+    return dec->input[dec->input_pos++];
+}
+
+static int jd_u16(jpeg_dc_decoder_t *dec)
+{
+    int hi = jd_byte(dec);
+    int lo = jd_byte(dec);
+    return hi < 0 || lo < 0 ? JD_EOF : (hi << 8) | lo;
+}
+
+#define JD_READ(var, expr)                    \
+    do {                                      \
+        (var) = (expr);                       \
+        if ((var) < 0) {                      \
+            return JPEG_DC_ERR_TRUNCATED;     \
+        }                                     \
+    } while (0)
+
+// Next marker code, skipping fill bytes
+static int jd_next_marker(jpeg_dc_decoder_t *dec)
+{
+    int b;
+    do {
+        b = jd_byte(dec);
+    } while (b >= 0 && b != 0xFF);
+    while (b == 0xFF) {
+        b = jd_byte(dec);
+    }
+    return b;
+}
+
+static jpeg_dc_result_t jd_skip(jpeg_dc_decoder_t *dec, int len)
+{
+    for (int i = 0; i < len; i++) {
+        if (jd_byte(dec) < 0) {
+            return JPEG_DC_ERR_TRUNCATED;
+        }
+    }
+    return JPEG_DC_OK;
+}
+
+static jpeg_dc_result_t jd_parse_dht(jpeg_dc_decoder_t *dec, int len)
+{
+    while (len > 0) {
+        int tcth;
+        JD_READ(tcth, jd_byte(dec));
+        len--;
+        int tc = tcth >> 4;
+        int th = tcth & 15;
+        if (tc > 1) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        if (th > 1) {
+            return JPEG_DC_ERR_UNSUPPORTED; // baseline has two tables of each class
+        }
+        jpeg_dc_huffman_t *t = tc ? &dec->ac_tables[th] : &dec->dc_tables[th];
+
+        int total = 0;
+        for (int i = 0; i < 16; i++) {
+            int n;
+            JD_READ(n, jd_byte(dec));
+            t->counts[i] = n;
+            total += n;
+        }
+        len -= 16;
+        if (total > 256 || total > len) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        for (int i = 0; i < total; i++) {
+            int s;
+            JD_READ(s, jd_byte(dec));
+            t->symbols[i] = s;
+        }
+        len -= total;
+
+        // Canonical code ranges per length, as in ITU T.81 F.2.2.3
+        int32_t code = 0;
+        int k = 0;
+        for (int l = 1; l <= 16; l++) {
+            int n = t->counts[l - 1];
+            if (n > 0) {
+                t->valptr[l] = k;
+                t->mincode[l] = code;
+                code += n;
+                k += n;
+                t->maxcode[l] = code - 1;
+                if (code > (1 << l)) {
+                    return JPEG_DC_ERR_FORMAT; // more codes than fit in l bits
+                }
+            } else {
+                t->maxcode[l] = -1;
+            }
+            code <<= 1;
+        }
+        t->defined = 1;
+    }
+    return len == 0 ? JPEG_DC_OK : JPEG_DC_ERR_FORMAT;
+}
+
+static jpeg_dc_result_t jd_parse_dqt(jpeg_dc_decoder_t *dec, int len, uint8_t *defined)
+{
+    while (len > 0) {
+        int pqtq;
+        JD_READ(pqtq, jd_byte(dec));
+        int precision = pqtq >> 4;
+        int id = pqtq & 15;
+        int size = precision ? 128 : 64;
+        if (precision > 1 || id > 3 || len < 1 + size) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        // Only the first entry, the DC quantizer, is needed
+        int q;
+        JD_READ(q, precision ? jd_u16(dec) : jd_byte(dec));
+        dec->quant_dc[id] = q;
+        *defined |= 1 << id;
+        jpeg_dc_result_t err = jd_skip(dec, size - (precision ? 2 : 1));
+        if (err != JPEG_DC_OK) {
+            return err;
+        }
+        len -= 1 + size;
+    }
+    return JPEG_DC_OK;
+}
+
+static jpeg_dc_result_t jd_parse_sof(jpeg_dc_decoder_t *dec, int len)
+{
+    int precision, count;
+    int height, width;
+    JD_READ(precision, jd_byte(dec));
+    JD_READ(height, jd_u16(dec));
+    JD_READ(width, jd_u16(dec));
+    JD_READ(count, jd_byte(dec));
+    if (len != 6 + 3 * count) {
+        return JPEG_DC_ERR_FORMAT;
+    }
+    if (precision != 8 || (count != 1 && count != 3) ||
+        width > JPEG_DC_MAX_DIMENSION || height > JPEG_DC_MAX_DIMENSION) {
+        return JPEG_DC_ERR_UNSUPPORTED;
+    }
+    if (width == 0 || height == 0) {
+        return JPEG_DC_ERR_FORMAT; // a DNL-defined height isn't worth supporting
+    }
+    dec->width = width;
+    dec->height = height;
+    dec->component_count = count;
+
+    int blocks = 0;
+    for (int i = 0; i < count; i++) {
+        int id, hv, tq;
+        JD_READ(id, jd_byte(dec));
+        JD_READ(hv, jd_byte(dec));
+        JD_READ(tq, jd_byte(dec));
+        int h = hv >> 4;
+        int v = hv & 15;
+        if (h < 1 || h > 4 || v < 1 || v > 4 || tq > 3) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        if (count == 1) {
+            h = v = 1; // a single component is never interleaved, its MCU is one block
+        }
+        dec->components[i].id = id;
+        dec->components[i].h = h;
+        dec->components[i].v = v;
+        dec->components[i].quant = tq;
+        blocks += h * v;
+    }
+    return blocks <= JPEG_MAX_BLOCKS_PER_MCU ? JPEG_DC_OK : JPEG_DC_ERR_FORMAT;
+}
+
+static int jd_bit(jpeg_dc_decoder_t *dec)
+{
+    if (dec->bit_count == 0) {
+        if (dec->marker) {
+            return JD_MARKER;
+        }
+        int b = jd_byte(dec);
+        if (b < 0) {
+            return JD_EOF;
+        }
+        if (b == 0xFF) {
+            int next;
+            do {
+                next = jd_byte(dec);
+            } while (next == 0xFF);
+            if (next < 0) {
+                return JD_EOF;
+            }
+            if (next != 0) {
+                dec->marker = next;
+                return JD_MARKER;
+            }
+        }
+        dec->bits = b;
+        dec->bit_count = 8;
+    }
+    dec->bit_count--;
+    return (dec->bits >> dec->bit_count) & 1;
+}
+
+static int32_t jd_bits(jpeg_dc_decoder_t *dec, int n)
+{
+    int32_t v = 0;
+    for (int i = 0; i < n; i++) {
+        int b = jd_bit(dec);
+        if (b < 0) {
+            return b;
+        }
+        v = (v << 1) | b;
+    }
+    return v;
+}
+
+static int jd_huffman(jpeg_dc_decoder_t *dec, const jpeg_dc_huffman_t *t)
+{
+    int32_t code = 0;
+    for (int l = 1; l <= 16; l++) {
+        int b = jd_bit(dec);
+        if (b < 0) {
+            return b;
+        }
+        code = (code << 1) | b;
+        if (t->maxcode[l] >= 0 && code <= t->maxcode[l]) {
+            int index = t->valptr[l] + code - t->mincode[l];
+            return index >= 0 ? t->symbols[index] : JD_BADCODE;
+        }
+    }
+    return JD_BADCODE;
+}
+
+static jpeg_dc_result_t jd_status(int code)
+{
+    return code == JD_EOF ? JPEG_DC_ERR_TRUNCATED : JPEG_DC_ERR_FORMAT;
+}
+
+// One block: returns the DC difference in *diff and skips the AC coefficients
+static jpeg_dc_result_t jd_decode_block(jpeg_dc_decoder_t *dec, const jpeg_dc_huffman_t *dc,
+                                        const jpeg_dc_huffman_t *ac, int32_t *diff)
+{
+    int s = jd_huffman(dec, dc);
+    if (s < 0) {
+        return jd_status(s);
+    }
+    if (s > 11) {
+        return JPEG_DC_ERR_FORMAT;
+    }
+    *diff = 0;
+    if (s > 0) {
+        int32_t v = jd_bits(dec, s);
+        if (v < 0) {
+            return jd_status(v);
+        }
+        *diff = v < (1 << (s - 1)) ? v - ((1 << s) - 1) : v;
+    }
+
+    for (int k = 1; k < 64;) {
+        int rs = jd_huffman(dec, ac);
+        if (rs < 0) {
+            return jd_status(rs);
+        }
+        int r = rs >> 4;
+        s = rs & 15;
+        if (s == 0) {
+            if (r != 15) {
+                break; // end of block
+            }
+            k += 16;
+            continue;
+        }
+        k += r + 1;
+        int32_t skipped = jd_bits(dec, s);
+        if (skipped < 0) {
+            return jd_status(skipped);
+        }
+    }
+    return JPEG_DC_OK;
+}
+
+static jpeg_dc_result_t jd_restart(jpeg_dc_decoder_t *dec)
+{
+    dec->bit_count = 0;
+    int marker = dec->marker;
+    if (marker == 0) {
+        marker = jd_next_marker(dec);
+        if (marker < 0) {
+            return JPEG_DC_ERR_TRUNCATED;
+        }
+    }
+    if (marker < JPEG_RST0 || marker > JPEG_RST7) {
+        return JPEG_DC_ERR_FORMAT;
+    }
+    dec->marker = 0;
+    for (int c = 0; c < dec->component_count; c++) {
+        dec->components[c].dc_pred = 0;
+    }
+    return JPEG_DC_OK;
+}
+
+static uint8_t jd_clamp(int32_t v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+// Average sample of a block from its dequantized DC coefficient
+static int32_t jd_block_average(int32_t dc, uint16_t quant)
+{
+    int64_t scaled = (int64_t)dc * quant;
+    int64_t mean = scaled >= 0 ? (scaled + 4) / 8 : -((-scaled + 4) / 8);
+    return mean < -128 ? 0 : mean > 127 ? 255 : (int32_t)mean + 128;
+}
+
+static jpeg_dc_result_t jd_decode_scan(jpeg_dc_decoder_t *dec, jpeg_dc_block_fn block, void *block_ctx)
+{
+    int hmax = 1, vmax = 1;
+    for (int c = 0; c < dec->component_count; c++) {
+        hmax = dec->components[c].h > hmax ? dec->components[c].h : hmax;
+        vmax = dec->components[c].v > vmax ? dec->components[c].v : vmax;
+        dec->components[c].dc_pred = 0;
+    }
+    const int mcus_x = (dec->width + 8 * hmax - 1) / (8 * hmax);
+    const int mcus_y = (dec->height + 8 * vmax - 1) / (8 * vmax);
+    const int blocks_x = (dec->width + 7) / 8;
+    const int blocks_y = (dec->height + 7) / 8;
+    // Adobe RGB JPEGs name their components R, G, B and skip the color transform
+    const bool rgb = dec->component_count == 3 && dec->components[0].id == 'R' &&
+                     dec->components[1].id == 'G' && dec->components[2].id == 'B';
+
+    dec->bit_count = 0;
+    dec->marker = 0;
+    uint8_t average[3][16];
+    for (int m = 0; m < mcus_x * mcus_y; m++) {
+        if (dec->restart_interval > 0 && m > 0 && m % dec->restart_interval == 0) {
+            jpeg_dc_result_t err = jd_restart(dec);
+            if (err != JPEG_DC_OK) {
+                return err;
+            }
+        }
+
+        for (int s = 0; s < dec->component_count; s++) {
+            const int c = dec->scan_order[s];
+            jpeg_dc_component_t *comp = &dec->components[c];
+            for (int i = 0; i < comp->h * comp->v; i++) {
+                int32_t diff;
+                jpeg_dc_result_t err = jd_decode_block(dec, &dec->dc_tables[comp->dc_table],
+                                                       &dec->ac_tables[comp->ac_table], &diff);
+                if (err != JPEG_DC_OK) {
+                    return err;
+                }
+                comp->dc_pred += diff;
+                average[c][i] = jd_block_average(comp->dc_pred, dec->quant_dc[comp->quant]);
+            }
+        }
+
+        // One color per luma-sized block, chroma is shared across the blocks it covers
+        int mx = m % mcus_x;
+        int my = m / mcus_x;
+        for (int by = 0; by < vmax; by++) {
+            for (int bx = 0; bx < hmax; bx++) {
+                int x = mx * hmax + bx;
+                int y = my * vmax + by;
+                if (x >= blocks_x || y >= blocks_y) {
+                    continue;
+                }
+                int32_t sample[3];
+                for (int c = 0; c < dec->component_count; c++) {
+                    const jpeg_dc_component_t *comp = &dec->components[c];
+                    sample[c] = average[c][(by * comp->v / vmax) * comp->h + bx * comp->h / hmax];
+                }
+                uint8_t out[3];
+                if (dec->component_count == 1) {
+                    out[0] = out[1] = out[2] = sample[0];
+                } else if (rgb) {
+                    out[0] = sample[0];
+                    out[1] = sample[1];
+                    out[2] = sample[2];
+                } else {
+                    // JFIF YCbCr to RGB in 16.16 fixed point
+                    int32_t cb = sample[1] - 128;
+                    int32_t cr = sample[2] - 128;
+                    out[0] = jd_clamp(sample[0] + ((91881 * cr + 32768) >> 16));
+                    out[1] = jd_clamp(sample[0] - ((22554 * cb + 46802 * cr - 32768) >> 16));
+                    out[2] = jd_clamp(sample[0] + ((116130 * cb + 32768) >> 16));
+                }
+                block(block_ctx, x, y, out);
+            }
+        }
+    }
+    return JPEG_DC_OK;
+}
+
+static jpeg_dc_result_t jd_parse_sos(jpeg_dc_decoder_t *dec, int len, uint8_t quant_defined)
+{
+    int count;
+    JD_READ(count, jd_byte(dec));
+    if (dec->component_count == 0) {
+        return JPEG_DC_ERR_FORMAT; // scan before frame header
+    }
+    if (count != dec->component_count) {
+        return JPEG_DC_ERR_UNSUPPORTED; // non-interleaved scans
+    }
+    if (len != 4 + 2 * count) {
+        return JPEG_DC_ERR_FORMAT;
+    }
+    uint8_t seen = 0;
+    for (int i = 0; i < count; i++) {
+        int id, tables;
+        JD_READ(id, jd_byte(dec));
+        JD_READ(tables, jd_byte(dec));
+        int c = 0;
+        while (c < dec->component_count && dec->components[c].id != id) {
+            c++;
+        }
+        if (c == dec->component_count || (seen & (1 << c))) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        seen |= 1 << c;
+        dec->scan_order[i] = c;
+        int td = tables >> 4;
+        int ta = tables & 15;
+        if (td > 1 || ta > 1) {
+            return JPEG_DC_ERR_UNSUPPORTED;
+        }
+        if (!dec->dc_tables[td].defined || !dec->ac_tables[ta].defined ||
+            !(quant_defined & (1 << dec->components[c].quant))) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        dec->components[c].dc_table = td;
+        dec->components[c].ac_table = ta;
+    }
+    int ss, se, a;
+    JD_READ(ss, jd_byte(dec));
+    JD_READ(se, jd_byte(dec));
+    JD_READ(a, jd_byte(dec));
+    if (ss != 0 || se != 63 || a != 0) {
+        return JPEG_DC_ERR_UNSUPPORTED;
+    }
+    return JPEG_DC_OK;
+}
+
+jpeg_dc_result_t jpeg_dc_decode(jpeg_dc_decoder_t *dec, jpeg_dc_read_fn read, void *read_ctx,
+                                jpeg_dc_block_fn block, void *block_ctx,
+                                uint16_t *width, uint16_t *height)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->read = read;
+    dec->read_ctx = read_ctx;
+
+    int b0 = jd_byte(dec);
+    int b1 = jd_byte(dec);
+    if (b0 < 0 || b1 < 0) {
+        return JPEG_DC_ERR_TRUNCATED;
+    }
+    if (b0 != 0xFF || b1 != JPEG_SOI) {
+        return JPEG_DC_ERR_FORMAT;
+    }
+
+    uint8_t quant_defined = 0;
+    while (1) {
+        int marker = jd_next_marker(dec);
+        if (marker < 0) {
+            return JPEG_DC_ERR_TRUNCATED;
+        }
+        if (marker == JPEG_EOI) {
+            return JPEG_DC_ERR_FORMAT; // no image data
+        }
+        if (marker == 0 || marker == 0x01 || (marker >= JPEG_RST0 && marker <= JPEG_RST7)) {
+            continue; // standalone markers
+        }
+        int len;
+        JD_READ(len, jd_u16(dec));
+        if (len < 2) {
+            return JPEG_DC_ERR_FORMAT;
+        }
+        len -= 2;
+
+        jpeg_dc_result_t err;
+        switch (marker) {
+            case JPEG_SOF0:
+            case JPEG_SOF1:
+                err = jd_parse_sof(dec, len);
+                break;
+            case JPEG_DHT:
+                err = jd_parse_dht(dec, len);
+                break;
+            case JPEG_DQT:
+                err = jd_parse_dqt(dec, len, &quant_defined);
+                break;
+            case JPEG_DRI:
+                if (len != 2) {
+                    return JPEG_DC_ERR_FORMAT;
+                }
+                int interval;
+                JD_READ(interval, jd_u16(dec));
+                dec->restart_interval = interval;
+                err = JPEG_DC_OK;
+                break;
+            case JPEG_SOS:
+                err = jd_parse_sos(dec, len, quant_defined);
+                if (err == JPEG_DC_OK) {
+                    if (width != NULL) {
+                        *width = dec->width;
+                    }
+                    if (height != NULL) {
+                        *height = dec->height;
+                    }
+                    // Everything after the first scan is of no interest
+                    return jd_decode_scan(dec, block, block_ctx);
+                }
+                break;
+            default:
+                if (marker >= 0xC2 && marker <= 0xCF) {
+                    return JPEG_DC_ERR_UNSUPPORTED; // progressive, lossless, arithmetic coding
+                }
+                err = jd_skip(dec, len); // APPn, COM and the like
+                break;
+        }
+        if (err != JPEG_DC_OK) {
+            return err;
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#include <string.h>
+#include "palette.h"
+
+#define PALETTE_ITERATIONS 10
+
+void palette_sampler_init(palette_sampler_t *sampler)
+{
+    sampler->count = 0;
+    sampler->stride = 1;
+    sampler->seen = 0;
+}
+
+void palette_sampler_add(palette_sampler_t *sampler, const uint8_t rgb[3])
+{
+    if (sampler->seen++ % sampler->stride != 0) {
+        return;
+    }
+    if (sampler->count == PALETTE_MAX_SAMPLES) {
+        for (int i = 0; i < PALETTE_MAX_SAMPLES / 2; i++) {
+            memcpy(sampler->samples[i], sampler->samples[2 * i], 3);
+        }
+        sampler->count = PALETTE_MAX_SAMPLES / 2;
+        sampler->stride *= 2;
+        // The color just offered sits at an odd multiple of the old stride
+        if ((sampler->seen - 1) % sampler->stride != 0) {
+            return;
+        }
+    }
+    memcpy(sampler->samples[sampler->count++], rgb, 3);
+}
+
+static int32_t palette_distance(const uint8_t a[3], const int32_t b[3])
+{
+    int32_t dr = a[0] - b[0];
+    int32_t dg = a[1] - b[1];
+    int32_t db = a[2] - b[2];
+    return dr * dr + dg * dg + db * db;
+}
+
+static int palette_nearest(const uint8_t rgb[3], int32_t centers[][3], size_t k, int32_t *distance)
+{
+    int best = 0;
+    int32_t best_distance = INT32_MAX;
+    for (size_t c = 0; c < k; c++) {
+        int32_t d = palette_distance(rgb, centers[c]);
+        if (d < best_distance) {
+            best_distance = d;
+            best = c;
+        }
+    }
+    if (distance != NULL) {
+        *distance = best_distance;
+    }
+    return best;
+}
+
+size_t palette_extract(const palette_sampler_t *sampler, palette_color_t *colors, size_t max_colors)
+{
+    const size_t n = sampler->count;
+    if (n == 0 || max_colors == 0) {
+        return 0;
+    }
+    if (max_colors > PALETTE_MAX_COLORS) {
+        max_colors = PALETTE_MAX_COLORS;
+    }
+
+    // Maximin seeding: start at the sample furthest from the mean, then keep
+    // adding whichever sample is furthest from every center so far
+    int32_t centers[PALETTE_MAX_COLORS][3];
+    int32_t mean[3] = {0, 0, 0};
+    for (size_t i = 0; i < n; i++) {
+        for (int ch = 0; ch < 3; ch++) {
+            mean[ch] += sampler->samples[i][ch];
+        }
+    }
+    for (int ch = 0; ch < 3; ch++) {
+        mean[ch] /= (int32_t)n;
+    }
+    size_t k = 0;
+    while (k < max_colors) {
+        size_t far = 0;
+        int32_t far_distance = -1;
+        for (size_t i = 0; i < n; i++) {
+            int32_t d;
+            if (k == 0) {
+                d = palette_distance(sampler->samples[i], mean);
+            } else {
+                palette_nearest(sampler->samples[i], centers, k, &d);
+            }
+            if (d > far_distance) {
+                far_distance = d;
+                far = i;
+            }
+        }
+        if (k > 0 && far_distance == 0) {
+            break; // fewer distinct colors than requested
+        }
+        for (int ch = 0; ch < 3; ch++) {
+            centers[k][ch] = sampler->samples[far][ch];
+        }
+        k++;
+    }
+
+    uint16_t counts[PALETTE_MAX_COLORS];
+    for (int iteration = 0; iteration < PALETTE_ITERATIONS; iteration++) {
+        int32_t sums[PALETTE_MAX_COLORS][3];
+        memset(sums, 0, sizeof(sums));
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++) {
+            int c = palette_nearest(sampler->samples[i], centers, k, NULL);
+            counts[c]++;
+            for (int ch = 0; ch < 3; ch++) {
+                sums[c][ch] += sampler->samples[i][ch];
+            }
+        }
+        int moved = 0;
+        for (size_t c = 0; c < k; c++) {
+            if (counts[c] == 0) {
+                continue;
+            }
+            for (int ch = 0; ch < 3; ch++) {
+                int32_t center = (sums[c][ch] + counts[c] / 2) / counts[c];
+                moved |= center != centers[c][ch];
+                centers[c][ch] = center;
+            }
+        }
+        if (!moved) {
+            break;
+        }
+    }
+
+    // Most common first; k is tiny so insertion order by count is enough
+    size_t out = 0;
+    for (size_t c = 0; c < k; c++) {
+        if (counts[c] == 0) {
+            continue;
+        }
+        size_t pos = out++;
+        while (pos > 0 && colors[pos - 1].weight < counts[c] * 255 / n) {
+            colors[pos] = colors[pos - 1];
+            pos--;
+        }
+        for (int ch = 0; ch < 3; ch++) {
+            colors[pos].rgb[ch] = centers[c][ch];
+        }
+        colors[pos].weight = counts[c] * 255 / n;
+    }
+    return out;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Number of histogram buckets: four per power of two up to 2^28 us (~4.5 min)
+ */
+#define LATENCY_STATS_BUCKETS 108
+
+/**
+ * @brief Latency accumulator with a log-linear histogram for percentiles
+ *
+ * Percentiles are accurate to within 25% of the value, which is plenty for
+ * telling a 5 ms wake from a 300 ms one. Not thread-safe; callers that share
+ * one accumulator between tasks must lock around it.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t last_us;
+    uint64_t sum_us;
+    uint32_t buckets[LATENCY_STATS_BUCKETS];
+} latency_stats_t;
+
+/**
+ * @brief Clear all samples
+ */
+void latency_stats_reset(latency_stats_t *stats);
+
+/**
+ * @brief Add one sample
+ */
+void latency_stats_add(latency_stats_t *stats, uint32_t latency_us);
+
+/**
+ * @brief Mean of all samples, 0 if there are none
+ */
+uint32_t latency_stats_mean(const latency_stats_t *stats);
+
+/**
+ * @brief Latency below which the given share of samples fall
+ *
+ * @param[in] stats Accumulator
+ * @param[in] percent Percentile, 0-100
+ * @return Upper bound of the bucket holding the percentile, clamped to the
+ *         observed min and max; 0 if there are no samples
+ */
+uint32_t latency_stats_percentile(const latency_stats_t *stats, uint32_t percent);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,76 @@
+#include <string.h>
+#include "latency_stats.h"
+
+#define LATENCY_STATS_SUB_BITS 2 // 4 buckets per power of two
+
+static uint32_t latency_stats_bucket(uint32_t value)
+{
+    if (value < (1u << LATENCY_STATS_SUB_BITS)) {
+        return value;
+    }
+    uint32_t msb = 31 - __builtin_clz(value);
+    uint32_t sub = (value >> (msb - LATENCY_STATS_SUB_BITS)) & ((1u << LATENCY_STATS_SUB_BITS) - 1);
+    uint32_t bucket = ((msb - LATENCY_STATS_SUB_BITS + 1) << LATENCY_STATS_SUB_BITS) + sub;
+    return bucket < LATENCY_STATS_BUCKETS ? bucket : LATENCY_STATS_BUCKETS - 1;
+}
+
+// Largest value that lands in the bucket
+static uint32_t latency_stats_bucket_max(uint32_t bucket)
+{
+    if (bucket < (1u << LATENCY_STATS_SUB_BITS)) {
+        return bucket;
+    }
+    uint32_t shift = (bucket >> LATENCY_STATS_SUB_BITS) - 1;
+    uint32_t sub = bucket & ((1u << LATENCY_STATS_SUB_BITS) - 1);
+    uint32_t low = ((1u << LATENCY_STATS_SUB_BITS) + sub) << shift;
+    return low + (1u << shift) - 1;
+}
+
+void latency_stats_reset(latency_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+void latency_stats_add(latency_stats_t *stats, uint32_t latency_us)
+{
+    if (stats->count == 0 || latency_us < stats->min_us) {
+        stats->min_us = latency_us;
+    }
+    if (latency_us > stats->max_us) {
+        stats->max_us = latency_us;
+    }
+    stats->last_us = latency_us;
+    stats->sum_us += latency_us;
+    stats->count++;
+    stats->buckets[latency_stats_bucket(latency_us)]++;
+}
+
+uint32_t latency_stats_mean(const latency_stats_t *stats)
+{
+    return stats->count ? (uint32_t)(stats->sum_us / stats->count) : 0;
+}
+
+uint32_t latency_stats_percentile(const latency_stats_t *stats, uint32_t percent)
+{
+    if (stats->count == 0) {
+        return 0;
+    }
+    // Rank of the sample we're after, rounded up so p100 is the last sample
+    uint64_t rank = ((uint64_t)stats->count * percent + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_STATS_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= rank) {
+            // The last bucket is open ended
+            uint32_t value = i < LATENCY_STATS_BUCKETS - 1 ? latency_stats_bucket_max(i) : stats->max_us;
+            if (value > stats->max_us) {
+                value = stats->max_us;
+            }
+            return value < stats->min_us ? stats->min_us : value;
+        }
+    }
+    return stats->max_us;
+}
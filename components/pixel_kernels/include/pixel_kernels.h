@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Integer pixel kernels on packed 32-bit words.
+ *
+ * A pixel is one word, 0x00RRGGBB, or 0xWWRRGGBB once it has a white
+ * channel. The ESP32-C6 has no packed-SIMD extension, so the kernels keep
+ * several channels in one register and mask them apart (SWAR): a scale or a
+ * blend costs two multiplies per word instead of one per channel, and a
+ * saturating add needs no multiply or branch at all. Every lane is treated
+ * the same, so the word kernels work on any four bytes, not only on pixels.
+ */
+
+#define PIXEL_LANES_EVEN 0x00FF00FFu /*!< Bytes 0 and 2 of a word, spread into 16-bit lanes */
+#define PIXEL_LANES_ODD  0xFF00FF00u /*!< Bytes 1 and 3 of a word */
+
+/**
+ * @brief Pack R, G, B bytes into 0x00RRGGBB
+ */
+static inline uint32_t pixel_pack(const uint8_t rgb[3])
+{
+    return ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+}
+
+/**
+ * @brief Unpack 0x00RRGGBB into R, G, B bytes
+ */
+static inline void pixel_unpack(uint32_t px, uint8_t rgb[3])
+{
+    rgb[0] = (uint8_t)(px >> 16);
+    rgb[1] = (uint8_t)(px >> 8);
+    rgb[2] = (uint8_t)px;
+}
+
+/**
+ * @brief Scale every byte by (scale + 1) / 256, the strip's global brightness
+ *
+ * Matches (byte * (scale + 1)) >> 8 exactly; 255 leaves the word as it is.
+ */
+static inline uint32_t pixel_scale(uint32_t px, uint8_t scale)
+{
+    uint32_t gain = (uint32_t)scale + 1;
+    uint32_t even = ((px & PIXEL_LANES_EVEN) * gain) >> 8;
+    uint32_t odd = ((px >> 8) & PIXEL_LANES_EVEN) * gain;
+    return (even & PIXEL_LANES_EVEN) | (odd & PIXEL_LANES_ODD);
+}
+
+/**
+ * @brief Add two words byte by byte, clamping each byte at 255
+ */
+static inline uint32_t pixel_add_sat(uint32_t a, uint32_t b)
+{
+    // Add the low 7 bits of every byte, then put the top bits back in without carries
+    uint32_t sum = (a & 0x7F7F7F7Fu) + (b & 0x7F7F7F7Fu);
+    uint32_t top = (a ^ b) & 0x80808080u;
+    uint32_t carry = ((a & b) | (top & sum)) & 0x80808080u;
+    // A carry out of a byte turns that whole byte into 0xFF
+    return (sum ^ top) | ((carry >> 7) * 0xFF);
+}
+
+/**
+ * @brief Blend two words byte by byte, weight 0 gives a and 256 gives b
+ *
+ * Each byte is (a * (256 - weight) + b * weight + 128) >> 8, rounded to nearest.
+ */
+static inline uint32_t pixel_blend(uint32_t a, uint32_t b, uint32_t weight)
+{
+    uint32_t keep = 256 - weight;
+    // Both products of a lane fit 16 bits together: 255 * 256 + 128 < 65536
+    uint32_t even = ((a & PIXEL_LANES_EVEN) * keep + (b & PIXEL_LANES_EVEN) * weight + 0x00800080u) >> 8;
+    uint32_t odd = ((a >> 8) & PIXEL_LANES_EVEN) * keep + ((b >> 8) & PIXEL_LANES_EVEN) * weight + 0x00800080u;
+    return (even & PIXEL_LANES_EVEN) | (odd & PIXEL_LANES_ODD);
+}
+
+/**
+ * @brief Reorder 0x00RRGGBB into 0x00GGRRBB, the byte order of WS2812 strips
+ */
+static inline uint32_t pixel_rgb_to_grb(uint32_t px)
+{
+    return ((px >> 8) & 0x00FF00u) | ((px << 8) & 0xFF0000u) | (px & 0x0000FFu);
+}
+
+/**
+ * @brief Move the common part of R, G and B to a white channel, 0x00RRGGBB into 0xWWRRGGBB
+ *
+ * For RGBW strips: white is the smallest of the three channels and is taken
+ * off each of them, so the light output stays the same.
+ */
+static inline uint32_t pixel_rgb_to_rgbw(uint32_t px)
+{
+    uint32_t r = (px >> 16) & 0xFF;
+    uint32_t g = (px >> 8) & 0xFF;
+    uint32_t b = px & 0xFF;
+    uint32_t w = r < g ? r : g;
+    w = w < b ? w : b;
+    // No byte borrows, w is at most each of them
+    return (w << 24) | ((px & 0x00FFFFFFu) - w * 0x010101u);
+}
+
+/**
+ * @brief Fill a strip buffer with one color, count pixels of 3 bytes each in G, R, B order
+ *
+ * @param[out] out Buffer of count * 3 bytes, no alignment needed
+ * @param[in] count Pixels to fill
+ * @param[in] rgb Color, 0x00RRGGBB
+ */
+void pixel_fill_grb(uint8_t *out, size_t count, uint32_t rgb);
+
+/**
+ * @brief Scale every byte of a buffer by (scale + 1) / 256, see pixel_scale()
+ *
+ * Works a word at a time; dst may be the same buffer as src.
+ */
+void pixel_scale_buf(uint8_t *dst, const uint8_t *src, size_t size, uint8_t scale);
+
+/**
+ * @brief Blend two buffers byte by byte into dst, see pixel_blend()
+ *
+ * dst may be the same buffer as a or b.
+ */
+void pixel_blend_buf(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t size, uint32_t weight);
+
+/**
+ * @brief Add src to dst byte by byte, clamping at 255, see pixel_add_sat()
+ */
+void pixel_add_sat_buf(uint8_t *dst, const uint8_t *src, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+#include <stdbool.h>
+#include <string.h>
+#include "pixel_kernels.h"
+
+// Word access to byte buffers, allowed to alias the bytes it is loaded from
+typedef uint32_t __attribute__((may_alias)) pixel_word_t;
+
+static inline bool pixel_aligned(const void *p)
+{
+    return ((uintptr_t)p & (sizeof(uint32_t) - 1)) == 0;
+}
+
+void pixel_fill_grb(uint8_t *out, size_t count, uint32_t rgb)
+{
+    uint8_t g = (uint8_t)(rgb >> 8), r = (uint8_t)(rgb >> 16), b = (uint8_t)rgb;
+    size_t i = 0;
+    if (pixel_aligned(out) && count >= 4) {
+        // Four pixels are exactly three words: build them once, then store words
+        const uint8_t pattern[12] = {g, r, b, g, r, b, g, r, b, g, r, b};
+        uint32_t words[3];
+        memcpy(words, pattern, sizeof(words));
+        pixel_word_t *w = (pixel_word_t *)out;
+        for (; i + 4 <= count; i += 4, w += 3) {
+            w[0] = words[0];
+            w[1] = words[1];
+            w[2] = words[2];
+        }
+    }
+    for (uint8_t *p = out + i * 3; i < count; i++, p += 3) {
+        p[0] = g;
+        p[1] = r;
+        p[2] = b;
+    }
+}
+
+void pixel_scale_buf(uint8_t *dst, const uint8_t *src, size_t size, uint8_t scale)
+{
+    uint32_t gain = (uint32_t)scale + 1;
+    size_t i = 0;
+    if (pixel_aligned(dst) && pixel_aligned(src)) {
+        pixel_word_t *d = (pixel_word_t *)dst;
+        const pixel_word_t *s = (const pixel_word_t *)src;
+        for (; i + 4 <= size; i += 4) {
+            *d++ = pixel_scale(*s++, scale);
+        }
+    }
+    for (; i < size; i++) {
+        dst[i] = (uint8_t)((src[i] * gain) >> 8);
+    }
+}
+
+void pixel_blend_buf(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t size, uint32_t weight)
+{
+    size_t i = 0;
+    if (pixel_aligned(dst) && pixel_aligned(a) && pixel_aligned(b)) {
+        pixel_word_t *d = (pixel_word_t *)dst;
+        const pixel_word_t *wa = (const pixel_word_t *)a;
+        const pixel_word_t *wb = (const pixel_word_t *)b;
+        for (; i + 4 <= size; i += 4) {
+            *d++ = pixel_blend(*wa++, *wb++, weight);
+        }
+    }
+    for (; i < size; i++) {
+        dst[i] = (uint8_t)((a[i] * (256 - weight) + b[i] * weight + 128) >> 8);
+    }
+}
+
+void pixel_add_sat_buf(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    size_t i = 0;
+    if (pixel_aligned(dst) && pixel_aligned(src)) {
+        pixel_word_t *d = (pixel_word_t *)dst;
+        const pixel_word_t *s = (const pixel_word_t *)src;
+        for (; i + 4 <= size; i += 4, d++) {
+            *d = pixel_add_sat(*d, *s++);
+        }
+    }
+    for (; i < size; i++) {
+        uint32_t sum = dst[i] + src[i];
+        dst[i] = sum > 0xFF ? 0xFF : (uint8_t)sum;
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Slots on the wheel, a power of two
+ *
+ * Timers further out than one turn wait out whole turns in their slot, so
+ * the slot count only trades memory against how many entries a tick looks at.
+ */
+#define TIMER_WHEEL_SLOTS 64
+
+/**
+ * @brief One timer, embedded in whatever it belongs to
+ */
+typedef struct timer_wheel_entry {
+    struct timer_wheel_entry *next;
+    struct timer_wheel_entry **pprev; /*!< Link pointing at this entry, NULL when not scheduled */
+    uint32_t due_tick;
+    uint32_t rounds;                  /*!< Whole turns left before the slot's visit that fires it */
+    void *arg;                        /*!< Owner's context, untouched by the wheel */
+} timer_wheel_entry_t;
+
+/**
+ * @brief Hashed timer wheel with a caller-driven clock
+ *
+ * Scheduling and cancelling are O(1). The wheel has no clock or lock of its
+ * own: the caller advances it to the current tick and serializes access.
+ */
+typedef struct {
+    timer_wheel_entry_t *slots[TIMER_WHEEL_SLOTS];
+    uint32_t now_tick;
+    size_t count;
+} timer_wheel_t;
+
+/**
+ * @brief Function called for each timer that comes due, after it was taken off the wheel
+ *
+ * It may schedule the entry again, or any other entry.
+ */
+typedef void (*timer_wheel_fire_t)(timer_wheel_entry_t *entry, void *ctx);
+
+/**
+ * @brief Set up an empty wheel whose clock reads now_tick
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now_tick);
+
+/**
+ * @brief Set up an entry, not scheduled
+ */
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, void *arg);
+
+/**
+ * @brief Schedule an entry delay_ticks after the wheel's current tick, moving it if already scheduled
+ *
+ * A delay of 0 is treated as 1: the entry fires on the next advance.
+ */
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay_ticks);
+
+/**
+ * @brief Take an entry off the wheel, nothing happens if it isn't on it
+ */
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_entry_t *entry);
+
+/**
+ * @brief Whether the entry is waiting to fire
+ */
+bool timer_wheel_scheduled(const timer_wheel_entry_t *entry);
+
+/**
+ * @brief Move the clock forward to now_tick, firing every entry due up to and including it
+ *
+ * @return Number of entries fired
+ */
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint32_t now_tick, timer_wheel_fire_t fire, void *ctx);
+
+/**
+ * @brief Ticks from the wheel's current tick to the earliest scheduled entry
+ *
+ * Lets the caller sleep until there is work instead of ticking at a fixed rate.
+ *
+ * @return false if nothing is scheduled
+ */
+bool timer_wheel_next_due(const timer_wheel_t *wheel, uint32_t *ticks);
+
+#ifdef __cplusplus
+}
+#endif
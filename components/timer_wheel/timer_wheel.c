@@ -0,0 +1,115 @@
+#include <string.h>
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+_Static_assert((TIMER_WHEEL_SLOTS & TIMER_WHEEL_MASK) == 0, "TIMER_WHEEL_SLOTS must be a power of two");
+
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now_tick)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now_tick = now_tick;
+}
+
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, void *arg)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->arg = arg;
+}
+
+bool timer_wheel_scheduled(const timer_wheel_entry_t *entry)
+{
+    return entry->pprev != NULL;
+}
+
+static void timer_wheel_link(timer_wheel_entry_t **head, timer_wheel_entry_t *entry)
+{
+    entry->next = *head;
+    if (*head != NULL) {
+        (*head)->pprev = &entry->next;
+    }
+    *head = entry;
+    entry->pprev = head;
+}
+
+static void timer_wheel_unlink(timer_wheel_entry_t *entry)
+{
+    *entry->pprev = entry->next;
+    if (entry->next != NULL) {
+        entry->next->pprev = entry->pprev;
+    }
+    entry->next = NULL;
+    entry->pprev = NULL;
+}
+
+void timer_wheel_cancel(timer_wheel_t *wheel, timer_wheel_entry_t *entry)
+{
+    if (entry->pprev == NULL) {
+        return;
+    }
+    timer_wheel_unlink(entry);
+    wheel->count--;
+}
+
+void timer_wheel_schedule(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay_ticks)
+{
+    timer_wheel_cancel(wheel, entry);
+    if (delay_ticks == 0) {
+        delay_ticks = 1;
+    }
+    entry->due_tick = wheel->now_tick + delay_ticks;
+    // The slot is visited every TIMER_WHEEL_SLOTS ticks, the entry sits out the visits before its own
+    entry->rounds = (delay_ticks - 1) / TIMER_WHEEL_SLOTS;
+    timer_wheel_link(&wheel->slots[entry->due_tick & TIMER_WHEEL_MASK], entry);
+    wheel->count++;
+}
+
+size_t timer_wheel_advance(timer_wheel_t *wheel, uint32_t now_tick, timer_wheel_fire_t fire, void *ctx)
+{
+    size_t fired = 0;
+    // Signed difference, so a clock that wrapped still counts as ahead
+    while ((int32_t)(now_tick - wheel->now_tick) > 0) {
+        wheel->now_tick++;
+        // Work off a detached copy of the slot, so whatever fire() schedules waits for a later visit
+        timer_wheel_entry_t **slot = &wheel->slots[wheel->now_tick & TIMER_WHEEL_MASK];
+        timer_wheel_entry_t *pending = *slot;
+        *slot = NULL;
+        if (pending != NULL) {
+            pending->pprev = &pending;
+        }
+        while (pending != NULL) {
+            timer_wheel_entry_t *entry = pending;
+            timer_wheel_unlink(entry);
+            if (entry->rounds > 0) {
+                entry->rounds--;
+                timer_wheel_link(slot, entry);
+                continue;
+            }
+            wheel->count--;
+            fire(entry, ctx);
+            fired++;
+        }
+        if (wheel->count == 0) {
+            wheel->now_tick = now_tick; // nothing left to visit, skip the empty ticks
+        }
+    }
+    return fired;
+}
+
+bool timer_wheel_next_due(const timer_wheel_t *wheel, uint32_t *ticks)
+{
+    if (wheel->count == 0) {
+        return false;
+    }
+    uint32_t best = UINT32_MAX;
+    for (size_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+        for (const timer_wheel_entry_t *entry = wheel->slots[slot]; entry != NULL; entry = entry->next) {
+            uint32_t left = entry->due_tick - wheel->now_tick;
+            if (left < best) {
+                best = left;
+            }
+        }
+    }
+    *ticks = best;
+    return true;
+}
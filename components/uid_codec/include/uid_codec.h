@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Longest UID we handle; ISO 14443-A UIDs are 4, 7 or 10 bytes
+ */
+#define UID_CODEC_MAX_LEN 10
+
+/**
+ * @brief Space needed by uid_format_hex() for a UID of n bytes, including the terminator
+ */
+#define UID_CODEC_TEXT_SIZE(n) ((n) * 3 + 1)
+
+/**
+ * @brief Parse hex UID bytes, e.g. " 33 A4 1F 0B" or "33A41F0B"
+ *
+ * Whitespace between bytes is skipped and a single digit followed by a
+ * separator is one byte. Parsing stops at the first other character, at a NUL,
+ * after text_len characters or once uid_size bytes have been stored. Never
+ * reads past text_len and never writes past uid_size.
+ *
+ * @param[in] text Input characters, need not be null-terminated
+ * @param[in] text_len Number of characters available in text
+ * @param[out] uid Parsed bytes
+ * @param[in] uid_size Capacity of uid
+ * @return Number of bytes stored in uid
+ */
+size_t uid_parse_hex(const char *text, size_t text_len, uint8_t *uid, size_t uid_size);
+
+/**
+ * @brief Find a "UID:" line in a received chunk and parse the bytes after it
+ *
+ * @param[in] buf Received characters, need not be null-terminated
+ * @param[in] len Number of characters in buf
+ * @param[out] uid Parsed bytes
+ * @param[in] uid_size Capacity of uid
+ * @return Number of bytes stored in uid, 0 if there was no "UID:" marker
+ */
+size_t uid_parse_line(const char *buf, size_t len, uint8_t *uid, size_t uid_size);
+
+/**
+ * @brief Format a UID the way the RFID sender transmits it, e.g. " 33 A4 1F 0B"
+ *
+ * Only whole bytes are written, so a short buffer truncates cleanly. The
+ * output is always null-terminated when out_size > 0.
+ *
+ * @return Number of characters written, excluding the terminator
+ */
+size_t uid_format_hex(const uint8_t *uid, size_t uid_len, char *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "uid_codec.h"
+
+#define UID_LINE_MARKER     "UID:"
+#define UID_LINE_MARKER_LEN 4
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+static int is_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+size_t uid_parse_hex(const char *text, size_t text_len, uint8_t *uid, size_t uid_size)
+{
+    size_t n = 0;
+    size_t i = 0;
+    while (i < text_len && n < uid_size) {
+        char c = text[i];
+        if (is_separator(c)) {
+            i++;
+            continue;
+        }
+        int hi = hex_value(c);
+        if (hi < 0) {
+            break; // stop at anything that isn't part of a UID
+        }
+        int lo = i + 1 < text_len ? hex_value(text[i + 1]) : -1;
+        if (lo >= 0) {
+            uid[n++] = (uint8_t)(hi << 4 | lo);
+            i += 2;
+        } else {
+            uid[n++] = (uint8_t)hi;
+            i += 1;
+        }
+    }
+    return n;
+}
+
+size_t uid_parse_line(const char *buf, size_t len, uint8_t *uid, size_t uid_size)
+{
+    for (size_t i = 0; i + UID_LINE_MARKER_LEN <= len; i++) {
+        if (buf[i] == 'U' && memcmp(buf + i, UID_LINE_MARKER, UID_LINE_MARKER_LEN) == 0) {
+            const char *start = buf + i + UID_LINE_MARKER_LEN;
+            size_t remaining = len - i - UID_LINE_MARKER_LEN;
+            const char *eol = memchr(start, '\n', remaining);
+            if (eol != NULL) {
+                remaining = eol - start;
+            }
+            return uid_parse_hex(start, remaining, uid, uid_size);
+        }
+    }
+    return 0;
+}
+
+size_t uid_format_hex(const uint8_t *uid, size_t uid_len, char *out, size_t out_size)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    if (out_size == 0) {
+        return 0;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < uid_len && pos + 3 < out_size; i++) {
+        out[pos++] = ' ';
+        out[pos++] = digits[uid[i] >> 4];
+        out[pos++] = digits[uid[i] & 0x0F];
+    }
+    out[pos] = '\0';
+    return pos;
+}
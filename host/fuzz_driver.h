@@ -0,0 +1,57 @@
+// Shared driver of the host fuzz targets.
+//
+// A target includes this once and defines fuzz_one(), which runs one input
+// and returns 0. With HOST_LIBFUZZER it becomes the libFuzzer entry point.
+// Otherwise main() runs it over the files given on the command line, or one
+// input on stdin, which is what AFL and corpus replay use.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Not assert(): release builds define NDEBUG and the checks must stay in
+#define FUZZ_CHECK(cond)                                              \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            abort();                                                  \
+        }                                                             \
+    } while (0)
+
+#define FUZZ_MAX_INPUT (1 << 20) // inputs read from files are cut at this size
+
+int fuzz_one(const uint8_t *data, size_t size);
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    return fuzz_one(data, size);
+}
+
+#ifndef HOST_LIBFUZZER
+static int fuzz_run_file(FILE *f)
+{
+    static uint8_t buf[FUZZ_MAX_INPUT];
+    size_t size = fread(buf, 1, sizeof(buf), f);
+    return fuzz_one(buf, size);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        return fuzz_run_file(stdin);
+    }
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        fuzz_run_file(f);
+        fclose(f);
+    }
+    printf("%d inputs OK\n", argc - 1);
+    return 0;
+}
+#endif
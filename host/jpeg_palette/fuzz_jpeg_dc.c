@@ -0,0 +1,94 @@
+// Fuzz target for components/jpeg_palette.
+//
+// Feeds the decoder through reads of varying size (the input is copied into
+// an exactly-sized heap block, so ASan catches any read past the end) and
+// checks that every block it reports lies inside the declared image, then
+// runs the palette extraction over whatever came out.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jpeg_dc.h"
+#include "palette.h"
+#include "fuzz_driver.h"
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+    size_t chunk; // largest read, to vary where the input buffer refills
+} fuzz_input_t;
+
+typedef struct {
+    const jpeg_dc_decoder_t *dec;
+    palette_sampler_t sampler;
+    uint32_t blocks;
+} fuzz_output_t;
+
+static size_t fuzz_read(void *ctx, uint8_t *buf, size_t len)
+{
+    fuzz_input_t *in = ctx;
+    size_t n = in->size - in->pos;
+    n = n < len ? n : len;
+    n = n < in->chunk ? n : in->chunk;
+    memcpy(buf, in->data + in->pos, n);
+    in->pos += n;
+    return n;
+}
+
+static void fuzz_block(void *ctx, uint16_t bx, uint16_t by, const uint8_t rgb[3])
+{
+    fuzz_output_t *out = ctx;
+    FUZZ_CHECK(bx < (out->dec->width + 7) / 8);
+    FUZZ_CHECK(by < (out->dec->height + 7) / 8);
+    out->blocks++;
+    palette_sampler_add(&out->sampler, rgb);
+}
+
+int fuzz_one(const uint8_t *data, size_t size)
+{
+    uint8_t *copy = malloc(size ? size : 1);
+    if (copy == NULL) {
+        return 0;
+    }
+    memcpy(copy, data, size);
+
+    static jpeg_dc_decoder_t dec;
+    static fuzz_output_t out;
+    jpeg_dc_result_t first = JPEG_DC_OK;
+    uint32_t first_blocks = 0;
+    const size_t chunks[] = {JPEG_DC_INPUT_SIZE, 1, 7};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        fuzz_input_t in = {copy, size, 0, chunks[i]};
+        out.dec = &dec;
+        out.blocks = 0;
+        palette_sampler_init(&out.sampler);
+        uint16_t width = 0, height = 0;
+        jpeg_dc_result_t result = jpeg_dc_decode(&dec, fuzz_read, &in, fuzz_block, &out, &width, &height);
+        FUZZ_CHECK(in.pos <= size);
+        FUZZ_CHECK(width <= JPEG_DC_MAX_DIMENSION && height <= JPEG_DC_MAX_DIMENSION);
+        FUZZ_CHECK(out.blocks <= (uint32_t)((width + 7) / 8) * ((height + 7) / 8));
+        FUZZ_CHECK(out.sampler.count <= PALETTE_MAX_SAMPLES);
+
+        // How the input is split into reads must not change the outcome
+        if (i == 0) {
+            first = result;
+            first_blocks = out.blocks;
+        } else {
+            FUZZ_CHECK(result == first);
+            FUZZ_CHECK(out.blocks == first_blocks);
+        }
+
+        palette_color_t colors[PALETTE_MAX_COLORS];
+        size_t n = palette_extract(&out.sampler, colors, PALETTE_MAX_COLORS);
+        FUZZ_CHECK(n <= PALETTE_MAX_COLORS);
+        FUZZ_CHECK((n == 0) == (out.sampler.count == 0));
+        for (size_t c = 1; c < n; c++) {
+            FUZZ_CHECK(colors[c].weight <= colors[c - 1].weight);
+        }
+    }
+
+    free(copy);
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Prints the palette the player would send for a JPEG file, and optionally
+// every block average, for checking the decoder against a reference.
+//
+//   jpeg_palette_tool [--blocks] cover.jpg
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "jpeg_dc.h"
+#include "palette.h"
+
+typedef struct {
+    palette_sampler_t sampler;
+    int print_blocks;
+} tool_output_t;
+
+static size_t tool_read(void *ctx, uint8_t *buf, size_t len)
+{
+    return fread(buf, 1, len, ctx);
+}
+
+static void tool_block(void *ctx, uint16_t bx, uint16_t by, const uint8_t rgb[3])
+{
+    tool_output_t *out = ctx;
+    if (out->print_blocks) {
+        printf("%u %u %u %u %u\n", bx, by, rgb[0], rgb[1], rgb[2]);
+    }
+    palette_sampler_add(&out->sampler, rgb);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const results[] = {"ok", "truncated", "format error", "unsupported"};
+    static jpeg_dc_decoder_t dec;
+    static tool_output_t out;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--blocks") == 0) {
+        out.print_blocks = 1;
+        arg++;
+    }
+    if (arg != argc - 1) {
+        fprintf(stderr, "usage: %s [--blocks] file.jpg\n", argv[0]);
+        return 2;
+    }
+    FILE *f = fopen(argv[arg], "rb");
+    if (f == NULL) {
+        perror(argv[arg]);
+        return 1;
+    }
+
+    palette_sampler_init(&out.sampler);
+    uint16_t width = 0, height = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    jpeg_dc_result_t result = jpeg_dc_decode(&dec, tool_read, f, tool_block, &out, &width, &height);
+    palette_color_t colors[PALETTE_MAX_COLORS];
+    size_t n = palette_extract(&out.sampler, colors, PALETTE_MAX_COLORS);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fclose(f);
+
+    if (out.print_blocks) {
+        return result != JPEG_DC_OK;
+    }
+    printf("%s: %ux%u, %s, %ld us\n", argv[arg], width, height, results[result],
+           (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000);
+    for (size_t i = 0; i < n; i++) {
+        printf("  #%02x%02x%02x  %3u/255\n", colors[i].rgb[0], colors[i].rgb[1], colors[i].rgb[2],
+               colors[i].weight);
+    }
+    return result != JPEG_DC_OK;
+}
@@ -0,0 +1,144 @@
+// Per-frame cost of the LED strip's frame generator, for each effect and strip length.
+//
+// "breathe" is a settled color, where only the brightness moves. "pattern"
+// breathes a fixed gradient instead of one color. "crossfade" keeps the strip
+// in the middle of a color change, so every frame rewrites every pixel. Each
+// effect runs against three sinks: "render" drops the frame, "scaled" also
+// applies the brightness to every byte as the RMT encoder does, which is the
+// bulk of what happens to a frame after it is generated, and "cache" runs the
+// encoder's frame cache policy and reports how often its cache is hit.
+//
+//   bench_led_render [frames]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pixel_kernels.h"
+#include "led_frame_cache.h"
+#include "led_render.h"
+
+#define BENCH_FRAME_US     (30 * 1000)
+#define BENCH_CACHE_FRAMES 4 // LED_ENCODER_CACHE_FRAMES of the firmware
+
+typedef struct {
+    led_sink_t base;
+    uint8_t *out;
+    uint32_t checksum;
+    led_frame_cache_t cache;
+    uint32_t paths[LED_FRAME_BYTES + 1]; // frames per led_frame_path_t
+} bench_sink_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int drop_show(led_sink_t *base, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    bench_sink_t *sink = (bench_sink_t *)base;
+    (void)led_count;
+    sink->checksum += pixels[0] + brightness;
+    return 0;
+}
+
+static int scaled_show(led_sink_t *base, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    bench_sink_t *sink = (bench_sink_t *)base;
+    pixel_scale_buf(sink->out, pixels, led_count * 3, brightness);
+    sink->checksum += sink->out[0];
+    return 0;
+}
+
+// Cached frames stream symbols that were built once, the rest are scaled on the way out
+static int cache_show(led_sink_t *base, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    bench_sink_t *sink = (bench_sink_t *)base;
+    uint32_t index;
+    led_frame_path_t path = led_frame_cache_select(&sink->cache, pixels, led_count * 3, brightness, &index);
+    sink->paths[path]++;
+    if (path != LED_FRAME_CACHE_HIT) {
+        pixel_scale_buf(sink->out, pixels, path == LED_FRAME_SOLID ? 3 : led_count * 3, brightness);
+    }
+    sink->checksum += sink->out[0];
+    return 0;
+}
+
+static void run(const char *effect, int crossfade, int pattern, const char *sink_name, bench_sink_t *sink,
+                size_t leds, long frames)
+{
+    static const uint8_t colors[2][3] = {{148, 0, 211}, {255, 69, 0}};
+    uint8_t *pixels = malloc(leds * 3);
+    static led_render_t render;
+    led_render_init(&render, pixels, leds, 4000, 800);
+    led_render_set_color(&render, colors[0], true, 0);
+    if (pattern) {
+        // The color is settled, so the renderer leaves the pixels alone from here on
+        led_render_frame(&render, 0, 0);
+        for (size_t i = 0; i < leds * 3; i++) {
+            pixels[i] = (uint8_t)(i * 255 / (leds * 3));
+        }
+    }
+    memset(sink->paths, 0, sizeof(sink->paths));
+
+    long shown = 0;
+    int next = 1;
+    int64_t now_us = 0;
+    uint64_t start = now_ns();
+    for (long f = 0; f < frames; f++) {
+        now_us += BENCH_FRAME_US;
+        // Restart the color change just before it would settle
+        if (crossfade && led_render_settled(&render, now_us + BENCH_FRAME_US)) {
+            led_render_set_color(&render, colors[next], false, now_us);
+            next ^= 1;
+        }
+        if (led_render_frame(&render, now_us, now_us)) {
+            sink->base.show(&sink->base, pixels, leds, render.brightness);
+            shown++;
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    double ns = (double)elapsed / frames;
+    printf("%-10s %-7s %5zu leds %9.1f ns/frame %12.0f frames/s  %3ld%% sent",
+           effect, sink_name, leds, ns, 1e9 / ns, shown * 100 / frames);
+    if (sink->base.show == cache_show) {
+        uint32_t lookups = sink->paths[LED_FRAME_CACHE_HIT] + sink->paths[LED_FRAME_CACHE_MISS];
+        printf("  hits %3u%% of %u lookups, %u scaled, %u solid", lookups ? sink->paths[LED_FRAME_CACHE_HIT] * 100 / lookups : 0,
+               lookups, sink->paths[LED_FRAME_SCALED], sink->paths[LED_FRAME_SOLID]);
+    }
+    printf("\n");
+    free(pixels);
+}
+
+int main(int argc, char **argv)
+{
+    long frames = argc > 1 ? strtol(argv[1], NULL, 10) : 200000;
+    static const size_t lengths[] = {8, 60, 144, 300, 1000};
+    uint32_t checksum = 0;
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        size_t leds = lengths[l];
+        bench_sink_t drop = {.base.show = drop_show};
+        bench_sink_t scaled = {.base.show = scaled_show, .out = malloc(leds * 3)};
+        bench_sink_t cached = {.base.show = cache_show, .out = malloc(leds * 3)};
+        static led_frame_cache_entry_t entries[BENCH_CACHE_FRAMES];
+        uint8_t *cache_frames = malloc(BENCH_CACHE_FRAMES * leds * 3);
+        led_frame_cache_init(&cached.cache, entries, cache_frames, BENCH_CACHE_FRAMES, leds * 3);
+        bench_sink_t *sinks[] = {&drop, &scaled, &cached};
+        static const char *sink_names[] = {"render", "scaled", "cache"};
+        for (int s = 0; s < 3; s++) {
+            run("breathe", 0, 0, sink_names[s], sinks[s], leds, frames);
+            run("pattern", 0, 1, sink_names[s], sinks[s], leds, frames);
+            run("crossfade", 1, 0, sink_names[s], sinks[s], leds, frames);
+        }
+        checksum += drop.checksum + scaled.checksum + cached.checksum;
+        free(scaled.out);
+        free(cached.out);
+        free(cache_frames);
+    }
+    printf("(checksum %u)\n", checksum);
+    return 0;
+}
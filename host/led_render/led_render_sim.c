@@ -0,0 +1,146 @@
+// Runs the LED strip's frame generator without hardware and shows the result.
+//
+// Two cards are tapped, the second halfway through, and frames are rendered
+// every 30 ms as on the strip. Output is either a PPM image with one row per
+// frame (time runs down, the strip runs across) or a truecolor terminal line
+// per frame.
+//
+//   led_render_sim [--leds 60] [--seconds 6] [--colors 9400d3,ff4500] [--ppm out.ppm | --term]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "led_render.h"
+
+// Same timing as led_strip_controller_main.c
+#define SIM_FADE_PERIOD_MS 4000
+#define SIM_CROSSFADE_MS   800
+#define SIM_FRAME_MS       30
+#define SIM_TERM_COLUMNS   60
+
+typedef struct {
+    led_sink_t base;
+    FILE *out;
+    int term;
+    size_t shown;
+} sim_sink_t;
+
+static uint8_t scale(uint8_t byte, uint8_t brightness)
+{
+    return (uint8_t)(byte * (brightness + 1) / 256);
+}
+
+static int sim_show(led_sink_t *base, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    sim_sink_t *sink = (sim_sink_t *)base;
+    sink->shown++;
+    if (sink->term) {
+        size_t columns = led_count < SIM_TERM_COLUMNS ? led_count : SIM_TERM_COLUMNS;
+        for (size_t c = 0; c < columns; c++) {
+            const uint8_t *p = pixels + (c * led_count / columns) * 3;
+            fprintf(sink->out, "\x1b[38;2;%u;%u;%um\xe2\x96\x88", scale(p[1], brightness),
+                    scale(p[0], brightness), scale(p[2], brightness));
+        }
+        fprintf(sink->out, "\x1b[0m %3u\n", brightness);
+    }
+    return 0;
+}
+
+// The strip holds its last frame, so a skipped frame repeats the previous row
+static void sim_ppm_row(FILE *out, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    for (size_t i = 0; i < led_count; i++) {
+        const uint8_t *p = pixels + i * 3;
+        uint8_t rgb[3] = {scale(p[1], brightness), scale(p[0], brightness), scale(p[2], brightness)};
+        fwrite(rgb, 1, 3, out);
+    }
+}
+
+static int parse_color(const char *text, uint8_t rgb[3])
+{
+    unsigned long value;
+    char *end;
+    value = strtoul(text, &end, 16);
+    if (end - text != 6) {
+        return -1;
+    }
+    rgb[0] = value >> 16;
+    rgb[1] = value >> 8;
+    rgb[2] = value;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t leds = 60;
+    double seconds = 6;
+    const char *ppm_path = NULL;
+    int term = 0;
+    uint8_t colors[2][3] = {{148, 0, 211}, {255, 69, 0}};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--leds") == 0 && i + 1 < argc) {
+            leds = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppm_path = argv[++i];
+        } else if (strcmp(argv[i], "--term") == 0) {
+            term = 1;
+        } else if (strcmp(argv[i], "--colors") == 0 && i + 1 < argc) {
+            const char *list = argv[++i];
+            const char *comma = strchr(list, ',');
+            if (parse_color(list, colors[0]) != 0 || comma == NULL || parse_color(comma + 1, colors[1]) != 0) {
+                fprintf(stderr, "--colors takes two RRGGBB values, like 9400d3,ff4500\n");
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "usage: %s [--leds N] [--seconds S] [--colors RRGGBB,RRGGBB] [--ppm out.ppm | --term]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (leds == 0 || seconds <= 0 || (ppm_path == NULL && !term)) {
+        fprintf(stderr, "Give --ppm out.ppm or --term, and a positive --leds and --seconds\n");
+        return 2;
+    }
+
+    uint8_t *pixels = malloc(leds * 3);
+    static led_render_t render;
+    sim_sink_t sink = {
+        .base.show = sim_show,
+        .out = stdout,
+        .term = term,
+    };
+    led_render_init(&render, pixels, leds, SIM_FADE_PERIOD_MS, SIM_CROSSFADE_MS);
+
+    FILE *ppm = NULL;
+    size_t frames = (size_t)(seconds * 1000 / SIM_FRAME_MS);
+    if (ppm_path != NULL) {
+        ppm = fopen(ppm_path, "wb");
+        if (ppm == NULL) {
+            perror(ppm_path);
+            return 1;
+        }
+        fprintf(ppm, "P6\n%zu %zu\n255\n", leds, frames);
+    }
+
+    for (size_t f = 0; f < frames; f++) {
+        int64_t now_us = (int64_t)f * SIM_FRAME_MS * 1000;
+        if (f == 0 || f == frames / 2) {
+            led_render_set_color(&render, colors[f == 0 ? 0 : 1], false, now_us);
+        }
+        if (led_render_step(&render, &sink.base, now_us, now_us) != 0) {
+            fprintf(stderr, "Sink failed at frame %zu\n", f);
+            return 1;
+        }
+        if (ppm != NULL) {
+            sim_ppm_row(ppm, pixels, leds, render.brightness);
+        }
+    }
+    if (ppm != NULL) {
+        fclose(ppm);
+    }
+    fprintf(stderr, "%zu frames rendered, %zu sent to the strip\n", frames, sink.shown);
+    free(pixels);
+    return 0;
+}
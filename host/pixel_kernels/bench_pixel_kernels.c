@@ -0,0 +1,258 @@
+// Checks and times components/pixel_kernels against plain per-byte loops.
+//
+// Every kernel is first compared with its byte-at-a-time definition over
+// random words and every scale or weight, and the run stops on the first
+// mismatch. Then both versions run over strip-sized buffers. The target is
+// built without auto-vectorization, like the C6, which has no SIMD unit for
+// the compiler to use, so the numbers compare the same kind of code the
+// firmware runs.
+//
+//   bench_pixel_kernels [iterations]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pixel_kernels.h"
+
+#define CHECK_WORDS 4096
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint32_t next_word(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+static uint8_t lane(uint32_t word, int i)
+{
+    return (uint8_t)(word >> (8 * i));
+}
+
+static uint32_t ref_scale(uint32_t px, uint8_t scale)
+{
+    uint32_t out = 0;
+    for (int i = 0; i < 4; i++) {
+        out |= (uint32_t)((lane(px, i) * (scale + 1)) >> 8) << (8 * i);
+    }
+    return out;
+}
+
+static uint32_t ref_add_sat(uint32_t a, uint32_t b)
+{
+    uint32_t out = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t sum = lane(a, i) + lane(b, i);
+        out |= (sum > 0xFF ? 0xFF : sum) << (8 * i);
+    }
+    return out;
+}
+
+static uint32_t ref_blend(uint32_t a, uint32_t b, uint32_t weight)
+{
+    uint32_t out = 0;
+    for (int i = 0; i < 4; i++) {
+        out |= ((lane(a, i) * (256 - weight) + lane(b, i) * weight + 128) >> 8) << (8 * i);
+    }
+    return out;
+}
+
+static uint32_t ref_rgbw(uint32_t px)
+{
+    uint8_t r = lane(px, 2), g = lane(px, 1), b = lane(px, 0);
+    uint8_t w = r < g ? (r < b ? r : b) : (g < b ? g : b);
+    return (uint32_t)w << 24 | (uint32_t)(r - w) << 16 | (uint32_t)(g - w) << 8 | (uint8_t)(b - w);
+}
+
+static int fail(const char *kernel, uint32_t a, uint32_t b, uint32_t arg, uint32_t got, uint32_t want)
+{
+    fprintf(stderr, "%s(%08x, %08x, %u) = %08x, expected %08x\n", kernel, a, b, arg, got, want);
+    return 1;
+}
+
+static int check(void)
+{
+    uint32_t seed = 0x2545F491u;
+    for (int i = 0; i < CHECK_WORDS; i++) {
+        // Mix in the extremes, where carries and saturation happen
+        uint32_t a = i < 4 ? 0xFFFFFFFFu * (i & 1) : next_word(&seed);
+        uint32_t b = i < 4 ? 0xFFFFFFFFu * (i >> 1) : next_word(&seed);
+        for (uint32_t s = 0; s < 256; s++) {
+            if (pixel_scale(a, (uint8_t)s) != ref_scale(a, (uint8_t)s)) {
+                return fail("pixel_scale", a, 0, s, pixel_scale(a, (uint8_t)s), ref_scale(a, (uint8_t)s));
+            }
+        }
+        for (uint32_t w = 0; w <= 256; w++) {
+            if (pixel_blend(a, b, w) != ref_blend(a, b, w)) {
+                return fail("pixel_blend", a, b, w, pixel_blend(a, b, w), ref_blend(a, b, w));
+            }
+        }
+        if (pixel_add_sat(a, b) != ref_add_sat(a, b)) {
+            return fail("pixel_add_sat", a, b, 0, pixel_add_sat(a, b), ref_add_sat(a, b));
+        }
+        uint32_t px = a & 0x00FFFFFFu;
+        uint32_t grb = (uint32_t)lane(px, 1) << 16 | (uint32_t)lane(px, 2) << 8 | lane(px, 0);
+        if (pixel_rgb_to_grb(px) != grb) {
+            return fail("pixel_rgb_to_grb", px, 0, 0, pixel_rgb_to_grb(px), grb);
+        }
+        if (pixel_rgb_to_rgbw(px) != ref_rgbw(px)) {
+            return fail("pixel_rgb_to_rgbw", px, 0, 0, pixel_rgb_to_rgbw(px), ref_rgbw(px));
+        }
+    }
+
+    // Buffer kernels, with odd lengths and offsets for the unaligned paths
+    uint8_t src[67], other[67], want[67], got[67];
+    for (size_t i = 0; i < sizeof(src); i++) {
+        src[i] = (uint8_t)next_word(&seed);
+        other[i] = (uint8_t)next_word(&seed);
+    }
+    for (size_t offset = 0; offset < 4; offset++) {
+        size_t size = sizeof(src) - offset;
+        for (size_t i = 0; i < size; i++) {
+            want[i] = (uint8_t)((src[offset + i] * 200) >> 8);
+        }
+        pixel_scale_buf(got, src + offset, size, 199);
+        if (memcmp(got, want, size) != 0) {
+            return fail("pixel_scale_buf", 0, 0, (uint32_t)offset, 0, 0);
+        }
+        for (size_t i = 0; i < size; i++) {
+            want[i] = (uint8_t)((src[offset + i] * 157 + other[i] * 99 + 128) >> 8);
+        }
+        pixel_blend_buf(got, src + offset, other, size, 99);
+        if (memcmp(got, want, size) != 0) {
+            return fail("pixel_blend_buf", 0, 0, (uint32_t)offset, 0, 0);
+        }
+        for (size_t i = 0; i < size; i++) {
+            uint32_t sum = src[offset + i] + other[i];
+            want[i] = sum > 0xFF ? 0xFF : (uint8_t)sum;
+        }
+        memcpy(got + offset, other, size);
+        pixel_add_sat_buf(got + offset, src + offset, size);
+        if (memcmp(got + offset, want, size) != 0) {
+            return fail("pixel_add_sat_buf", 0, 0, (uint32_t)offset, 0, 0);
+        }
+        size_t leds = size / 3;
+        for (size_t i = 0; i < leds; i++) {
+            want[i * 3] = 0x22;
+            want[i * 3 + 1] = 0x11;
+            want[i * 3 + 2] = 0x33;
+        }
+        pixel_fill_grb(got + offset, leds, 0x112233);
+        if (memcmp(got + offset, want, leds * 3) != 0) {
+            return fail("pixel_fill_grb", 0, 0, (uint32_t)offset, 0, 0);
+        }
+    }
+    return 0;
+}
+
+// Plain loops as the firmware had them, one byte and one multiply at a time
+static void scalar_scale(uint8_t *dst, const uint8_t *src, size_t size, uint8_t scale)
+{
+    for (size_t i = 0; i < size; i++) {
+        dst[i] = (uint8_t)((src[i] * (scale + 1)) >> 8);
+    }
+}
+
+static void scalar_blend(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t size, uint32_t weight)
+{
+    for (size_t i = 0; i < size; i++) {
+        dst[i] = (uint8_t)((a[i] * (256 - weight) + b[i] * weight + 128) >> 8);
+    }
+}
+
+static void scalar_add_sat(uint8_t *dst, const uint8_t *src, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        uint32_t sum = dst[i] + src[i];
+        dst[i] = sum > 0xFF ? 0xFF : (uint8_t)sum;
+    }
+}
+
+static void scalar_fill_grb(uint8_t *out, size_t count, uint32_t rgb)
+{
+    for (size_t i = 0; i < count; i++, out += 3) {
+        out[0] = (uint8_t)(rgb >> 8);
+        out[1] = (uint8_t)(rgb >> 16);
+        out[2] = (uint8_t)rgb;
+    }
+}
+
+typedef enum { OP_SCALE, OP_BLEND, OP_ADD_SAT, OP_FILL } bench_op_t;
+
+static const char *const op_names[] = {"scale", "blend", "add_sat", "fill_grb"};
+
+static double run(bench_op_t op, int swar, uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t leds, long iterations)
+{
+    size_t size = leds * 3;
+    uint64_t start = now_ns();
+    for (long it = 0; it < iterations; it++) {
+        uint8_t arg = (uint8_t)it;
+        switch (op) {
+        case OP_SCALE:
+            swar ? pixel_scale_buf(dst, a, size, arg) : scalar_scale(dst, a, size, arg);
+            break;
+        case OP_BLEND:
+            swar ? pixel_blend_buf(dst, a, b, size, arg) : scalar_blend(dst, a, b, size, arg);
+            break;
+        case OP_ADD_SAT:
+            swar ? pixel_add_sat_buf(dst, b, size) : scalar_add_sat(dst, b, size);
+            break;
+        case OP_FILL:
+            swar ? pixel_fill_grb(dst, leds, arg * 0x010203u) : scalar_fill_grb(dst, leds, arg * 0x010203u);
+            break;
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    return (double)elapsed / ((double)iterations * leds);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 20000;
+    if (check() != 0) {
+        return 1;
+    }
+    printf("kernels match their per-byte definitions\n\n");
+
+    static const size_t led_counts[] = {8, 60, 144, 300, 1000};
+    size_t max_leds = led_counts[sizeof(led_counts) / sizeof(led_counts[0]) - 1];
+    uint8_t *dst = malloc(max_leds * 3);
+    uint8_t *a = malloc(max_leds * 3);
+    uint8_t *b = malloc(max_leds * 3);
+    if (dst == NULL || a == NULL || b == NULL) {
+        return 1;
+    }
+    uint32_t seed = 1;
+    for (size_t i = 0; i < max_leds * 3; i++) {
+        a[i] = (uint8_t)next_word(&seed);
+        b[i] = (uint8_t)next_word(&seed);
+    }
+
+    printf("%-9s %6s %12s %12s %8s\n", "kernel", "leds", "scalar ns/px", "swar ns/px", "speedup");
+    unsigned checksum = 0;
+    for (int op = OP_SCALE; op <= OP_FILL; op++) {
+        for (size_t i = 0; i < sizeof(led_counts) / sizeof(led_counts[0]); i++) {
+            size_t leds = led_counts[i];
+            long n = iterations * 60 / (long)leds + 1;
+            double scalar = run((bench_op_t)op, 0, dst, a, b, leds, n);
+            checksum += dst[0];
+            double swar = run((bench_op_t)op, 1, dst, a, b, leds, n);
+            checksum += dst[0];
+            printf("%-9s %6zu %12.2f %12.2f %7.2fx\n", op_names[op], leds, scalar, swar, scalar / swar);
+        }
+    }
+    printf("(checksum %u)\n", checksum);
+    free(dst);
+    free(a);
+    free(b);
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Fuzz target for spotify-rfid-player/main/spotify_inflate.c.
+//
+// The first input byte picks the encoding (bit 0: gzip or deflate) and how
+// the body is cut into pieces (the other bits), the second the size of the
+// response buffer, (byte + 1) * 64 bytes. The rest is the body. It is decoded
+// once in a single feed and once in pieces, each piece and the buffer in
+// exactly-sized heap blocks so ASan catches any access past them. Both runs
+// must agree byte for byte, stay within the buffer, and ignore input after
+// the end of the stream.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "spotify_inflate.h"
+#include "fuzz_driver.h"
+
+typedef struct {
+    esp_err_t err;
+    bool done;
+    size_t out_len;
+    uint8_t *out;
+} fuzz_result_t;
+
+static void fuzz_decode(spotify_inflate_t *inflate, spotify_encoding_t encoding, const uint8_t *body, size_t len,
+                        size_t out_size, uint8_t seed, fuzz_result_t *result)
+{
+    result->out = malloc(out_size);
+    spotify_inflate_begin(inflate, encoding, result->out, out_size);
+    result->err = ESP_OK;
+    size_t pos = 0;
+    while (pos < len && result->err == ESP_OK) {
+        // seed 0 feeds everything at once, otherwise pieces of 1 to seed bytes
+        size_t piece = seed == 0 ? len - pos : 1 + (pos * 7 + seed) % seed;
+        piece = piece < len - pos ? piece : len - pos;
+        uint8_t *copy = malloc(piece);
+        memcpy(copy, body + pos, piece);
+        result->err = spotify_inflate_feed(inflate, copy, piece);
+        free(copy);
+        FUZZ_CHECK(spotify_inflate_out_len(inflate) <= out_size);
+        pos += piece;
+    }
+    result->done = spotify_inflate_done(inflate);
+    result->out_len = spotify_inflate_out_len(inflate);
+
+    if (result->done && result->err == ESP_OK) {
+        static const uint8_t trailing[] = "after the end";
+        FUZZ_CHECK(spotify_inflate_feed(inflate, trailing, sizeof(trailing)) == ESP_OK);
+        FUZZ_CHECK(spotify_inflate_out_len(inflate) == result->out_len);
+    }
+}
+
+int fuzz_one(const uint8_t *data, size_t size)
+{
+    if (size < 2) {
+        return 0;
+    }
+    spotify_encoding_t encoding = (data[0] & 1) ? SPOTIFY_ENCODING_DEFLATE : SPOTIFY_ENCODING_GZIP;
+    uint8_t seed = data[0] >> 1;
+    size_t out_size = ((size_t)data[1] + 1) * 64;
+    const uint8_t *body = data + 2;
+    size_t len = size - 2;
+
+    spotify_inflate_t *inflate = spotify_inflate_create();
+    FUZZ_CHECK(inflate != NULL);
+    fuzz_result_t whole, pieces;
+    fuzz_decode(inflate, encoding, body, len, out_size, 0, &whole);
+    fuzz_decode(inflate, encoding, body, len, out_size, seed == 0 ? 1 : seed, &pieces);
+
+    FUZZ_CHECK(whole.err == ESP_OK || whole.err == ESP_ERR_INVALID_SIZE || whole.err == ESP_ERR_INVALID_RESPONSE);
+    FUZZ_CHECK(whole.err == pieces.err);
+    FUZZ_CHECK(whole.done == pieces.done);
+    FUZZ_CHECK(!whole.done || whole.out_len == pieces.out_len);
+    // A failed stream may stop at a different point when cut, but what came out up to there agrees
+    size_t common = whole.out_len < pieces.out_len ? whole.out_len : pieces.out_len;
+    FUZZ_CHECK(memcmp(whole.out, pieces.out, common) == 0);
+
+    free(whole.out);
+    free(pieces.out);
+    spotify_inflate_destroy(inflate);
+    return 0;
+}
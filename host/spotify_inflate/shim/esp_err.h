@@ -0,0 +1,10 @@
+// Host stand-in for the IDF header, only what spotify_inflate uses
+#pragma once
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                   0
+#define ESP_ERR_INVALID_SIZE     0x104
+#define ESP_ERR_INVALID_RESPONSE 0x108
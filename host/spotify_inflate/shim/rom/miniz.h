@@ -0,0 +1,50 @@
+// Host stand-in for the ROM's miniz header.
+//
+// With MINIZ_DIR set, upstream miniz provides tinfl, the decoder the ROM
+// carries. Without it, tinfl_zlib.c puts the same interface over the system
+// zlib so the harness still builds offline; its results follow tinfl's for
+// the flags spotify_inflate uses, but it is not the ROM's code.
+#pragma once
+
+#if HOST_MINIZ_UPSTREAM
+#include "miniz.h"
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+enum {
+    TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+    TINFL_FLAG_HAS_MORE_INPUT = 2,
+    TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+    TINFL_FLAG_COMPUTE_ADLER32 = 8,
+};
+
+typedef enum {
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+#define TINFL_ZLIB_ARENA_SIZE (48 * 1024) // inflate state and its 32 KB window
+
+// zlib allocates from the arena, so the decoder needs no teardown, like tinfl's
+typedef struct {
+    mz_uint32 m_state; // 0 until the first tinfl_decompress() after tinfl_init()
+    z_stream stream;
+    size_t arena_used;
+    _Alignas(16) uint8_t arena[TINFL_ZLIB_ARENA_SIZE];
+} tinfl_decompressor;
+
+#define tinfl_init(r) do { (r)->m_state = 0; } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+                              mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags);
+#endif
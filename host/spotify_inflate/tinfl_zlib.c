@@ -0,0 +1,91 @@
+// tinfl_decompress() over the system zlib, for hosts without upstream miniz.
+//
+// Only the flag combinations spotify_inflate uses are covered: a non-wrapping
+// output buffer, more input to come, with or without a zlib header. A stream
+// that reports TINFL_STATUS_HAS_MORE_OUTPUT can't be resumed, which
+// spotify_inflate never does.
+
+#include <stdbool.h>
+#include <string.h>
+#include "rom/miniz.h"
+
+static voidpf tinfl_zlib_alloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = opaque;
+    size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+    if (bytes > sizeof(r->arena) - r->arena_used) {
+        return Z_NULL;
+    }
+    void *p = r->arena + r->arena_used;
+    r->arena_used += bytes;
+    return p;
+}
+
+static void tinfl_zlib_free(voidpf opaque, voidpf address)
+{
+    (void)opaque;
+    (void)address; // the arena is dropped as a whole by the next tinfl_init()
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size,
+                              mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size,
+                              const mz_uint32 decomp_flags)
+{
+    (void)pOut_buf_start; // zlib keeps its own window
+    if (!(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) {
+        *pIn_buf_size = *pOut_buf_size = 0;
+        return TINFL_STATUS_BAD_PARAM;
+    }
+    if (r->m_state == 0) {
+        memset(&r->stream, 0, sizeof(r->stream));
+        r->arena_used = 0;
+        r->stream.zalloc = tinfl_zlib_alloc;
+        r->stream.zfree = tinfl_zlib_free;
+        r->stream.opaque = r;
+        int window_bits = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (inflateInit2(&r->stream, window_bits) != Z_OK) {
+            *pIn_buf_size = *pOut_buf_size = 0;
+            return TINFL_STATUS_FAILED;
+        }
+        r->m_state = 1;
+    }
+
+    r->stream.next_in = (Bytef *)pIn_buf_next;
+    r->stream.avail_in = (uInt)*pIn_buf_size;
+    r->stream.next_out = pOut_buf_next;
+    r->stream.avail_out = (uInt)*pOut_buf_size;
+    int ret = inflate(&r->stream, Z_SYNC_FLUSH);
+    *pIn_buf_size -= r->stream.avail_in;
+    *pOut_buf_size -= r->stream.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        return TINFL_STATUS_DONE;
+    }
+    if (ret == Z_DATA_ERROR) {
+        // zlib's own wording for a bad Adler-32 trailer
+        bool adler = r->stream.msg != NULL && strcmp(r->stream.msg, "incorrect data check") == 0;
+        return adler ? TINFL_STATUS_ADLER32_MISMATCH : TINFL_STATUS_FAILED;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    if (r->stream.avail_out == 0) {
+        // tinfl finishes a stream whose end needs no more output, look for that with one spare byte
+        uint8_t spare;
+        r->stream.next_out = &spare;
+        r->stream.avail_out = 1;
+        size_t in_left = r->stream.avail_in;
+        ret = inflate(&r->stream, Z_SYNC_FLUSH);
+        *pIn_buf_size += in_left - r->stream.avail_in;
+        if (ret == Z_STREAM_END && r->stream.avail_out == 1) {
+            return TINFL_STATUS_DONE;
+        }
+        if (r->stream.avail_out == 0) {
+            return TINFL_STATUS_HAS_MORE_OUTPUT;
+        }
+        if (ret == Z_DATA_ERROR) {
+            return TINFL_STATUS_FAILED;
+        }
+    }
+    return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+}
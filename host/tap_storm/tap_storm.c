@@ -0,0 +1,830 @@
+// Tap-storm load simulator for the RFID -> player -> LED pipeline.
+//
+// Runs host models of both nodes and feeds them taps the way the RFID sender
+// does:
+//
+//   - the player's UART is a pty. A reader thread joins what arrives into
+//     lines, however the reads split them, and parses each line with
+//     uid_parse_line(), like rx_task() does. It then hands taps to a
+//     drop-oldest queue of PLAYBACK_QUEUE_LEN in front of a single worker.
+//   - the worker calls a mock Spotify over loopback TCP. The mock adds
+//     configurable latency, jitter and 429s. While the network is "down" the
+//     worker buffers taps in tap_buffer and replays them on reconnect, like
+//     playback.c.
+//   - the LED node's ESP-NOW receive callback is a UDP socket on loopback.
+//     Each frame is parsed with uid_parse_hex() into a single pending slot
+//     that the render thread picks up, like the notify to the fade task.
+//
+// Each tap carries its sequence number in the last three UID bytes, so every
+// stage can be matched back to the moment the tap was injected.
+//
+//   tap_storm [--pattern steady|poisson|burst|spam] [--readers N] [--rate HZ]
+//             [--duration S] [--burst N] [--dup-pct P] [--espnow-loss-pct P]
+//             [--spotify-ms MS] [--spotify-jitter-ms MS] [--spotify-429-pct P]
+//             [--outage START_MS:LEN_MS] [--baud B] [--led-frame-us US] [--seed N]
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "latency_stats.h"
+#include "tap_buffer.h"
+#include "uid_codec.h"
+
+// Firmware constants mirrored here; keep in sync with the sources named
+#define PLAYBACK_QUEUE_LEN   8    // spotify-rfid-player/main/playback.c
+#define PLAYBACK_UID_LEN     4    // spotify-rfid-player/main/playback.h
+#define UART_BUF_SIZE        3072 // BUF_SIZE in spotify-rfid-player/main/main.c
+#define RX_LINE_SIZE         64   // spotify-rfid-player/main/main.c
+#define WAKE_PREAMBLE        "UUUU\n" // RFID_ESPNOW_SENDER.ino
+#define PENDING_MAX_AGE_US   (10 * 60 * 1000000LL)
+#define PLAY_KIND            0
+
+#define MAX_TAPS             (1 << 20)
+#define BURST_SPACING_US     50000 // a kid swiping cards as fast as they can
+#define DRAIN_TIMEOUT_US     (30 * 1000000LL)
+
+typedef enum {
+    PATTERN_STEADY,  // each reader taps at a fixed rate
+    PATTERN_POISSON, // random arrivals at the given mean rate
+    PATTERN_BURST,   // bursts of --burst taps, --rate bursts per second
+    PATTERN_SPAM,    // one card per reader, over and over
+} pattern_t;
+
+typedef struct {
+    pattern_t pattern;
+    int readers;
+    double rate_hz;
+    double duration_s;
+    int burst;
+    int cards;
+    int dup_pct;
+    int espnow_loss_pct;
+    int spotify_ms;
+    int spotify_jitter_ms;
+    int spotify_429_pct;
+    int64_t outage_start_us;
+    int64_t outage_len_us;
+    int baud;
+    int led_frame_us;
+    unsigned seed;
+} sim_config_t;
+
+typedef struct {
+    int64_t inject_us;
+    int64_t uart_us;    // parsed out of a UART event
+    int64_t done_us;    // Spotify answered 2xx
+    int64_t led_rx_us;  // ESP-NOW frame parsed
+    int64_t led_us;     // rendered by the LED node
+    bool failed;        // Spotify answered with an error
+} tap_record_t;
+
+static sim_config_t cfg = {
+    .pattern = PATTERN_POISSON,
+    .readers = 2,
+    .rate_hz = 2.0,
+    .duration_s = 10.0,
+    .burst = 5,
+    .cards = 8,
+    .spotify_ms = 150,
+    .spotify_jitter_ms = 50,
+    .baud = 115200,
+    .led_frame_us = 1800, // 60 pixels of WS2812 at 800 kHz
+    .seed = 1,
+};
+
+static tap_record_t *taps;
+static uint32_t tap_count;
+static uint32_t dup_count;
+static pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool stopping;
+static int64_t start_us;
+
+static struct {
+    uint32_t uart_overflow;   // lines dropped for outgrowing RX_LINE_SIZE
+    uint32_t queue_dropped;
+    uint32_t queue_max;
+    uint64_t queue_sum;
+    uint32_t queue_samples;
+    uint32_t queue_hist[PLAYBACK_QUEUE_LEN + 1];
+    uint32_t buffered;
+    uint32_t buffer_dropped;
+    uint32_t rate_limited;
+    uint32_t led_coalesced;
+} stats;
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us)
+{
+    if (us <= 0) {
+        return;
+    }
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    nanosleep(&ts, NULL);
+}
+
+static double rand_unit(unsigned *seed)
+{
+    return rand_r(seed) / ((double)RAND_MAX + 1.0);
+}
+
+static uint32_t uid_to_seq(const uint8_t *uid)
+{
+    return ((uint32_t)uid[1] << 16) | ((uint32_t)uid[2] << 8) | uid[3];
+}
+
+// Record a stage time for a tap, keeping the first one if it arrives twice
+static void stamp(const uint8_t *uid, size_t offset)
+{
+    uint32_t seq = uid_to_seq(uid);
+    int64_t t = now_us();
+    pthread_mutex_lock(&sim_lock);
+    if (seq < tap_count) {
+        int64_t *field = (int64_t *)((char *)&taps[seq] + offset);
+        if (*field == 0) {
+            *field = t;
+        }
+    }
+    pthread_mutex_unlock(&sim_lock);
+}
+
+/* ---- Mock Spotify ------------------------------------------------------ */
+
+static int spotify_listen_fd = -1;
+static uint16_t spotify_port;
+
+static void *spotify_thread(void *arg)
+{
+    (void)arg;
+    unsigned seed = cfg.seed * 7919;
+    char buf[1024];
+    while (!stopping) {
+        struct pollfd pfd = {.fd = spotify_listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        int fd = accept(spotify_listen_fd, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        // Read headers and the Content-Length body
+        size_t len = 0;
+        char *body = NULL;
+        long content_len = 0;
+        while (len < sizeof(buf) - 1) {
+            ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (n <= 0) {
+                break;
+            }
+            len += n;
+            buf[len] = '\0';
+            if (body == NULL && (body = strstr(buf, "\r\n\r\n")) != NULL) {
+                body += 4;
+                const char *cl = strcasestr(buf, "Content-Length:");
+                content_len = cl != NULL ? strtol(cl + 15, NULL, 10) : 0;
+            }
+            if (body != NULL && (long)(buf + len - body) >= content_len) {
+                break;
+            }
+        }
+
+        int jitter = cfg.spotify_jitter_ms > 0 ? (int)(rand_unit(&seed) * (2 * cfg.spotify_jitter_ms + 1)) - cfg.spotify_jitter_ms : 0;
+        sleep_us((int64_t)(cfg.spotify_ms + jitter > 0 ? cfg.spotify_ms + jitter : 0) * 1000);
+
+        const char *reply = rand_unit(&seed) * 100 < cfg.spotify_429_pct ?
+                            "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n" :
+                            "HTTP/1.1 204 No Content\r\nContent-Length: 0\r\n\r\n";
+        ssize_t written = write(fd, reply, strlen(reply));
+        (void)written;
+        close(fd);
+    }
+    return NULL;
+}
+
+// One PUT /me/player/play, a fresh connection each time like spotify_client_request()
+static int spotify_play(uint8_t card)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(spotify_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    char body[96];
+    int body_len = snprintf(body, sizeof(body), "{\"context_uri\":\"spotify:album:card%u\"}", card);
+    char req[256];
+    int req_len = snprintf(req, sizeof(req),
+                           "PUT /v1/me/player/play HTTP/1.1\r\nHost: localhost\r\n"
+                           "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                           body_len, body);
+    int status = 0;
+    if (write(fd, req, req_len) == req_len) {
+        char resp[256];
+        ssize_t n = read(fd, resp, sizeof(resp) - 1);
+        if (n > 0) {
+            resp[n] = '\0';
+            sscanf(resp, "HTTP/1.1 %d", &status);
+        }
+    }
+    close(fd);
+    return status;
+}
+
+/* ---- Player: UART task, playback queue and worker ---------------------- */
+
+typedef struct {
+    bool replay;
+    uint8_t uid[PLAYBACK_UID_LEN];
+} sim_cmd_t;
+
+static sim_cmd_t queue[PLAYBACK_QUEUE_LEN];
+static size_t queue_head, queue_len;
+static bool worker_busy;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+
+static void queue_sample_locked(void)
+{
+    stats.queue_hist[queue_len]++;
+    stats.queue_sum += queue_len;
+    stats.queue_samples++;
+    if (queue_len > stats.queue_max) {
+        stats.queue_max = queue_len;
+    }
+}
+
+// playback_submit(): drop the oldest command when full so the newest tap gets through
+static void queue_submit(const sim_cmd_t *cmd, bool front)
+{
+    pthread_mutex_lock(&queue_lock);
+    if (queue_len == PLAYBACK_QUEUE_LEN) {
+        queue_head = (queue_head + 1) % PLAYBACK_QUEUE_LEN;
+        queue_len--;
+        stats.queue_dropped++;
+    }
+    if (front) {
+        queue_head = (queue_head + PLAYBACK_QUEUE_LEN - 1) % PLAYBACK_QUEUE_LEN;
+        queue[queue_head] = *cmd;
+    } else {
+        queue[(queue_head + queue_len) % PLAYBACK_QUEUE_LEN] = *cmd;
+    }
+    queue_len++;
+    queue_sample_locked();
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static bool sim_online(void)
+{
+    int64_t t = now_us() - start_us;
+    return cfg.outage_len_us == 0 || t < cfg.outage_start_us || t >= cfg.outage_start_us + cfg.outage_len_us;
+}
+
+static void play(const uint8_t *uid)
+{
+    int status = spotify_play(uid[0]);
+    pthread_mutex_lock(&sim_lock);
+    if (status == 429) {
+        stats.rate_limited++;
+    }
+    pthread_mutex_unlock(&sim_lock);
+    if (status >= 200 && status < 300) {
+        stamp(uid, offsetof(tap_record_t, done_us));
+    } else {
+        uint32_t seq = uid_to_seq(uid);
+        pthread_mutex_lock(&sim_lock);
+        if (seq < tap_count) {
+            taps[seq].failed = true;
+        }
+        pthread_mutex_unlock(&sim_lock);
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    (void)arg;
+    static tap_buffer_t pending;
+    tap_buffer_init(&pending);
+    bool was_online = true;
+
+    while (1) {
+        pthread_mutex_lock(&queue_lock);
+        worker_busy = false;
+        while (queue_len == 0 && !stopping) {
+            // Poll for the outage ending, as the Wi-Fi event would
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 10 * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&queue_cond, &queue_lock, &ts);
+            if (!was_online && sim_online()) {
+                break;
+            }
+        }
+        bool online = sim_online();
+        if (online && !was_online) {
+            // playback_set_online(true) puts a replay in front of the queue
+            pthread_mutex_unlock(&queue_lock);
+            was_online = true;
+            sim_cmd_t replay = {.replay = true};
+            queue_submit(&replay, true);
+            continue;
+        }
+        if (queue_len == 0) {
+            pthread_mutex_unlock(&queue_lock);
+            if (stopping) {
+                return NULL;
+            }
+            continue;
+        }
+        was_online = online;
+        sim_cmd_t cmd = queue[queue_head];
+        queue_head = (queue_head + 1) % PLAYBACK_QUEUE_LEN;
+        queue_len--;
+        worker_busy = true;
+        queue_sample_locked();
+        pthread_mutex_unlock(&queue_lock);
+
+        if (cmd.replay) {
+            tap_buffer_item_t items[TAP_BUFFER_CAPACITY];
+            size_t n = tap_buffer_drain(&pending, items, TAP_BUFFER_CAPACITY, 1UL << PLAY_KIND, 0,
+                                        now_us(), PENDING_MAX_AGE_US);
+            for (size_t i = 0; i < n; i++) {
+                play(items[i].payload);
+            }
+        } else if (!online) {
+            tap_buffer_item_t item = {.kind = PLAY_KIND, .queued_us = now_us()};
+            memcpy(item.payload, cmd.uid, PLAYBACK_UID_LEN);
+            bool kept_all = tap_buffer_push(&pending, &item);
+            pthread_mutex_lock(&sim_lock);
+            stats.buffered++;
+            stats.buffer_dropped += !kept_all;
+            pthread_mutex_unlock(&sim_lock);
+        } else {
+            play(cmd.uid);
+        }
+    }
+}
+
+static int uart_master_fd = -1;
+static int uart_slave_fd = -1;
+
+static void *uart_rx_thread(void *arg)
+{
+    (void)arg;
+    char data[UART_BUF_SIZE];
+    char line[RX_LINE_SIZE];
+    size_t line_len = 0;
+    bool line_overflow = false;
+    uint8_t uid[UID_CODEC_MAX_LEN];
+    while (!stopping) {
+        struct pollfd pfd = {.fd = uart_slave_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        ssize_t n = read(uart_slave_fd, data, sizeof(data));
+        if (n <= 0) {
+            continue;
+        }
+        // Lines are joined across UART_DATA events, exactly as rx_task() does
+        for (ssize_t i = 0; i < n; i++) {
+            if (data[i] != '\n') {
+                if (line_len < sizeof(line)) {
+                    line[line_len++] = data[i];
+                } else {
+                    line_overflow = true;
+                }
+                continue;
+            }
+            bool parse = !line_overflow;
+            if (line_overflow) {
+                pthread_mutex_lock(&sim_lock);
+                stats.uart_overflow++;
+                pthread_mutex_unlock(&sim_lock);
+            }
+            size_t len = line_len;
+            line_len = 0;
+            line_overflow = false;
+            if (!parse || uid_parse_line(line, len, uid, sizeof(uid)) < PLAYBACK_UID_LEN) {
+                continue;
+            }
+            stamp(uid, offsetof(tap_record_t, uart_us));
+            sim_cmd_t cmd = {.replay = false};
+            memcpy(cmd.uid, uid, PLAYBACK_UID_LEN);
+            queue_submit(&cmd, false);
+        }
+    }
+    return NULL;
+}
+
+/* ---- LED node: ESP-NOW receive callback and fade task ------------------ */
+
+static int led_fd = -1;
+static uint16_t led_port;
+static uint8_t led_pending_uid[PLAYBACK_UID_LEN];
+static bool led_pending;
+static pthread_mutex_t led_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t led_cond = PTHREAD_COND_INITIALIZER;
+
+static void *led_rx_thread(void *arg)
+{
+    (void)arg;
+    char frame[250]; // ESP_NOW_MAX_DATA_LEN
+    uint8_t uid[UID_CODEC_MAX_LEN];
+    while (!stopping) {
+        struct pollfd pfd = {.fd = led_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        ssize_t n = recv(led_fd, frame, sizeof(frame), 0);
+        if (n <= 0) {
+            continue;
+        }
+        size_t uid_len = uid_parse_hex(frame, n, uid, sizeof(uid));
+        if (uid_len < PLAYBACK_UID_LEN) {
+            continue;
+        }
+        stamp(uid, offsetof(tap_record_t, led_rx_us));
+        pthread_mutex_lock(&led_lock);
+        if (led_pending) {
+            // The fade task hasn't picked up the previous tap yet; only the latest mood is shown
+            stats.led_coalesced++;
+        }
+        memcpy(led_pending_uid, uid, PLAYBACK_UID_LEN);
+        led_pending = true;
+        pthread_cond_signal(&led_cond);
+        pthread_mutex_unlock(&led_lock);
+    }
+    return NULL;
+}
+
+static void *led_render_thread(void *arg)
+{
+    (void)arg;
+    uint8_t uid[PLAYBACK_UID_LEN];
+    while (1) {
+        pthread_mutex_lock(&led_lock);
+        while (!led_pending && !stopping) {
+            pthread_cond_wait(&led_cond, &led_lock);
+        }
+        if (!led_pending) {
+            pthread_mutex_unlock(&led_lock);
+            return NULL;
+        }
+        memcpy(uid, led_pending_uid, PLAYBACK_UID_LEN);
+        led_pending = false;
+        pthread_mutex_unlock(&led_lock);
+
+        // First frame of the new mood goes out over RMT
+        sleep_us(cfg.led_frame_us);
+        stamp(uid, offsetof(tap_record_t, led_us));
+    }
+}
+
+/* ---- Tap generator ----------------------------------------------------- */
+
+static void inject(int reader, uint8_t card, int copies, bool espnow_lost)
+{
+    pthread_mutex_lock(&sim_lock);
+    if (tap_count == MAX_TAPS) {
+        pthread_mutex_unlock(&sim_lock);
+        return;
+    }
+    uint32_t seq = tap_count++;
+    taps[seq].inject_us = now_us();
+    dup_count += copies - 1;
+    pthread_mutex_unlock(&sim_lock);
+
+    uint8_t uid[PLAYBACK_UID_LEN] = {card, (uint8_t)(seq >> 16), (uint8_t)(seq >> 8), (uint8_t)seq};
+    char hex[UID_CODEC_TEXT_SIZE(PLAYBACK_UID_LEN)];
+    size_t hex_len = uid_format_hex(uid, sizeof(uid), hex, sizeof(hex));
+    char line[64];
+    int line_len = snprintf(line, sizeof(line), WAKE_PREAMBLE "UID:%s\n", hex);
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(led_port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    for (int c = 0; c < copies; c++) {
+        if (!espnow_lost) {
+            sendto(sock, hex, hex_len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        }
+        ssize_t written = write(uart_master_fd, line, line_len);
+        (void)written;
+        // The readers share the player's UART, the line is busy for 10 bits per byte
+        sleep_us((int64_t)line_len * 10 * 1000000 / cfg.baud);
+    }
+    close(sock);
+    (void)reader;
+}
+
+static void generate(void)
+{
+    unsigned seed = cfg.seed;
+    int64_t *next_us = calloc(cfg.readers, sizeof(int64_t));
+    int *burst_left = calloc(cfg.readers, sizeof(int));
+    uint8_t *reader_card = calloc(cfg.readers, 1);
+    int64_t end_us = start_us + (int64_t)(cfg.duration_s * 1e6);
+    int64_t period_us = (int64_t)(1e6 / cfg.rate_hz);
+
+    for (int r = 0; r < cfg.readers; r++) {
+        // Stagger the readers so steady patterns don't collide on every tap
+        next_us[r] = start_us + period_us * r / cfg.readers;
+        reader_card[r] = 1 + rand_r(&seed) % cfg.cards;
+        burst_left[r] = cfg.burst;
+    }
+
+    while (1) {
+        int r = 0;
+        for (int i = 1; i < cfg.readers; i++) {
+            if (next_us[i] < next_us[r]) {
+                r = i;
+            }
+        }
+        if (next_us[r] >= end_us) {
+            break;
+        }
+        sleep_us(next_us[r] - now_us());
+
+        uint8_t card = cfg.pattern == PATTERN_SPAM ? reader_card[r] : 1 + rand_r(&seed) % cfg.cards;
+        int copies = rand_unit(&seed) * 100 < cfg.dup_pct ? 2 : 1;
+        bool lost = rand_unit(&seed) * 100 < cfg.espnow_loss_pct;
+        inject(r, card, copies, lost);
+
+        switch (cfg.pattern) {
+        case PATTERN_POISSON:
+            next_us[r] += (int64_t)(-log(1.0 - rand_unit(&seed)) * period_us);
+            break;
+        case PATTERN_BURST:
+            if (--burst_left[r] > 0) {
+                next_us[r] += BURST_SPACING_US;
+            } else {
+                burst_left[r] = cfg.burst;
+                next_us[r] += period_us;
+            }
+            break;
+        default:
+            next_us[r] += period_us;
+            break;
+        }
+    }
+    free(next_us);
+    free(burst_left);
+    free(reader_card);
+}
+
+// Wait for the pipeline to go idle once the taps stop
+static void drain(void)
+{
+    int64_t deadline = now_us() + DRAIN_TIMEOUT_US + cfg.outage_len_us;
+    int idle_polls = 0;
+    while (now_us() < deadline && idle_polls < 20) {
+        sleep_us(20000);
+        pthread_mutex_lock(&queue_lock);
+        bool idle = queue_len == 0 && !worker_busy && sim_online();
+        pthread_mutex_unlock(&queue_lock);
+        idle_polls = idle ? idle_polls + 1 : 0;
+    }
+}
+
+/* ---- Report ------------------------------------------------------------ */
+
+static void print_latency(const char *name, size_t from, size_t to)
+{
+    latency_stats_t lat;
+    latency_stats_reset(&lat);
+    for (uint32_t i = 0; i < tap_count; i++) {
+        int64_t a = *(int64_t *)((char *)&taps[i] + from);
+        int64_t b = *(int64_t *)((char *)&taps[i] + to);
+        if (a != 0 && b != 0) {
+            latency_stats_add(&lat, (uint32_t)(b - a));
+        }
+    }
+    printf("  %-20s %6u %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, lat.count,
+           latency_stats_mean(&lat) / 1e3, latency_stats_percentile(&lat, 50) / 1e3,
+           latency_stats_percentile(&lat, 90) / 1e3, latency_stats_percentile(&lat, 99) / 1e3,
+           lat.max_us / 1e3);
+}
+
+static void report(void)
+{
+    static const char *pattern_names[] = {"steady", "poisson", "burst", "spam"};
+    uint32_t uart_seen = 0, done = 0, failed = 0, led_rx = 0, led_shown = 0;
+    for (uint32_t i = 0; i < tap_count; i++) {
+        uart_seen += taps[i].uart_us != 0;
+        done += taps[i].done_us != 0;
+        failed += taps[i].failed && taps[i].done_us == 0;
+        led_rx += taps[i].led_rx_us != 0;
+        led_shown += taps[i].led_us != 0;
+    }
+
+    printf("pattern %s, %d reader(s) at %.2f Hz for %.1f s, spotify %d+-%d ms, %d%% 429\n",
+           pattern_names[cfg.pattern], cfg.readers, cfg.rate_hz, cfg.duration_s,
+           cfg.spotify_ms, cfg.spotify_jitter_ms, cfg.spotify_429_pct);
+    printf("\ntaps\n");
+    printf("  injected             %6u  (+%u duplicate deliveries)\n", tap_count, dup_count);
+    printf("  parsed from uart     %6u  lost %u (%u lines too long)\n",
+           uart_seen, tap_count - uart_seen, stats.uart_overflow);
+    printf("  played on spotify    %6u  failed %u (%u rate limited), dropped or superseded %u\n",
+           done, failed, stats.rate_limited, uart_seen - done - failed);
+    printf("  led frames received  %6u  lost %u\n", led_rx, tap_count - led_rx);
+    printf("  led moods shown      %6u  coalesced %u\n", led_shown, stats.led_coalesced);
+
+    printf("\nplayback queue (%d slots)\n", PLAYBACK_QUEUE_LEN);
+    printf("  dropped oldest       %6u\n", stats.queue_dropped);
+    printf("  offline buffered     %6u  overwritten %u\n", stats.buffered, stats.buffer_dropped);
+    printf("  depth max %u, mean %.2f, histogram", stats.queue_max,
+           stats.queue_samples ? (double)stats.queue_sum / stats.queue_samples : 0.0);
+    for (int i = 0; i <= PLAYBACK_QUEUE_LEN; i++) {
+        printf(" %u", stats.queue_hist[i]);
+    }
+    printf("\n\nlatency (ms)               n     mean      p50      p90      p99      max\n");
+    print_latency("tap -> uart parse", offsetof(tap_record_t, inject_us), offsetof(tap_record_t, uart_us));
+    print_latency("tap -> spotify", offsetof(tap_record_t, inject_us), offsetof(tap_record_t, done_us));
+    print_latency("tap -> led frame rx", offsetof(tap_record_t, inject_us), offsetof(tap_record_t, led_rx_us));
+    print_latency("tap -> led shown", offsetof(tap_record_t, inject_us), offsetof(tap_record_t, led_us));
+}
+
+/* ---- Setup ------------------------------------------------------------- */
+
+static int open_uart_pty(void)
+{
+    uart_master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (uart_master_fd < 0 || grantpt(uart_master_fd) != 0 || unlockpt(uart_master_fd) != 0) {
+        return -1;
+    }
+    uart_slave_fd = open(ptsname(uart_master_fd), O_RDWR | O_NOCTTY);
+    if (uart_slave_fd < 0) {
+        return -1;
+    }
+    // Raw bytes, no echo or line discipline, like the UART driver
+    struct termios tio;
+    tcgetattr(uart_slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(uart_slave_fd, TCSANOW, &tio);
+    return 0;
+}
+
+static int open_loopback(int type, uint16_t *port)
+{
+    int fd = socket(AF_INET, type, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t len = sizeof(addr);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (type == SOCK_STREAM && listen(fd, 16) != 0) ||
+        getsockname(fd, (struct sockaddr *)&addr, &len) != 0) {
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--pattern steady|poisson|burst|spam] [--readers N] [--rate HZ]\n"
+            "          [--duration S] [--burst N] [--cards N] [--dup-pct P] [--espnow-loss-pct P]\n"
+            "          [--spotify-ms MS] [--spotify-jitter-ms MS] [--spotify-429-pct P]\n"
+            "          [--outage START_MS:LEN_MS] [--baud B] [--led-frame-us US] [--seed N]\n",
+            argv0);
+    exit(2);
+}
+
+static void parse_args(int argc, char **argv)
+{
+    static const struct option options[] = {
+        {"pattern", required_argument, NULL, 'p'},
+        {"readers", required_argument, NULL, 'r'},
+        {"rate", required_argument, NULL, 'R'},
+        {"duration", required_argument, NULL, 'd'},
+        {"burst", required_argument, NULL, 'b'},
+        {"cards", required_argument, NULL, 'c'},
+        {"dup-pct", required_argument, NULL, 'D'},
+        {"espnow-loss-pct", required_argument, NULL, 'L'},
+        {"spotify-ms", required_argument, NULL, 's'},
+        {"spotify-jitter-ms", required_argument, NULL, 'j'},
+        {"spotify-429-pct", required_argument, NULL, 'q'},
+        {"outage", required_argument, NULL, 'o'},
+        {"baud", required_argument, NULL, 'B'},
+        {"led-frame-us", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 'S'},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+        case 'p':
+            if (strcmp(optarg, "steady") == 0) {
+                cfg.pattern = PATTERN_STEADY;
+            } else if (strcmp(optarg, "poisson") == 0) {
+                cfg.pattern = PATTERN_POISSON;
+            } else if (strcmp(optarg, "burst") == 0) {
+                cfg.pattern = PATTERN_BURST;
+            } else if (strcmp(optarg, "spam") == 0) {
+                cfg.pattern = PATTERN_SPAM;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'r': cfg.readers = atoi(optarg); break;
+        case 'R': cfg.rate_hz = atof(optarg); break;
+        case 'd': cfg.duration_s = atof(optarg); break;
+        case 'b': cfg.burst = atoi(optarg); break;
+        case 'c': cfg.cards = atoi(optarg); break;
+        case 'D': cfg.dup_pct = atoi(optarg); break;
+        case 'L': cfg.espnow_loss_pct = atoi(optarg); break;
+        case 's': cfg.spotify_ms = atoi(optarg); break;
+        case 'j': cfg.spotify_jitter_ms = atoi(optarg); break;
+        case 'q': cfg.spotify_429_pct = atoi(optarg); break;
+        case 'o': {
+            long start_ms = 0, len_ms = 0;
+            if (sscanf(optarg, "%ld:%ld", &start_ms, &len_ms) != 2) {
+                usage(argv[0]);
+            }
+            cfg.outage_start_us = start_ms * 1000;
+            cfg.outage_len_us = len_ms * 1000;
+            break;
+        }
+        case 'B': cfg.baud = atoi(optarg); break;
+        case 'f': cfg.led_frame_us = atoi(optarg); break;
+        case 'S': cfg.seed = strtoul(optarg, NULL, 10); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (cfg.readers < 1 || cfg.rate_hz <= 0 || cfg.duration_s <= 0 || cfg.burst < 1 ||
+        cfg.cards < 1 || cfg.cards > 255 || cfg.baud <= 0) {
+        usage(argv[0]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    parse_args(argc, argv);
+    taps = calloc(MAX_TAPS, sizeof(*taps));
+    if (taps == NULL || open_uart_pty() != 0 ||
+        (spotify_listen_fd = open_loopback(SOCK_STREAM, &spotify_port)) < 0 ||
+        (led_fd = open_loopback(SOCK_DGRAM, &led_port)) < 0) {
+        perror("tap_storm: setup");
+        return 1;
+    }
+
+    pthread_t threads[5];
+    void *(*entry[5])(void *) = {spotify_thread, worker_thread, uart_rx_thread, led_rx_thread, led_render_thread};
+    start_us = now_us();
+    for (int i = 0; i < 5; i++) {
+        pthread_create(&threads[i], NULL, entry[i], NULL);
+    }
+
+    generate();
+    drain();
+
+    stopping = true;
+    pthread_mutex_lock(&queue_lock);
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_lock(&led_lock);
+    pthread_cond_broadcast(&led_cond);
+    pthread_mutex_unlock(&led_lock);
+    for (int i = 0; i < 5; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    report();
+    free(taps);
+    return 0;
+}
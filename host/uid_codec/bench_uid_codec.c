@@ -0,0 +1,98 @@
+// Throughput benchmark for components/uid_codec.
+//
+// Feeds the parser the kinds of input the firmware sees: clean UART lines,
+// ESP-NOW frames, lines buried in other serial output, and 7-byte UIDs.
+//
+//   bench_uid_codec [iterations]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "uid_codec.h"
+
+#define BENCH_INPUTS 256
+
+typedef struct {
+    const char *name;
+    char text[BENCH_INPUTS][160];
+    size_t len[BENCH_INPUTS];
+} bench_set_t;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void fill_uid(uint8_t *uid, size_t len, uint32_t *seed)
+{
+    for (size_t i = 0; i < len; i++) {
+        *seed = *seed * 1103515245u + 12345u;
+        uid[i] = (uint8_t)(*seed >> 16);
+    }
+}
+
+static void make_set(bench_set_t *set, const char *name, size_t uid_len, const char *prefix, const char *suffix)
+{
+    uint32_t seed = 1;
+    set->name = name;
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        uint8_t uid[UID_CODEC_MAX_LEN];
+        char hex[UID_CODEC_TEXT_SIZE(UID_CODEC_MAX_LEN)];
+        fill_uid(uid, uid_len, &seed);
+        uid_format_hex(uid, uid_len, hex, sizeof(hex));
+        set->len[i] = snprintf(set->text[i], sizeof(set->text[i]), "%s%s%s", prefix, hex, suffix);
+    }
+}
+
+static void run(const bench_set_t *set, size_t (*parse)(const char *, size_t, uint8_t *, size_t), long iterations)
+{
+    uint8_t uid[UID_CODEC_MAX_LEN];
+    size_t bytes = 0;
+    unsigned checksum = 0;
+    uint64_t start = now_ns();
+    for (long it = 0; it < iterations; it++) {
+        for (int i = 0; i < BENCH_INPUTS; i++) {
+            checksum += parse(set->text[i], set->len[i], uid, sizeof(uid));
+            checksum += uid[0];
+            bytes += set->len[i];
+        }
+    }
+    uint64_t elapsed = now_ns() - start;
+    double calls = (double)iterations * BENCH_INPUTS;
+    printf("%-22s %8.1f ns/parse %8.1f MB/s  (checksum %u)\n",
+           set->name, elapsed / calls, bytes * 1e3 / elapsed, checksum);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : 20000;
+    static bench_set_t uart, uart_noisy, uart_7byte, espnow;
+
+    make_set(&uart, "uart line", 4, "UID:", "\r\n");
+    make_set(&uart_noisy, "uart line after noise",
+             4, "ets Jun  8 2016 00:22:57\r\nrst:0x1 (POWERON_RESET),boot:0x13\r\nUID:", "\r\n");
+    make_set(&uart_7byte, "uart line, 7 byte uid", 7, "UID:", "\r\n");
+    make_set(&espnow, "espnow frame", 4, "", "");
+
+    run(&uart, uid_parse_line, iterations);
+    run(&uart_noisy, uid_parse_line, iterations);
+    run(&uart_7byte, uid_parse_line, iterations);
+    run(&espnow, uid_parse_hex, iterations);
+
+    // Formatting, as done by the sender and the log lines
+    uint8_t uid[4] = {0x33, 0xA4, 0x1F, 0x0B};
+    char text[UID_CODEC_TEXT_SIZE(UID_CODEC_MAX_LEN)];
+    size_t total = 0;
+    uint64_t start = now_ns();
+    for (long it = 0; it < iterations * BENCH_INPUTS; it++) {
+        uid[3] = (uint8_t)it;
+        total += uid_format_hex(uid, sizeof(uid), text, sizeof(text));
+    }
+    uint64_t elapsed = now_ns() - start;
+    printf("%-22s %8.1f ns/call  (%zu chars)\n", "format", (double)elapsed / (iterations * BENCH_INPUTS), total);
+    return 0;
+}
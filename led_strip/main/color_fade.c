@@ -0,0 +1,91 @@
+#include <math.h>
+#include "pixel_kernels.h"
+#include "color_fade.h"
+
+// OKLab as published by Björn Ottosson, https://bottosson.github.io/posts/oklab/
+
+typedef struct {
+    float l, a, b;
+} oklab_t;
+
+static float srgb_to_linear(uint8_t c)
+{
+    float x = c / 255.0f;
+    return x <= 0.04045f ? x / 12.92f : powf((x + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float x)
+{
+    if (x <= 0.0f) {
+        return 0;
+    }
+    if (x >= 1.0f) {
+        return 255;
+    }
+    float s = x <= 0.0031308f ? x * 12.92f : 1.055f * powf(x, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)(s * 255.0f + 0.5f);
+}
+
+static oklab_t rgb_to_oklab(const uint8_t rgb[3])
+{
+    float r = srgb_to_linear(rgb[0]);
+    float g = srgb_to_linear(rgb[1]);
+    float b = srgb_to_linear(rgb[2]);
+
+    float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+    float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+    float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+
+    return (oklab_t) {
+        .l = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+        .a = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+        .b = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s,
+    };
+}
+
+static void oklab_to_rgb(oklab_t lab, uint8_t rgb[3])
+{
+    float l = lab.l + 0.3963377774f * lab.a + 0.2158037573f * lab.b;
+    float m = lab.l - 0.1055613458f * lab.a - 0.0638541728f * lab.b;
+    float s = lab.l - 0.0894841775f * lab.a - 1.2914855480f * lab.b;
+    l = l * l * l;
+    m = m * m * m;
+    s = s * s * s;
+
+    rgb[0] = linear_to_srgb(4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s);
+    rgb[1] = linear_to_srgb(-1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s);
+    rgb[2] = linear_to_srgb(-0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s);
+}
+
+void color_ramp_build(color_ramp_t *ramp, const uint8_t from[3], const uint8_t to[3])
+{
+    oklab_t start = rgb_to_oklab(from);
+    oklab_t end = rgb_to_oklab(to);
+    for (int i = 0; i <= COLOR_RAMP_STEPS; i++) {
+        float t = (float)i / COLOR_RAMP_STEPS;
+        oklab_t lab = {
+            .l = start.l + (end.l - start.l) * t,
+            .a = start.a + (end.a - start.a) * t,
+            .b = start.b + (end.b - start.b) * t,
+        };
+        oklab_to_rgb(lab, ramp->rgb[i]);
+    }
+    // Pin the ends so the fade starts and lands on the exact colors
+    for (int c = 0; c < 3; c++) {
+        ramp->rgb[0][c] = from[c];
+        ramp->rgb[COLOR_RAMP_STEPS][c] = to[c];
+    }
+}
+
+void color_ramp_at(const color_ramp_t *ramp, uint16_t pos, uint8_t rgb[3])
+{
+    // pos * COLOR_RAMP_STEPS in 16.16 fixed point: entry index and the fraction to the next one
+    uint32_t scaled = (uint32_t)pos * COLOR_RAMP_STEPS;
+    uint32_t index = scaled >> 16;
+    uint32_t frac = (scaled >> 8) & 0xFF;
+    if (index >= COLOR_RAMP_STEPS) {
+        index = COLOR_RAMP_STEPS - 1;
+        frac = 256;
+    }
+    pixel_unpack(pixel_blend(pixel_pack(ramp->rgb[index]), pixel_pack(ramp->rgb[index + 1]), frac), rgb);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COLOR_RAMP_STEPS 64 /*!< Entries in a crossfade table, the frames in between are interpolated */
+
+/**
+ * @brief Precomputed crossfade between two colors
+ */
+typedef struct {
+    uint8_t rgb[COLOR_RAMP_STEPS + 1][3]; /*!< R, G, B from the start color (0) to the end color (COLOR_RAMP_STEPS) */
+} color_ramp_t;
+
+/**
+ * @brief Build a crossfade table that interpolates in OKLab
+ *
+ * Interpolating in a perceptual space keeps the perceived lightness and hue
+ * moving evenly, instead of dipping through grey or jumping in brightness
+ * the way a straight RGB mix does. All color-space math happens here, once per
+ * transition.
+ *
+ * @param[out] ramp Table to fill
+ * @param[in] from Start color, sRGB R, G, B
+ * @param[in] to End color, sRGB R, G, B
+ */
+void color_ramp_build(color_ramp_t *ramp, const uint8_t from[3], const uint8_t to[3]);
+
+/**
+ * @brief Look up the color at a position of the crossfade
+ *
+ * @param[in] ramp Table built by color_ramp_build()
+ * @param[in] pos Position from 0 (start color) to 65535 (end color)
+ * @param[out] rgb Color at that position
+ */
+void color_ramp_at(const color_ramp_t *ramp, uint16_t pos, uint8_t rgb[3]);
+
+#ifdef __cplusplus
+}
+#endif
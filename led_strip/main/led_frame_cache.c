@@ -0,0 +1,68 @@
+#include <string.h>
+#include "led_frame_cache.h"
+
+#define LED_FRAME_BYTES_PER_PIXEL 3
+
+void led_frame_cache_init(led_frame_cache_t *cache, led_frame_cache_entry_t *entries, uint8_t *frames,
+                          uint32_t count, size_t max_frame_bytes)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->entries = entries;
+    cache->count = count;
+    cache->max_frame_bytes = max_frame_bytes;
+    for (uint32_t i = 0; i < count; i++) {
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].frame = frames + i * max_frame_bytes;
+    }
+}
+
+static uint32_t led_frame_hash(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool led_frame_is_solid(const uint8_t *data, size_t size)
+{
+    if (size < 2 * LED_FRAME_BYTES_PER_PIXEL || size % LED_FRAME_BYTES_PER_PIXEL != 0) {
+        return false;
+    }
+    // Each pixel equals the one before it, compared a whole frame minus one pixel at a time
+    return memcmp(data, data + LED_FRAME_BYTES_PER_PIXEL, size - LED_FRAME_BYTES_PER_PIXEL) == 0;
+}
+
+led_frame_path_t led_frame_cache_select(led_frame_cache_t *cache, const uint8_t *data, size_t size, uint8_t brightness,
+                                        uint32_t *index)
+{
+    if (led_frame_is_solid(data, size)) {
+        return LED_FRAME_SOLID;
+    }
+    if (brightness != UINT8_MAX || cache->count == 0 || size > cache->max_frame_bytes) {
+        return brightness != UINT8_MAX ? LED_FRAME_SCALED : LED_FRAME_BYTES;
+    }
+
+    uint32_t hash = led_frame_hash(data, size);
+    uint32_t victim = 0;
+    cache->use_counter++;
+    for (uint32_t i = 0; i < cache->count; i++) {
+        led_frame_cache_entry_t *entry = &cache->entries[i];
+        if (entry->frame_bytes == size && entry->hash == hash && memcmp(entry->frame, data, size) == 0) {
+            entry->last_used = cache->use_counter;
+            *index = i;
+            return LED_FRAME_CACHE_HIT;
+        }
+        if (entry->last_used < cache->entries[victim].last_used) {
+            victim = i;
+        }
+    }
+    led_frame_cache_entry_t *entry = &cache->entries[victim];
+    entry->hash = hash;
+    entry->last_used = cache->use_counter;
+    entry->frame_bytes = size;
+    memcpy(entry->frame, data, size);
+    *index = victim;
+    return LED_FRAME_CACHE_MISS;
+}
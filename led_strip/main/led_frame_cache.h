@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief How the strip encoder sends a frame, as picked by led_frame_cache_select()
+ */
+typedef enum {
+    LED_FRAME_SOLID,      /*!< Every pixel has the same color, one pixel is encoded and repeated */
+    LED_FRAME_CACHE_HIT,  /*!< The frame's symbols are in the cache */
+    LED_FRAME_CACHE_MISS, /*!< The frame was given a cache entry, the caller encodes it there */
+    LED_FRAME_SCALED,     /*!< Encoded as it is sent, with the brightness applied to each byte */
+    LED_FRAME_BYTES,      /*!< Sent as is, without the cache */
+} led_frame_path_t;
+
+/**
+ * @brief One cached frame, the caller keeps its encoded form at the same index
+ */
+typedef struct {
+    uint32_t hash;
+    uint32_t last_used;  /*!< LRU stamp */
+    size_t frame_bytes;  /*!< 0 if the entry is empty */
+    uint8_t *frame;      /*!< Copy of the pixel data, to rule out hash collisions */
+} led_frame_cache_entry_t;
+
+/**
+ * @brief Frame cache of the strip encoder, free of any driver dependency
+ *
+ * Entries are keyed on the unscaled pixel data and hold the frame encoded at
+ * full brightness. A frame sent at any other brightness has to be encoded
+ * byte by byte anyway, so it neither uses nor evicts an entry: a breathing
+ * pattern doesn't push the static frames out.
+ */
+typedef struct {
+    led_frame_cache_entry_t *entries;
+    uint32_t count;
+    size_t max_frame_bytes;
+    uint32_t use_counter;
+} led_frame_cache_t;
+
+/**
+ * @brief Set up an empty cache over caller-owned memory
+ *
+ * @param entries count entries
+ * @param frames count * max_frame_bytes bytes for the frame copies
+ * @param count Number of entries, 0 disables the cache
+ * @param max_frame_bytes Largest frame that is cached
+ */
+void led_frame_cache_init(led_frame_cache_t *cache, led_frame_cache_entry_t *entries, uint8_t *frames,
+                          uint32_t count, size_t max_frame_bytes);
+
+/**
+ * @brief Pick how a frame is sent and look it up in the cache if that applies
+ *
+ * On LED_FRAME_CACHE_MISS the least recently used entry already holds the
+ * new frame's key, the caller fills in its encoded form.
+ *
+ * @param[out] index Entry of a hit or miss
+ */
+led_frame_path_t led_frame_cache_select(led_frame_cache_t *cache, const uint8_t *data, size_t size, uint8_t brightness,
+                                        uint32_t *index);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+#include <string.h>
+#include <math.h>
+#include "pixel_kernels.h"
+#include "led_render.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// One fade cycle of brightness, so a frame only does a table lookup
+static uint8_t fade_wave[LED_RENDER_WAVE_STEPS];
+static bool fade_wave_built = false;
+
+void led_render_init(led_render_t *render, uint8_t *pixels, size_t led_count,
+                     uint32_t fade_period_ms, uint32_t crossfade_ms)
+{
+    if (!fade_wave_built) {
+        for (int i = 0; i < LED_RENDER_WAVE_STEPS; i++) {
+            fade_wave[i] = (uint8_t)(255.0f * 0.5f * (1.0f + sinf(2.0f * M_PI * i / LED_RENDER_WAVE_STEPS)));
+        }
+        fade_wave_built = true;
+    }
+    memset(render, 0, sizeof(*render));
+    render->pixels = pixels;
+    render->led_count = led_count;
+    render->fade_period_us = fade_period_ms * 1000LL;
+    render->crossfade_us = crossfade_ms * 1000LL;
+    render->last_brightness = -1;
+    memset(pixels, 0, led_count * 3);
+    // Nothing to blend from yet, a first color fades in from off
+    color_ramp_build(&render->crossfade, render->shown_rgb, render->shown_rgb);
+}
+
+void led_render_set_color(led_render_t *render, const uint8_t rgb[3], bool jump, int64_t now_us)
+{
+    // Blend from whatever is on the strip now, which may be the middle of the previous crossfade
+    memcpy(render->target_rgb, rgb, sizeof(render->target_rgb));
+    color_ramp_build(&render->crossfade, jump ? rgb : render->shown_rgb, rgb);
+    render->crossfade_start_us = now_us;
+}
+
+bool led_render_settled(const led_render_t *render, int64_t now_us)
+{
+    return now_us - render->crossfade_start_us >= render->crossfade_us;
+}
+
+bool led_render_frame(led_render_t *render, int64_t phase_us, int64_t now_us)
+{
+    // Look up the position within the fade cycle
+    int64_t elapsed = phase_us % render->fade_period_us;
+    render->brightness = fade_wave[elapsed * LED_RENDER_WAVE_STEPS / render->fade_period_us];
+
+    // The pattern only changes during the crossfade, the fade itself is applied by the sink
+    uint8_t rgb[3];
+    int64_t crossfade_elapsed = now_us - render->crossfade_start_us;
+    if (crossfade_elapsed < render->crossfade_us) {
+        color_ramp_at(&render->crossfade, (uint16_t)(crossfade_elapsed * 65535 / render->crossfade_us), rgb);
+    } else {
+        memcpy(rgb, render->target_rgb, sizeof(rgb));
+    }
+    bool color_changed = memcmp(rgb, render->shown_rgb, sizeof(rgb)) != 0;
+    if (color_changed) {
+        pixel_fill_grb(render->pixels, render->led_count, pixel_pack(rgb));
+        memcpy(render->shown_rgb, rgb, sizeof(rgb));
+    }
+
+    // Unchanged frames are skipped, the strip latches the last one
+    bool changed = color_changed || render->brightness != render->last_brightness;
+    render->last_brightness = render->brightness;
+    return changed;
+}
+
+int led_render_step(led_render_t *render, led_sink_t *sink, int64_t phase_us, int64_t now_us)
+{
+    if (!led_render_frame(render, phase_us, now_us)) {
+        return 0;
+    }
+    return sink->show(sink, render->pixels, render->led_count, render->brightness);
+}
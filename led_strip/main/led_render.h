@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "color_fade.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LED_RENDER_WAVE_STEPS 256 /*!< Brightness table entries per fade cycle */
+
+/**
+ * @brief Where rendered frames go: the RMT channel on the strip, a file or a terminal on a host
+ *
+ * show() gets led_count pixels in strip order, 3 bytes each in G, R, B order,
+ * and the global brightness the strip applies to every byte on the way out
+ * (byte * (brightness + 1) / 256). It returns 0 on success.
+ */
+typedef struct led_sink led_sink_t;
+struct led_sink {
+    int (*show)(led_sink_t *sink, const uint8_t *pixels, size_t led_count, uint8_t brightness);
+};
+
+/**
+ * @brief Frame generator for one strip, free of any driver or RTOS dependency
+ *
+ * The strip shows one color at a time, breathing with a sine wave whose phase
+ * comes from the caller's clock. A new color is reached with an OKLab
+ * crossfade from whatever is shown at that moment.
+ */
+typedef struct {
+    uint8_t *pixels;           /*!< led_count * 3 bytes, G, R, B */
+    size_t led_count;
+    int64_t fade_period_us;    /*!< One full breath */
+    int64_t crossfade_us;      /*!< Time to blend into a new color */
+    int64_t crossfade_start_us;
+    uint8_t target_rgb[3];     /*!< Color being faded to, R, G, B */
+    uint8_t shown_rgb[3];      /*!< Color in pixels, R, G, B */
+    uint8_t brightness;        /*!< Brightness of the last frame */
+    int last_brightness;       /*!< Brightness last reported as changed, -1 before the first frame */
+    color_ramp_t crossfade;
+} led_render_t;
+
+/**
+ * @brief Set up a renderer over a pixel buffer, all pixels off
+ *
+ * @param pixels Buffer of led_count * 3 bytes, owned by the caller
+ * @param led_count Pixels on the strip
+ * @param fade_period_ms Duration of one breath
+ * @param crossfade_ms Duration of a color change
+ */
+void led_render_init(led_render_t *render, uint8_t *pixels, size_t led_count,
+                     uint32_t fade_period_ms, uint32_t crossfade_ms);
+
+/**
+ * @brief Start moving to a new color
+ *
+ * @param rgb Target color, R, G, B
+ * @param jump Show the color from the next frame on instead of crossfading,
+ *        used when resuming after a reset
+ * @param now_us Caller's clock at the start of the change
+ */
+void led_render_set_color(led_render_t *render, const uint8_t rgb[3], bool jump, int64_t now_us);
+
+/**
+ * @brief Render the frame for a moment in time
+ *
+ * Only rewrites the pixels while the color is changing; the breath is
+ * carried by render->brightness alone.
+ *
+ * @param phase_us Clock that sets the breathing phase, shared by all strips
+ * @param now_us Clock of led_render_set_color(), for the crossfade
+ * @return true if the frame differs from the last one and has to be shown
+ */
+bool led_render_frame(led_render_t *render, int64_t phase_us, int64_t now_us);
+
+/**
+ * @brief Whether the crossfade to the last color is over
+ */
+bool led_render_settled(const led_render_t *render, int64_t now_us);
+
+/**
+ * @brief Render a frame and hand it to a sink if it changed
+ *
+ * @return 0 if nothing had to be shown, otherwise the result of sink->show()
+ */
+int led_render_step(led_render_t *render, led_sink_t *sink, int64_t phase_us, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
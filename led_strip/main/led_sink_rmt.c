@@ -0,0 +1,32 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "led_sink_rmt.h"
+
+static int led_sink_rmt_show(led_sink_t *base, const uint8_t *pixels, size_t led_count, uint8_t brightness)
+{
+    led_sink_rmt_t *sink = (led_sink_rmt_t *)base;
+    esp_err_t err = led_strip_encoder_set_brightness(sink->encoder, brightness);
+    // An enabled channel holds a PM lock that keeps the chip out of light sleep, so it is only enabled for the frame
+    if (err == ESP_OK) {
+        err = rmt_enable(sink->channel);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = rmt_transmit(sink->channel, sink->encoder, pixels, led_count * 3, &sink->tx_config);
+    if (err == ESP_OK) {
+        err = rmt_tx_wait_all_done(sink->channel, portMAX_DELAY);
+    }
+    // The line idles low once the frame is out, so the strip keeps showing it
+    esp_err_t disable_err = rmt_disable(sink->channel);
+    return err != ESP_OK ? err : disable_err;
+}
+
+esp_err_t led_sink_rmt_init(led_sink_rmt_t *sink, rmt_channel_handle_t channel, const led_strip_encoder_config_t *config)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->base.show = led_sink_rmt_show;
+    sink->channel = channel;
+    sink->tx_config.loop_count = 0;
+    return rmt_new_led_strip_encoder(config, &sink->encoder);
+}
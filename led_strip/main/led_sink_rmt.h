@@ -0,0 +1,40 @@
+#pragma once
+
+#include "esp_err.h"
+#include "driver/rmt_tx.h"
+#include "led_strip_encoder.h"
+#include "led_render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sink that sends frames to the strip through an RMT channel
+ *
+ * The brightness of each frame is handed to the encoder, which scales the
+ * bytes while it encodes them. show() returns once the frame is on the strip.
+ * The channel is only enabled while show() sends a frame: an enabled channel
+ * holds a power management lock, and the strip latches the last frame anyway,
+ * so between frames and while the strip is off the chip can light sleep.
+ */
+typedef struct {
+    led_sink_t base;
+    rmt_channel_handle_t channel;
+    rmt_encoder_handle_t encoder;
+    rmt_transmit_config_t tx_config;
+} led_sink_rmt_t;
+
+/**
+ * @brief Create the strip encoder and set up the sink around a disabled channel
+ *
+ * @param[out] sink Sink to initialize
+ * @param[in] channel RMT TX channel, not enabled; the sink enables it for each frame
+ * @param[in] config Encoder configuration
+ * @return ESP_OK, or the error of rmt_new_led_strip_encoder()
+ */
+esp_err_t led_sink_rmt_init(led_sink_rmt_t *sink, rmt_channel_handle_t channel, const led_strip_encoder_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "led_state.h"
+
+#define LED_STATE_MAGIC           0x3154534C // "LST1"
+#define LED_STATE_NVS_NAMESPACE   "led_state"
+#define LED_STATE_NVS_KEY         "state"
+#define LED_STATE_NVS_SETTLE_MS   5000  // a new color must hold this long before it is written to flash
+#define LED_STATE_NVS_INTERVAL_MS 60000 // and flash is written at most this often
+#define LED_STATE_MAX_GAP_US      (24 * 3600 * 1000000LL) // longer resets are treated as a lost clock
+
+static const char *TAG = "led_state";
+
+// Layout shared by the RTC and NVS copies
+typedef struct {
+    uint32_t magic;
+    led_state_t state;
+    int64_t wall_time_us; // system time at the snapshot, which keeps counting through resets
+    uint32_t crc;
+} led_state_record_t;
+
+static RTC_NOINIT_ATTR led_state_record_t rtc_record;
+
+// Only touched by the task calling led_state_save()
+static led_state_t nvs_state;      // what flash holds
+static bool nvs_valid = false;
+static led_state_t pending_state;  // latest card and color, waiting to settle
+static int64_t pending_since_us = 0;
+static int64_t nvs_written_us = -LED_STATE_NVS_INTERVAL_MS * 1000LL;
+static uint32_t nvs_writes = 0;
+
+static int64_t led_state_wall_time_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static uint32_t led_state_crc(const led_state_record_t *record)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)record, offsetof(led_state_record_t, crc));
+}
+
+static bool led_state_valid(const led_state_record_t *record)
+{
+    return record->magic == LED_STATE_MAGIC && record->crc == led_state_crc(record);
+}
+
+static bool led_state_same_color(const led_state_t *a, const led_state_t *b)
+{
+    return memcmp(a->uid, b->uid, sizeof(a->uid)) == 0 && memcmp(a->rgb, b->rgb, sizeof(a->rgb)) == 0;
+}
+
+static bool led_state_nvs_write(const led_state_record_t *record)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(LED_STATE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, LED_STATE_NVS_KEY, record, sizeof(*record));
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save state: %s", esp_err_to_name(err));
+        return false;
+    }
+    nvs_writes++;
+    ESP_LOGI(TAG, "Saved #%02X%02X%02X to flash (%" PRIu32 " writes since boot)",
+             record->state.rgb[0], record->state.rgb[1], record->state.rgb[2], nvs_writes);
+    return true;
+}
+
+esp_err_t led_state_restore(led_state_t *state)
+{
+    led_state_record_t nvs_record;
+    nvs_handle_t nvs;
+    size_t len = sizeof(nvs_record);
+    if (nvs_open(LED_STATE_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_blob(nvs, LED_STATE_NVS_KEY, &nvs_record, &len) == ESP_OK && len == sizeof(nvs_record) &&
+            led_state_valid(&nvs_record)) {
+            nvs_state = nvs_record.state;
+            nvs_valid = true;
+        }
+        nvs_close(nvs);
+    }
+
+    if (led_state_valid(&rtc_record)) {
+        *state = rtc_record.state;
+        int64_t gap = led_state_wall_time_us() - rtc_record.wall_time_us;
+        if (gap > 0 && gap < LED_STATE_MAX_GAP_US) {
+            state->net_time_us += gap;
+        }
+        ESP_LOGI(TAG, "Resuming #%02X%02X%02X from RTC memory", state->rgb[0], state->rgb[1], state->rgb[2]);
+    } else if (nvs_valid) {
+        *state = nvs_state;
+        ESP_LOGI(TAG, "Resuming #%02X%02X%02X from flash", state->rgb[0], state->rgb[1], state->rgb[2]);
+    } else {
+        return ESP_ERR_NOT_FOUND;
+    }
+    pending_state = *state;
+    return ESP_OK;
+}
+
+void led_state_save(const led_state_t *state)
+{
+    rtc_record.magic = LED_STATE_MAGIC;
+    rtc_record.state = *state;
+    rtc_record.wall_time_us = led_state_wall_time_us();
+    rtc_record.crc = led_state_crc(&rtc_record);
+
+    // The phase moves every frame, flash only cares about the card and color
+    int64_t now = esp_timer_get_time();
+    if (!led_state_same_color(state, &pending_state)) {
+        pending_state = *state;
+        pending_since_us = now;
+    }
+    if (nvs_valid && led_state_same_color(&pending_state, &nvs_state)) {
+        return;
+    }
+    if (now - pending_since_us < LED_STATE_NVS_SETTLE_MS * 1000LL ||
+        now - nvs_written_us < LED_STATE_NVS_INTERVAL_MS * 1000LL) {
+        return;
+    }
+    // A failed write is retried after the interval, not on every call
+    nvs_written_us = now;
+    if (led_state_nvs_write(&rtc_record)) {
+        nvs_state = *state;
+        nvs_valid = true;
+    }
+}
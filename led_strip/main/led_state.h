@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What the strip is showing, enough to redraw it after a reset
+ */
+typedef struct {
+    uint8_t uid[4];      /*!< Card the color belongs to */
+    uint8_t rgb[3];      /*!< Base color before the fade */
+    int64_t net_time_us; /*!< Network time, which sets the fade phase */
+} led_state_t;
+
+/**
+ * @brief Load the last snapshot
+ *
+ * Prefers the copy in RTC memory, which survives software, watchdog and
+ * brownout resets as well as deep sleep. Its network time is advanced by the
+ * time spent in reset, so the fade continues in phase. After a power loss the
+ * copy in NVS is used instead, with the phase it was saved with.
+ *
+ * @note NVS must already be initialized.
+ * @return ESP_OK if state was filled in, ESP_ERR_NOT_FOUND if there is no snapshot
+ */
+esp_err_t led_state_restore(led_state_t *state);
+
+/**
+ * @brief Snapshot the current state
+ *
+ * Cheap enough to call every second: only the RTC copy is written each time.
+ * NVS is written when the card or color changes, once the new state has held
+ * for a few seconds and at most once a minute, so a burst of taps costs a
+ * single flash write.
+ */
+void led_state_save(const led_state_t *state);
+
+#ifdef __cplusplus
+}
+#endif
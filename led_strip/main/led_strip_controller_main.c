@@ -1,17 +1,24 @@
 #include <string.h>
-#include <math.h>
-#include <ctype.h>  // Added for isxdigit() function
+#include <sys/param.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 #include "driver/rmt_tx.h"
 #include "led_strip_encoder.h"
+#include "led_render.h"
+#include "led_sink_rmt.h"
 #include "esp_mac.h"
 #include "esp_now.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
 #include "nvs_flash.h"
+#include "net_time.h"
+#include "uid_codec.h"
+#include "power.h"
+#include "espnow_proto.h"
+#include "led_state.h"
 
 #define RMT_LED_STRIP_RESOLUTION_HZ 10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high resolution)
 #define RMT_LED_STRIP_GPIO_NUM      0
@@ -21,8 +28,14 @@
 #define FADE_OUT_DURATION_MS       2000 // 1 second for fade out
 #define MOOD_COLOR_CHANGE_MS       500 // 1 second between mood color changes
 #define MIN_BRIGHTNESS_PERCENT     20   // Minimum brightness percentage during fade-out
+#define LED_FRAME_PERIOD_MS        30   // leaves two idle ticks per frame, enough for tickless light sleep
+#define MOOD_CROSSFADE_MS          800  // time to blend from the previous mood color into the new one
 
 #define MAX_ESPNOW_MSG_SIZE 250
+#define LED_ENCODER_CACHE_FRAMES    4 // pre-encoded frames kept by the encoder, ~5.9 KB each for 60 LEDs
+#define PALETTE_TABLE_ENTRIES       8 // cards whose cover art color is remembered
+#define PALETTE_CHROMA_BIAS         32 // keeps a large grey area in the running against a tiny colorful one
+#define LED_STATE_SNAPSHOT_MS       1000 // how often the shown state is copied to RTC memory
 
 static const char *TAG = "example";
 static uint8_t led_strip_pixels[EXAMPLE_LED_NUMBERS * 3];
@@ -48,43 +61,128 @@ static int current_mood_color_index = 0;
 static int8_t fade_direction = 1; // 1 for fade in, -1 for fade out
 static float fade_value = 0.0f;
 static uint8_t received_uid[4] = {0}; // Initialize with zeros
-static bool new_uid_received = false;
+static TaskHandle_t fade_task_handle = NULL;
+static volatile int64_t uid_received_us = 0; // esp_timer time the last UID arrived, for wake-to-frame latency
+static led_state_t resume_state; // what was on the strip before the last reset
+static bool resume_pending = false;
+
+// Cover art colors sent by the player, written from the ESP-NOW callback
+typedef struct {
+    bool used;
+    uint8_t uid[4];
+    uint8_t rgb[3];
+} palette_entry_t;
+
+static palette_entry_t palette_table[PALETTE_TABLE_ENTRIES];
+static uint8_t palette_next = 0; // slot replaced next, oldest first
+static portMUX_TYPE palette_lock = portMUX_INITIALIZER_UNLOCKED;
 
 static float linear_fade(float x) {
     return x;
 }
 
+// The color a strip shows for a palette: weighted towards common and colorful, at full brightness
+static void palette_pick(const espnow_proto_palette_t *frame, uint8_t rgb[3])
+{
+    int32_t best_score = -1;
+    for (int i = 0; i < frame->count && i < ESPNOW_PROTO_PALETTE_MAX; i++) {
+        const uint8_t *c = frame->rgb[i];
+        int32_t chroma = MAX(c[0], MAX(c[1], c[2])) - MIN(c[0], MIN(c[1], c[2]));
+        int32_t score = frame->weight[i] * (chroma + PALETTE_CHROMA_BIAS);
+        if (score > best_score) {
+            best_score = score;
+            memcpy(rgb, c, 3);
+        }
+    }
+    // The fade sets the brightness, so scale the brightest channel up to full
+    int peak = MAX(rgb[0], MAX(rgb[1], rgb[2]));
+    if (peak > 0) {
+        for (int ch = 0; ch < 3; ch++) {
+            rgb[ch] = rgb[ch] * 255 / peak;
+        }
+    }
+}
+
+// Returns true if the card's color changed
+static bool palette_store(const uint8_t uid[4], const uint8_t rgb[3])
+{
+    bool changed = true;
+    taskENTER_CRITICAL(&palette_lock);
+    palette_entry_t *entry = NULL;
+    for (int i = 0; i < PALETTE_TABLE_ENTRIES && entry == NULL; i++) {
+        if (palette_table[i].used && memcmp(palette_table[i].uid, uid, 4) == 0) {
+            entry = &palette_table[i];
+            changed = memcmp(entry->rgb, rgb, 3) != 0;
+        }
+    }
+    if (entry == NULL) {
+        entry = &palette_table[palette_next];
+        palette_next = (palette_next + 1) % PALETTE_TABLE_ENTRIES;
+        entry->used = true;
+        memcpy(entry->uid, uid, 4);
+    }
+    memcpy(entry->rgb, rgb, 3);
+    taskEXIT_CRITICAL(&palette_lock);
+    return changed;
+}
+
+static bool palette_lookup(const uint8_t uid[4], uint8_t rgb[3])
+{
+    bool found = false;
+    taskENTER_CRITICAL(&palette_lock);
+    for (int i = 0; i < PALETTE_TABLE_ENTRIES && !found; i++) {
+        if (palette_table[i].used && memcmp(palette_table[i].uid, uid, 4) == 0) {
+            memcpy(rgb, palette_table[i].rgb, 3);
+            found = true;
+        }
+    }
+    taskEXIT_CRITICAL(&palette_lock);
+    return found;
+}
+
 
 
 static void led_strip_fade_task(void *arg)
 {
     rmt_channel_handle_t led_chan = (rmt_channel_handle_t)arg;
-    rmt_encoder_handle_t led_encoder = NULL;
     led_strip_encoder_config_t encoder_config = {
         .resolution = RMT_LED_STRIP_RESOLUTION_HZ,
+        .cache_entries = LED_ENCODER_CACHE_FRAMES,
+        .max_frame_bytes = sizeof(led_strip_pixels),
     };
-    ESP_ERROR_CHECK(rmt_new_led_strip_encoder(&encoder_config, &led_encoder));
+    static led_sink_rmt_t strip;
+    ESP_ERROR_CHECK(led_sink_rmt_init(&strip, led_chan, &encoder_config));
 
-    rmt_transmit_config_t tx_config = {
-        .loop_count = 0,
-    };
+    // Frames are generated without knowing about RMT, so the same code runs in the host simulator
+    static led_render_t render;
+    led_render_init(&render, led_strip_pixels, EXAMPLE_LED_NUMBERS,
+                    FADE_IN_DURATION_MS + FADE_OUT_DURATION_MS, MOOD_CROSSFADE_MS);
 
-    // Initialize the LED strip with all pixels off
-    memset(led_strip_pixels, 0, sizeof(led_strip_pixels));
-    ESP_ERROR_CHECK(rmt_transmit(led_chan, led_encoder, led_strip_pixels, sizeof(led_strip_pixels), &tx_config));
-    ESP_ERROR_CHECK(rmt_tx_wait_all_done(led_chan, portMAX_DELAY));
+    // Initialize the LED strip with all pixels off, unless it is about to pick up where it was before a reset
+    if (!resume_pending) {
+        ESP_ERROR_CHECK(strip.base.show(&strip.base, led_strip_pixels, EXAMPLE_LED_NUMBERS, 255));
+    }
 
+    bool uid_pending = resume_pending;
     while (1) {
-        // Wait for a new UID to be received
-        while (!new_uid_received) {
-            vTaskDelay(1); // Delay for 1ms
+        // Nothing to show until a card is tapped, so block and let the chip sleep
+        if (!uid_pending) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
-
-        new_uid_received = false;
+        uid_pending = false;
+        int64_t event_us = uid_received_us;
+        bool resuming = resume_pending;
+        resume_pending = false;
 
         // Print the first byte of the received UID
         ESP_LOGI(TAG, "First byte of received UID: 0x%02X", received_uid[0]);
 
+        led_strip_encoder_stats_t encoder_stats;
+        led_strip_encoder_get_stats(strip.encoder, &encoder_stats);
+        ESP_LOGI(TAG, "Encoder frames %" PRIu32 ": solid %" PRIu32 ", cache hits %" PRIu32 ", misses %" PRIu32 ", uncached %" PRIu32,
+                 encoder_stats.frames, encoder_stats.solid_frames, encoder_stats.cache_hits,
+                 encoder_stats.cache_misses, encoder_stats.uncached);
+
         // Map the received UID to a mood color index based on the first byte
         switch (received_uid[0]) {
             case 0x33:
@@ -114,84 +212,108 @@ static void led_strip_fade_task(void *arg)
                 break;
         }
 
-        // Initialize the fade phase variables
-        int64_t fade_start_time = esp_timer_get_time();
-        int64_t fade_duration = (FADE_IN_DURATION_MS + FADE_OUT_DURATION_MS) * 1000;
-        float fade_period = (2.0f * M_PI) / fade_duration;
+        const mood_color_t *current_mood_color = &mood_colors[current_mood_color_index];
+        uint8_t target_rgb[3] = {current_mood_color->red, current_mood_color->green, current_mood_color->blue};
+        // Once the player has sent the card's cover art colors, those win over the mood table
+        if (palette_lookup(received_uid, target_rgb)) {
+            ESP_LOGI(TAG, "Cover art color #%02X%02X%02X", target_rgb[0], target_rgb[1], target_rgb[2]);
+        }
+        // After a reset, show the saved color straight away instead of fading in from off
+        if (resuming) {
+            memcpy(target_rgb, resume_state.rgb, sizeof(target_rgb));
+        }
+        led_render_set_color(&render, target_rgb, resuming, esp_timer_get_time());
 
+        bool first_frame = !resuming; // a resume has no tap to measure latency against
+        int64_t last_snapshot_us = 0;
         while (1) {
-            // Calculate the elapsed time and the fade value using a sine wave
-            int64_t elapsed_time = esp_timer_get_time() - fade_start_time;
-            float fade_value = 0.5f * (1.0f + sinf(elapsed_time * fade_period));
-
-            // Update the LED strip pixels with the current mood color and fade value
-            const mood_color_t *current_mood_color = &mood_colors[current_mood_color_index];
-            for (int i = 0; i < EXAMPLE_LED_NUMBERS; i++) {
-                led_strip_pixels[i * 3 + 0] = current_mood_color->green * fade_value;
-                led_strip_pixels[i * 3 + 1] = current_mood_color->red * fade_value;
-                led_strip_pixels[i * 3 + 2] = current_mood_color->blue * fade_value;
+            // The fade phase is taken from the shared network time, so every strip renders the same frame
+            ESP_ERROR_CHECK(led_render_step(&render, &strip.base, net_time_now_us(), esp_timer_get_time()));
+            if (first_frame) {
+                power_note_action(event_us);
+                first_frame = false;
             }
 
-            // Transmit the updated pixels
-            ESP_ERROR_CHECK(rmt_transmit(led_chan, led_encoder, led_strip_pixels, sizeof(led_strip_pixels), &tx_config));
-            ESP_ERROR_CHECK(rmt_tx_wait_all_done(led_chan, portMAX_DELAY));
-
-            vTaskDelay(1); // Delay for 1ms to achieve ~1000fps
-
-            // Check if a new UID has been received
-            if (new_uid_received) {
-                break; // Exit the continuous fade loop and handle the new UID
+            // Keep the RTC copy fresh so a reset resumes close to this frame
+            int64_t now = esp_timer_get_time();
+            if (now - last_snapshot_us >= LED_STATE_SNAPSHOT_MS * 1000LL && led_render_settled(&render, now)) {
+                led_state_t snapshot = {
+                    .net_time_us = net_time_now_us(),
+                };
+                memcpy(snapshot.uid, received_uid, sizeof(snapshot.uid));
+                memcpy(snapshot.rgb, target_rgb, sizeof(snapshot.rgb));
+                led_state_save(&snapshot);
+                last_snapshot_us = now;
             }
 
-            // Check if the fade cycle is complete
-            if (elapsed_time >= fade_duration) {
-                fade_start_time = esp_timer_get_time(); // Reset the fade start time
+            // Sleep until the next frame is due, waking early if a new UID arrives
+            if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LED_FRAME_PERIOD_MS)) > 0) {
+                uid_pending = true;
+                break; // Exit the continuous fade loop and handle the new UID
             }
         }
     }
 }
 
-typedef struct struct_message {
-    uint8_t uid[4]; // RFID UID
-} struct_message;
-
 // Function to print the received UID
-void print_uid(const uint8_t *uid) {
-    ESP_LOGI(TAG, "UID: %02X %02X %02X %02X", uid[0], uid[1], uid[2], uid[3]);
+void print_uid(const uint8_t *uid, size_t uid_len) {
+    char text[UID_CODEC_TEXT_SIZE(UID_CODEC_MAX_LEN)];
+    uid_format_hex(uid, uid_len, text, sizeof(text));
+    ESP_LOGI(TAG, "UID:%s", text);
 }
 
-void espnow_receive_cb(const uint8_t *mac_addr, const uint8_t *data, int len) {
-    if (mac_addr == NULL || data == NULL || len < sizeof(struct_message)) {
+void espnow_receive_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
+    int64_t rx_us = esp_timer_get_time();
+
+    // Time beacons arrive ten times a second, hand them off before anything else
+    if (net_time_handle_espnow(recv_info, data, len)) {
+        return;
+    }
+
+    if (recv_info == NULL || data == NULL || len <= 0) {
         ESP_LOGE(TAG, "Receive callback received invalid arguments");
         return;
     }
 
-    ESP_LOGI(TAG, "Received ESP-NOW message from: " MACSTR, MAC2STR(mac_addr));
-    struct_message msg;
-    memcpy(&msg, data, sizeof(msg));
-    print_uid(msg.uid);
-
-    // Process the received data to extract the UID
-    uint8_t uid_index = 0;
-    const char *ptr = (char *)data;
-    while (*ptr) {
-        if (isspace((unsigned char)*ptr)) {
-            ptr++; // Skip whitespace characters
-        } else if (isxdigit((unsigned char)*ptr)) {
-            char hex_byte[3] = {ptr[0], ptr[1], '\0'};
-            received_uid[uid_index++] = (uint8_t)strtoul(hex_byte, NULL, 16);
-            ptr += 3; // Skip past the hex byte and the space after it
-        } else {
-            break; // Stop processing if an unexpected character is encountered
-        }
-        if (uid_index >= sizeof(received_uid)) {
-            ESP_LOGW(TAG, "UID buffer overflow");
-            break;
+    ESP_LOGI(TAG, "Received ESP-NOW message from: " MACSTR, MAC2STR(recv_info->src_addr));
+
+    // Cover art palette from the player, may arrive before or after the card's UID
+    espnow_proto_palette_t palette;
+    if (len == sizeof(palette)) {
+        memcpy(&palette, data, sizeof(palette));
+        if (palette.magic == ESPNOW_PROTO_PALETTE_MAGIC && palette.count > 0) {
+            uint8_t rgb[3];
+            palette_pick(&palette, rgb);
+            // The player repeats each palette, only a new color restarts the crossfade
+            if (palette_store(palette.uid, rgb) && memcmp(palette.uid, received_uid, 4) == 0 &&
+                fade_task_handle != NULL) {
+                uid_received_us = rx_us;
+                xTaskNotifyGive(fade_task_handle);
+            }
+            return;
         }
     }
-    received_uid[uid_index] = 0; // Null-terminate the UID
-    print_uid(received_uid); // Print the UID for debugging
-    new_uid_received = true;
+
+    // Card removal, only sent when the reader has SEND_REMOVAL_EVENTS on; the strip keeps its color
+    if (len >= 4 && memcmp(data, "OFF:", 4) == 0) {
+        ESP_LOGI(TAG, "Card removed");
+        return;
+    }
+
+    // The sender transmits the UID as text without a terminator, so parse exactly len bytes
+    uint8_t uid[UID_CODEC_MAX_LEN];
+    size_t uid_len = uid_parse_hex((const char *)data, len, uid, sizeof(uid));
+    if (uid_len == 0) {
+        ESP_LOGW(TAG, "No UID in %d byte message", len);
+        return;
+    }
+    memset(received_uid, 0, sizeof(received_uid));
+    memcpy(received_uid, uid, MIN(uid_len, sizeof(received_uid)));
+    print_uid(uid, uid_len); // Print the UID for debugging
+    uid_received_us = rx_us;
+    if (fade_task_handle != NULL) {
+        xTaskNotifyGive(fade_task_handle);
+    }
 }
 
 void app_main(void)
@@ -205,16 +327,9 @@ void app_main(void)
         .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
         .trans_queue_depth = 4,
     };
+    // Left disabled, the strip sink enables it only while a frame is sent
     ESP_ERROR_CHECK(rmt_new_tx_channel(&tx_chan_config, &led_chan));
 
-    ESP_LOGI(TAG, "Enable RMT TX channel");
-    ESP_ERROR_CHECK(rmt_enable(led_chan));
-
-    // Print the MAC address of the device
-    uint8_t mac_addr[6];
-    esp_read_mac(mac_addr, ESP_MAC_WIFI_STA);
-    ESP_LOGI(TAG, "Device MAC address: %02X:%02X:%02X:%02X:%02X:%02X", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -223,6 +338,19 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // Start rendering what was shown before the reset now, the radio takes far longer to come up
+    if (led_state_restore(&resume_state) == ESP_OK) {
+        memcpy(received_uid, resume_state.uid, sizeof(received_uid));
+        net_time_seed(resume_state.net_time_us);
+        resume_pending = true;
+    }
+    xTaskCreate(led_strip_fade_task, "led_strip_fade", 4096, led_chan, 5, &fade_task_handle);
+
+    // Print the MAC address of the device
+    uint8_t mac_addr[6];
+    esp_read_mac(mac_addr, ESP_MAC_WIFI_STA);
+    ESP_LOGI(TAG, "Device MAC address: %02X:%02X:%02X:%02X:%02X:%02X", mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
+
     // Initialize Wi-Fi in Station mode
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -238,10 +366,14 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_now_init());
     ESP_ERROR_CHECK(esp_now_register_recv_cb(espnow_receive_cb));
 
+    // Share one clock between all strips so their animations stay in phase
+    ESP_ERROR_CHECK(net_time_init());
+
     // Print the receiver's MAC address
     uint8_t receiver_mac_addr[6] = {0};
     ESP_ERROR_CHECK(esp_read_mac(receiver_mac_addr, ESP_MAC_WIFI_STA));
     ESP_LOGI(TAG, "Receiver MAC Address: " MACSTR, MAC2STR(receiver_mac_addr));
 
-    xTaskCreate(led_strip_fade_task, "led_strip_fade", 4096, led_chan, 5, NULL);
+    // Sleep between frames and ESP-NOW listen windows
+    ESP_ERROR_CHECK(power_init());
 }
\ No newline at end of file
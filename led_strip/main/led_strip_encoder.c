@@ -4,19 +4,111 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
+#include <stdbool.h>
 #include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "pixel_kernels.h"
+#include "led_frame_cache.h"
 #include "led_strip_encoder.h"
 
 static const char *TAG = "led_encoder";
 
+#define LED_STRIP_BYTES_PER_PIXEL  3
+#define LED_STRIP_SYMBOLS_PER_BYTE 8
+#define LED_STRIP_PIXEL_SYMBOLS    (LED_STRIP_BYTES_PER_PIXEL * LED_STRIP_SYMBOLS_PER_BYTE)
+
+// Encoding sessions of one transmission
+enum {
+    LED_STRIP_STATE_START = RMT_ENCODING_RESET, // pick how the frame is sent
+    LED_STRIP_STATE_SYMBOLS,                    // stream pre-encoded symbols
+    LED_STRIP_STATE_BYTES,                      // send RGB data through the bytes encoder
+    LED_STRIP_STATE_SCALED,                     // encode and send one scaled pixel at a time
+    LED_STRIP_STATE_RESET_CODE,                 // send reset code
+};
+
 typedef struct {
     rmt_encoder_t base;
     rmt_encoder_t *bytes_encoder;
     rmt_encoder_t *copy_encoder;
     int state;
     rmt_symbol_word_t reset_code;
+    rmt_symbol_word_t bit0;
+    rmt_symbol_word_t bit1;
+    volatile uint8_t brightness; // set by the application, latched per transmission
+    uint8_t tx_brightness;
+    // Symbols of the current transmission, sent repeat_left more times
+    const rmt_symbol_word_t *tx_symbols;
+    size_t tx_symbol_count;
+    uint32_t repeat_left;
+    size_t tx_offset;         // next byte to encode on the scaled path
+    bool pixel_ready;         // pixel_symbols holds the chunk at tx_offset
+    rmt_symbol_word_t pixel_symbols[LED_STRIP_PIXEL_SYMBOLS]; // one pixel of a solid frame or of the scaled path
+    led_frame_cache_t cache;
+    rmt_symbol_word_t *cache_symbols; // full-brightness symbols of cache entry i at i * max_frame_bytes * 8
+    led_strip_encoder_stats_t stats;
 } rmt_led_strip_encoder_t;
 
+static void led_strip_bytes_to_symbols(const rmt_led_strip_encoder_t *led_encoder, const uint8_t *data, size_t size,
+                                       rmt_symbol_word_t *symbols)
+{
+    // Brightness is applied four bytes at a time, then each byte becomes 8 symbols
+    for (size_t i = 0; i < size; i += sizeof(uint32_t)) {
+        size_t n = size - i < sizeof(uint32_t) ? size - i : sizeof(uint32_t);
+        uint32_t word = 0;
+        memcpy(&word, data + i, n);
+        word = pixel_scale(word, led_encoder->tx_brightness);
+        for (size_t b = 0; b < n; b++, word >>= 8) { // little endian: data[i] is the low byte
+            uint8_t byte = (uint8_t)word;
+            for (int bit = 7; bit >= 0; bit--) { // WS2812 transfer bit order: MSB first
+                *symbols++ = (byte >> bit) & 1 ? led_encoder->bit1 : led_encoder->bit0;
+            }
+        }
+    }
+}
+
+// Decide how the frame is sent and return the first session to run
+static int led_strip_select(rmt_led_strip_encoder_t *led_encoder, const uint8_t *data, size_t size)
+{
+    led_encoder->stats.frames++;
+    led_encoder->tx_brightness = led_encoder->brightness;
+    uint32_t index = 0;
+    led_frame_path_t path = led_frame_cache_select(&led_encoder->cache, data, size, led_encoder->tx_brightness, &index);
+    switch (path) {
+    case LED_FRAME_SOLID:
+        led_strip_bytes_to_symbols(led_encoder, data, LED_STRIP_BYTES_PER_PIXEL, led_encoder->pixel_symbols);
+        led_encoder->tx_symbols = led_encoder->pixel_symbols;
+        led_encoder->tx_symbol_count = LED_STRIP_PIXEL_SYMBOLS;
+        led_encoder->repeat_left = size / LED_STRIP_BYTES_PER_PIXEL;
+        led_encoder->stats.solid_frames++;
+        return LED_STRIP_STATE_SYMBOLS;
+    case LED_FRAME_CACHE_HIT:
+    case LED_FRAME_CACHE_MISS: {
+        rmt_symbol_word_t *symbols = led_encoder->cache_symbols + index * led_encoder->cache.max_frame_bytes * LED_STRIP_SYMBOLS_PER_BYTE;
+        if (path == LED_FRAME_CACHE_MISS) {
+            led_strip_bytes_to_symbols(led_encoder, data, size, symbols); // only full brightness frames are cached
+            led_encoder->stats.cache_misses++;
+        } else {
+            led_encoder->stats.cache_hits++;
+        }
+        led_encoder->tx_symbols = symbols;
+        led_encoder->tx_symbol_count = size * LED_STRIP_SYMBOLS_PER_BYTE;
+        led_encoder->repeat_left = 1;
+        return LED_STRIP_STATE_SYMBOLS;
+    }
+    case LED_FRAME_SCALED:
+        // The bytes encoder reads the pixel buffer as is, so scaled frames are encoded here
+        led_encoder->stats.uncached++;
+        led_encoder->tx_offset = 0;
+        led_encoder->pixel_ready = false;
+        return LED_STRIP_STATE_SCALED;
+    case LED_FRAME_BYTES:
+        break;
+    }
+    led_encoder->stats.uncached++;
+    return LED_STRIP_STATE_BYTES;
+}
+
 static size_t rmt_encode_led_strip(rmt_encoder_t *encoder, rmt_channel_handle_t channel, const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
 {
     rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
@@ -26,17 +118,68 @@ static size_t rmt_encode_led_strip(rmt_encoder_t *encoder, rmt_channel_handle_t
     rmt_encode_state_t state = RMT_ENCODING_RESET;
     size_t encoded_symbols = 0;
     switch (led_encoder->state) {
-    case 0: // send RGB data
+    case LED_STRIP_STATE_START:
+        led_encoder->state = led_strip_select(led_encoder, primary_data, data_size);
+        if (led_encoder->state == LED_STRIP_STATE_BYTES) {
+            goto send_bytes;
+        }
+        if (led_encoder->state == LED_STRIP_STATE_SCALED) {
+            goto send_scaled;
+        }
+    // fall-through
+    case LED_STRIP_STATE_SYMBOLS:
+        while (led_encoder->repeat_left > 0) {
+            encoded_symbols += copy_encoder->encode(copy_encoder, channel, led_encoder->tx_symbols,
+                                                    led_encoder->tx_symbol_count * sizeof(rmt_symbol_word_t), &session_state);
+            if (session_state & RMT_ENCODING_COMPLETE) {
+                led_encoder->repeat_left--;
+            }
+            if (session_state & RMT_ENCODING_MEM_FULL) {
+                state |= RMT_ENCODING_MEM_FULL;
+                goto out; // yield if there's no free space for encoding artifacts
+            }
+        }
+        led_encoder->state = LED_STRIP_STATE_RESET_CODE;
+        goto send_reset;
+    case LED_STRIP_STATE_SCALED:
+send_scaled:
+        while (led_encoder->tx_offset < data_size) {
+            size_t chunk = data_size - led_encoder->tx_offset;
+            if (chunk > LED_STRIP_BYTES_PER_PIXEL) {
+                chunk = LED_STRIP_BYTES_PER_PIXEL;
+            }
+            // Only encode the next pixel once the copy encoder has taken all of the previous one
+            if (!led_encoder->pixel_ready) {
+                led_strip_bytes_to_symbols(led_encoder, (const uint8_t *)primary_data + led_encoder->tx_offset, chunk,
+                                           led_encoder->pixel_symbols);
+                led_encoder->pixel_ready = true;
+            }
+            encoded_symbols += copy_encoder->encode(copy_encoder, channel, led_encoder->pixel_symbols,
+                                                    chunk * LED_STRIP_SYMBOLS_PER_BYTE * sizeof(rmt_symbol_word_t), &session_state);
+            if (session_state & RMT_ENCODING_COMPLETE) {
+                led_encoder->tx_offset += chunk;
+                led_encoder->pixel_ready = false;
+            }
+            if (session_state & RMT_ENCODING_MEM_FULL) {
+                state |= RMT_ENCODING_MEM_FULL;
+                goto out; // yield if there's no free space for encoding artifacts
+            }
+        }
+        led_encoder->state = LED_STRIP_STATE_RESET_CODE;
+        goto send_reset;
+    case LED_STRIP_STATE_BYTES: // send RGB data
+send_bytes:
         encoded_symbols += bytes_encoder->encode(bytes_encoder, channel, primary_data, data_size, &session_state);
         if (session_state & RMT_ENCODING_COMPLETE) {
-            led_encoder->state = 1; // switch to next state when current encoding session finished
+            led_encoder->state = LED_STRIP_STATE_RESET_CODE; // switch to next state when current encoding session finished
         }
         if (session_state & RMT_ENCODING_MEM_FULL) {
             state |= RMT_ENCODING_MEM_FULL;
             goto out; // yield if there's no free space for encoding artifacts
         }
     // fall-through
-    case 1: // send reset code
+    case LED_STRIP_STATE_RESET_CODE: // send reset code
+send_reset:
         encoded_symbols += copy_encoder->encode(copy_encoder, channel, &led_encoder->reset_code,
                                                 sizeof(led_encoder->reset_code), &session_state);
         if (session_state & RMT_ENCODING_COMPLETE) {
@@ -53,11 +196,23 @@ out:
     return encoded_symbols;
 }
 
+static void led_strip_free_cache(rmt_led_strip_encoder_t *led_encoder)
+{
+    if (led_encoder->cache.entries) {
+        // Frames and symbols of all entries share one allocation, starting with the symbols
+        heap_caps_free(led_encoder->cache_symbols);
+        free(led_encoder->cache.entries);
+        led_encoder->cache.entries = NULL;
+        led_encoder->cache_symbols = NULL;
+    }
+}
+
 static esp_err_t rmt_del_led_strip_encoder(rmt_encoder_t *encoder)
 {
     rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
     rmt_del_encoder(led_encoder->bytes_encoder);
     rmt_del_encoder(led_encoder->copy_encoder);
+    led_strip_free_cache(led_encoder);
     free(led_encoder);
     return ESP_OK;
 }
@@ -71,16 +226,53 @@ static esp_err_t rmt_led_strip_encoder_reset(rmt_encoder_t *encoder)
     return ESP_OK;
 }
 
+static esp_err_t led_strip_alloc_cache(rmt_led_strip_encoder_t *led_encoder, uint32_t entries, size_t max_frame_bytes)
+{
+    led_frame_cache_entry_t *cache_entries = calloc(entries, sizeof(led_frame_cache_entry_t));
+    if (!cache_entries) {
+        return ESP_ERR_NO_MEM;
+    }
+    // The encoder may run from the RMT interrupt, so keep the symbols in internal RAM
+    size_t symbol_bytes = max_frame_bytes * LED_STRIP_SYMBOLS_PER_BYTE * sizeof(rmt_symbol_word_t);
+    uint8_t *mem = heap_caps_malloc(entries * (symbol_bytes + max_frame_bytes), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!mem) {
+        free(cache_entries);
+        return ESP_ERR_NO_MEM;
+    }
+    led_encoder->cache_symbols = (rmt_symbol_word_t *)mem;
+    led_frame_cache_init(&led_encoder->cache, cache_entries, mem + entries * symbol_bytes, entries, max_frame_bytes);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_encoder_set_brightness(rmt_encoder_handle_t encoder, uint8_t brightness)
+{
+    ESP_RETURN_ON_FALSE(encoder, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
+    led_encoder->brightness = brightness;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_encoder_get_stats(rmt_encoder_handle_t encoder, led_strip_encoder_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(encoder && stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    rmt_led_strip_encoder_t *led_encoder = __containerof(encoder, rmt_led_strip_encoder_t, base);
+    *stats = led_encoder->stats;
+    return ESP_OK;
+}
+
 esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder)
 {
     esp_err_t ret = ESP_OK;
     rmt_led_strip_encoder_t *led_encoder = NULL;
     ESP_GOTO_ON_FALSE(config && ret_encoder, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    ESP_GOTO_ON_FALSE(config->cache_entries == 0 || config->max_frame_bytes > 0, ESP_ERR_INVALID_ARG, err, TAG,
+                      "max_frame_bytes required with cache_entries");
     led_encoder = rmt_alloc_encoder_mem(sizeof(rmt_led_strip_encoder_t));
     ESP_GOTO_ON_FALSE(led_encoder, ESP_ERR_NO_MEM, err, TAG, "no mem for led strip encoder");
     led_encoder->base.encode = rmt_encode_led_strip;
     led_encoder->base.del = rmt_del_led_strip_encoder;
     led_encoder->base.reset = rmt_led_strip_encoder_reset;
+    led_encoder->brightness = config->brightness ? config->brightness : UINT8_MAX;
     // different led strip might have its own timing requirements, following parameter is for WS2812
     rmt_bytes_encoder_config_t bytes_encoder_config = {
         .bit0 = {
@@ -97,9 +289,15 @@ esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rm
         },
         .flags.msb_first = 1 // WS2812 transfer bit order: G7...G0R7...R0B7...B0
     };
+    led_encoder->bit0 = bytes_encoder_config.bit0;
+    led_encoder->bit1 = bytes_encoder_config.bit1;
     ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_encoder_config, &led_encoder->bytes_encoder), err, TAG, "create bytes encoder failed");
     rmt_copy_encoder_config_t copy_encoder_config = {};
     ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_encoder_config, &led_encoder->copy_encoder), err, TAG, "create copy encoder failed");
+    if (config->cache_entries > 0) {
+        ESP_GOTO_ON_ERROR(led_strip_alloc_cache(led_encoder, config->cache_entries, config->max_frame_bytes), err, TAG,
+                          "no mem for symbol cache");
+    }
 
     uint32_t reset_ticks = config->resolution / 1000000 * 50 / 2; // reset code duration defaults to 50us
     led_encoder->reset_code = (rmt_symbol_word_t) {
@@ -16,12 +16,37 @@ extern "C" {
  * @brief Type of led strip encoder configuration
  */
 typedef struct {
-    uint32_t resolution; /*!< Encoder resolution, in Hz */
+    uint32_t resolution;      /*!< Encoder resolution, in Hz */
+    uint32_t cache_entries;   /*!< Number of frames kept as pre-encoded RMT symbols, 0 disables the cache */
+    uint32_t max_frame_bytes; /*!< Largest frame that is cached, larger frames are encoded as they are sent */
+    uint8_t brightness;       /*!< Initial global brightness, 1-255; 0 means full so zeroed configs are unscaled */
 } led_strip_encoder_config_t;
 
+/**
+ * @brief Counters of how frames were encoded, see led_strip_encoder_get_stats()
+ */
+typedef struct {
+    uint32_t frames;       /*!< Frames encoded */
+    uint32_t solid_frames; /*!< Frames where every pixel had the same color, sent as one repeated pixel */
+    uint32_t cache_hits;   /*!< Frames streamed from the symbol cache */
+    uint32_t cache_misses; /*!< Frames encoded into the cache */
+    uint32_t uncached;     /*!< Frames encoded as they were sent, without the cache, scaled frames included */
+} led_strip_encoder_stats_t;
+
 /**
  * @brief Create RMT encoder for encoding LED strip pixels into RMT symbols
  *
+ * A frame whose pixels all have the same color is sent by repeating the
+ * symbols of one pixel. Other frames up to max_frame_bytes sent at full
+ * brightness are encoded into RMT symbols once and kept in a cache of
+ * cache_entries frames, keyed by a hash of their unscaled content, so static
+ * and repeating frames are only copied into RMT memory. The least recently
+ * used frame is replaced on a miss. See led_frame_cache.h.
+ *
+ * Every byte is scaled by the global brightness while it is encoded, so a
+ * static pattern can be faded without touching the pixel buffer. Frames at
+ * any other brightness are scaled as they are sent and bypass the cache.
+ *
  * @param[in] config Encoder configuration
  * @param[out] ret_encoder Returned encoder handle
  * @return
@@ -31,6 +56,32 @@ typedef struct {
  */
 esp_err_t rmt_new_led_strip_encoder(const led_strip_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder);
 
+/**
+ * @brief Set the global brightness applied to the following transmissions
+ *
+ * Each color byte is sent as byte * (brightness + 1) / 256, so 255 sends the
+ * pixel data unchanged. The value is latched when a transmission starts;
+ * frames already queued on the channel may or may not pick it up.
+ *
+ * @param[in] encoder Encoder created by rmt_new_led_strip_encoder()
+ * @param[in] brightness Global brightness, 0-255
+ * @return
+ *      - ESP_ERR_INVALID_ARG for any invalid arguments
+ *      - ESP_OK on success
+ */
+esp_err_t led_strip_encoder_set_brightness(rmt_encoder_handle_t encoder, uint8_t brightness);
+
+/**
+ * @brief Get the frame counters of a led strip encoder
+ *
+ * @param[in] encoder Encoder created by rmt_new_led_strip_encoder()
+ * @param[out] stats Returned counters
+ * @return
+ *      - ESP_ERR_INVALID_ARG for any invalid arguments
+ *      - ESP_OK on success
+ */
+esp_err_t led_strip_encoder_get_stats(rmt_encoder_handle_t encoder, led_strip_encoder_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
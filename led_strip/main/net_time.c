@@ -0,0 +1,294 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_now.h"
+#include "esp_random.h"
+#include "net_time.h"
+
+#define NET_TIME_MAGIC               0x3142544E // "NTB1" on the wire
+#define NET_TIME_BEACON_INTERVAL_MS  100        // master beacon period
+#define NET_TIME_MASTER_TIMEOUT_MS   1000       // take over if no beacon for this long
+#define NET_TIME_BEACON_JITTER_MS    40         // random send delay, so beacons don't keep missing a peer's wake window
+#define NET_TIME_REPORT_INTERVAL_MS  10000      // sync error log period
+#define NET_TIME_LINK_DELAY_US       250        // typical send-to-receive-callback latency of one ESP-NOW frame
+#define NET_TIME_STEP_THRESHOLD_US   5000       // residuals above this are outliers, not drift
+#define NET_TIME_MAX_OUTLIERS        3          // consecutive outliers before the clock is stepped
+#define NET_TIME_OFFSET_GAIN_SHIFT   1          // offset correction applied per beacon: err / 2
+#define NET_TIME_DRIFT_GAIN_DIV      8          // drift correction applied per beacon: err / dt / 8
+#define NET_TIME_MAX_DRIFT_PPB       200000     // crystals are specified well below 200 ppm
+
+static const char *TAG = "net_time";
+
+// Beacon sent by the current master
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;
+    int64_t net_time_us; // network time when the frame was handed to ESP-NOW
+} net_time_beacon_t;
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static portMUX_TYPE net_time_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t own_mac[ESP_NOW_ETH_ALEN];
+static uint8_t master_mac[ESP_NOW_ETH_ALEN];
+static bool have_master = false;
+static bool is_master = false;
+static bool synced = false;
+static int64_t last_beacon_rx_us = 0;
+static int64_t last_sample_local_us = 0;
+static uint32_t last_seq = 0;
+static uint32_t outliers = 0;
+
+// Clock model: net(local) = base_net + (local - base_local) * (1 + drift_ppb / 1e9)
+static int64_t base_local_us = 0;
+static int64_t base_net_us = 0;
+static int32_t drift_ppb = 0;
+static bool seeded = false; // net_time_seed() ran, init keeps the model
+
+static int32_t last_error_us = 0;
+static int32_t max_error_us = 0;
+static uint32_t beacons_rx = 0;
+static uint32_t beacons_lost = 0;
+
+static int64_t net_time_eval(int64_t local_us)
+{
+    int64_t delta = local_us - base_local_us;
+    return base_net_us + delta + delta * drift_ppb / 1000000000;
+}
+
+int64_t net_time_now_us(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&net_time_lock);
+    int64_t net = net_time_eval(now);
+    taskEXIT_CRITICAL(&net_time_lock);
+    return net;
+}
+
+void net_time_seed(int64_t net_us)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&net_time_lock);
+    base_local_us = now;
+    base_net_us = net_us;
+    drift_ppb = 0;
+    seeded = true;
+    taskEXIT_CRITICAL(&net_time_lock);
+}
+
+void net_time_get_stats(net_time_stats_t *stats)
+{
+    taskENTER_CRITICAL(&net_time_lock);
+    stats->is_master = is_master;
+    stats->synced = synced;
+    stats->offset_us = base_net_us - base_local_us;
+    stats->drift_ppm = drift_ppb / 1000.0f;
+    stats->last_error_us = last_error_us;
+    stats->max_error_us = max_error_us;
+    stats->beacons_rx = beacons_rx;
+    stats->beacons_lost = beacons_lost;
+    taskEXIT_CRITICAL(&net_time_lock);
+}
+
+// Called with net_time_lock held
+static void net_time_step(int64_t local_us, int64_t sample_net_us)
+{
+    base_local_us = local_us;
+    base_net_us = sample_net_us;
+    drift_ppb = 0;
+    outliers = 0;
+    synced = true;
+}
+
+// Called with net_time_lock held
+static void net_time_discipline(int64_t local_us, int64_t sample_net_us)
+{
+    int64_t predicted = net_time_eval(local_us);
+    int64_t err = sample_net_us - predicted;
+
+    if (llabs(err) > NET_TIME_STEP_THRESHOLD_US) {
+        if (++outliers >= NET_TIME_MAX_OUTLIERS) {
+            net_time_step(local_us, sample_net_us);
+            last_sample_local_us = local_us;
+        }
+        return;
+    }
+    outliers = 0;
+
+    int64_t dt = local_us - last_sample_local_us;
+    if (dt > 0) {
+        int64_t ppb = drift_ppb + err * 1000000000 / dt / NET_TIME_DRIFT_GAIN_DIV;
+        if (ppb > NET_TIME_MAX_DRIFT_PPB) {
+            ppb = NET_TIME_MAX_DRIFT_PPB;
+        } else if (ppb < -NET_TIME_MAX_DRIFT_PPB) {
+            ppb = -NET_TIME_MAX_DRIFT_PPB;
+        }
+        drift_ppb = (int32_t)ppb;
+    }
+    base_net_us = predicted + err / (1 << NET_TIME_OFFSET_GAIN_SHIFT);
+    base_local_us = local_us;
+    last_sample_local_us = local_us;
+
+    last_error_us = (int32_t)err;
+    if (abs(last_error_us) > max_error_us) {
+        max_error_us = abs(last_error_us);
+    }
+}
+
+bool net_time_handle_espnow(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    // Stamp first so the callback's own work doesn't add to the error
+    int64_t rx_local_us = esp_timer_get_time();
+
+    if (len != sizeof(net_time_beacon_t) || info == NULL || data == NULL) {
+        return false;
+    }
+    net_time_beacon_t beacon;
+    memcpy(&beacon, data, sizeof(beacon));
+    if (beacon.magic != NET_TIME_MAGIC) {
+        return false;
+    }
+    const uint8_t *src = info->src_addr;
+
+    taskENTER_CRITICAL(&net_time_lock);
+    bool master_changed = false;
+    if (is_master) {
+        if (memcmp(src, own_mac, ESP_NOW_ETH_ALEN) > 0) {
+            // We outrank this node, it will step down once it hears us
+            taskEXIT_CRITICAL(&net_time_lock);
+            return true;
+        }
+        is_master = false;
+        master_changed = true;
+    } else if (!have_master || memcmp(src, master_mac, ESP_NOW_ETH_ALEN) < 0 ||
+               rx_local_us - last_beacon_rx_us > NET_TIME_MASTER_TIMEOUT_MS * 1000LL) {
+        master_changed = memcmp(src, master_mac, ESP_NOW_ETH_ALEN) != 0 || !have_master;
+    } else if (memcmp(src, master_mac, ESP_NOW_ETH_ALEN) != 0) {
+        taskEXIT_CRITICAL(&net_time_lock);
+        return true;
+    }
+
+    int64_t sample_net_us = beacon.net_time_us + NET_TIME_LINK_DELAY_US;
+    if (master_changed) {
+        memcpy(master_mac, src, ESP_NOW_ETH_ALEN);
+        have_master = true;
+        beacons_rx = 0;
+        beacons_lost = 0;
+        net_time_step(rx_local_us, sample_net_us);
+        last_sample_local_us = rx_local_us;
+    } else {
+        uint32_t gap = beacon.seq - last_seq;
+        if (gap > 1 && gap < 1000) {
+            beacons_lost += gap - 1;
+        }
+        net_time_discipline(rx_local_us, sample_net_us);
+    }
+    last_seq = beacon.seq;
+    last_beacon_rx_us = rx_local_us;
+    beacons_rx++;
+    taskEXIT_CRITICAL(&net_time_lock);
+
+    if (master_changed) {
+        ESP_LOGI(TAG, "Following master " MACSTR, MAC2STR(src));
+    }
+    return true;
+}
+
+static void net_time_report(void)
+{
+    net_time_stats_t stats;
+    net_time_get_stats(&stats);
+    if (stats.is_master) {
+        ESP_LOGI(TAG, "Master, network time %" PRId64 " us", net_time_now_us());
+    } else if (stats.synced) {
+        ESP_LOGI(TAG, "Sync error last %" PRId32 " us, max %" PRId32 " us, drift %.2f ppm, beacons %" PRIu32 " (lost %" PRIu32 ")",
+                 stats.last_error_us, stats.max_error_us, stats.drift_ppm, stats.beacons_rx, stats.beacons_lost);
+    } else {
+        ESP_LOGW(TAG, "Not synchronized");
+    }
+    taskENTER_CRITICAL(&net_time_lock);
+    max_error_us = 0;
+    taskEXIT_CRITICAL(&net_time_lock);
+}
+
+static void net_time_beacon_task(void *arg)
+{
+    // Spread takeover times so that nodes booting together don't all claim master at once
+    const int64_t takeover_us = (NET_TIME_MASTER_TIMEOUT_MS + own_mac[5] * 4) * 1000LL;
+    net_time_beacon_t beacon = {
+        .magic = NET_TIME_MAGIC,
+        .seq = 0,
+    };
+    int64_t last_report_us = esp_timer_get_time();
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(NET_TIME_BEACON_INTERVAL_MS));
+        int64_t now = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&net_time_lock);
+        if (!is_master && now - last_beacon_rx_us > takeover_us) {
+            is_master = true;
+            have_master = false;
+            synced = true;
+            taskEXIT_CRITICAL(&net_time_lock);
+            ESP_LOGI(TAG, "No master heard, taking over");
+        } else {
+            taskEXIT_CRITICAL(&net_time_lock);
+        }
+
+        if (is_master) {
+            // A master's radio only listens in windows, at a fixed period a rival master's beacons
+            // could always land outside them and the two would never merge
+            vTaskDelay(esp_random() % (pdMS_TO_TICKS(NET_TIME_BEACON_JITTER_MS) + 1));
+            beacon.seq++;
+            beacon.net_time_us = net_time_now_us();
+            esp_err_t err = esp_now_send(broadcast_mac, (const uint8_t *)&beacon, sizeof(beacon));
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "Beacon send failed: %s", esp_err_to_name(err));
+            }
+        }
+
+        if (now - last_report_us >= NET_TIME_REPORT_INTERVAL_MS * 1000LL) {
+            net_time_report();
+            last_report_us = now;
+        }
+    }
+}
+
+esp_err_t net_time_init(void)
+{
+    ESP_ERROR_CHECK(esp_read_mac(own_mac, ESP_MAC_WIFI_STA));
+
+    esp_now_peer_info_t peer = {
+        .channel = 0,
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,
+    };
+    memcpy(peer.peer_addr, broadcast_mac, ESP_NOW_ETH_ALEN);
+    esp_err_t err = esp_now_add_peer(&peer);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST) {
+        ESP_LOGE(TAG, "Failed to add broadcast peer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&net_time_lock);
+    // A seeded clock already runs on the network time from before the reset
+    if (!seeded) {
+        base_local_us = now;
+        base_net_us = now;
+    }
+    last_beacon_rx_us = now;
+    taskEXIT_CRITICAL(&net_time_lock);
+
+    if (xTaskCreate(net_time_beacon_task, "net_time", 3072, NULL, 6, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
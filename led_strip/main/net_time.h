@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_now.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Snapshot of the time-sync state, for logs and metrics
+ */
+typedef struct {
+    bool is_master;          /*!< This node is currently sending beacons */
+    bool synced;             /*!< A master has been heard and the clock is locked */
+    int64_t offset_us;       /*!< Network time minus local time at the last beacon */
+    float drift_ppm;         /*!< Estimated local clock drift against the master */
+    int32_t last_error_us;   /*!< Residual of the last beacon against the prediction */
+    int32_t max_error_us;    /*!< Largest absolute residual since the last report */
+    uint32_t beacons_rx;     /*!< Beacons accepted from the current master */
+    uint32_t beacons_lost;   /*!< Sequence gaps seen from the current master */
+} net_time_stats_t;
+
+/**
+ * @brief Start the ESP-NOW time-sync protocol
+ *
+ * Adds the broadcast peer and starts the beacon task. Every node starts as a
+ * slave; if no beacon is heard for a while it takes over as master, and the
+ * node with the lowest MAC address wins when two masters hear each other.
+ *
+ * @note ESP-NOW must already be initialized.
+ * @return
+ *      - ESP_OK on success
+ *      - other error codes from esp_now_add_peer or task creation
+ */
+esp_err_t net_time_init(void);
+
+/**
+ * @brief Feed a received ESP-NOW frame to the time-sync protocol
+ *
+ * Call this first from the ESP-NOW receive callback.
+ *
+ * @return true if the frame was a time beacon and has been consumed
+ */
+bool net_time_handle_espnow(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+
+/**
+ * @brief Current network time in microseconds
+ *
+ * Falls back to the local esp_timer clock until a master has been heard.
+ */
+int64_t net_time_now_us(void);
+
+/**
+ * @brief Start the local clock model at a given network time
+ *
+ * Used at boot to carry the network time over a reset, so the animation
+ * picks up where it was and the first beacon heard only needs a small
+ * correction. Does not mark the clock as synced. May be called before
+ * net_time_init(), which then keeps the seeded time instead of restarting
+ * the clock at the local time.
+ */
+void net_time_seed(int64_t net_us);
+
+/**
+ * @brief Copy the current sync statistics
+ */
+void net_time_get_stats(net_time_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
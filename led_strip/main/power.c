@@ -0,0 +1,128 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_now.h"
+#include "latency_stats.h"
+#include "net_time.h"
+#include "power.h"
+
+#define LED_PM_MAX_FREQ_MHZ          160
+#define LED_PM_MIN_FREQ_MHZ          40    // XTAL; the strip sink only enables the RMT channel, and its PM lock, for a frame
+#define LED_ESPNOW_WAKE_INTERVAL_MS  100   // radio wake period while idle
+#define LED_ESPNOW_WAKE_WINDOW_MS    50    // radio on time per period, taps wait at most the rest
+#define LED_RADIO_CHECK_INTERVAL_MS  1000  // how often the radio mode follows the time-sync role
+#define LED_POWER_REPORT_INTERVAL_MS 10000
+
+static const char *TAG = "power";
+
+static portMUX_TYPE power_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_stats_t wake_latency;
+static bool radio_windowed = false;
+
+void power_note_action(int64_t event_us)
+{
+    int64_t latency = esp_timer_get_time() - event_us;
+    taskENTER_CRITICAL(&power_lock);
+    latency_stats_add(&wake_latency, latency > 0 ? (uint32_t)latency : 0);
+    taskEXIT_CRITICAL(&power_lock);
+}
+
+static void power_report(void *arg)
+{
+    static int64_t last_report_us = 0;
+    static configRUN_TIME_COUNTER_TYPE last_idle = 0;
+    int64_t now = esp_timer_get_time();
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // Time the idle task ran is time the chip could sleep, the closest thing to a current reading we have
+    configRUN_TIME_COUNTER_TYPE idle = ulTaskGetIdleRunTimeCounter();
+    uint32_t idle_percent = now > last_report_us ? (uint64_t)(idle - last_idle) * 100 / (now - last_report_us) : 0;
+    last_idle = idle;
+#else
+    uint32_t idle_percent = 0;
+#endif
+    last_report_us = now;
+
+    latency_stats_t latency;
+    taskENTER_CRITICAL(&power_lock);
+    latency = wake_latency;
+    taskEXIT_CRITICAL(&power_lock);
+
+    ESP_LOGI(TAG, "Idle %" PRIu32 "%%, wake-to-frame %" PRIu32 " taps: last %" PRIu32 " p50 %" PRIu32 " p99 %" PRIu32 " max %" PRIu32 " us",
+             idle_percent, latency.count, latency.last_us, latency_stats_percentile(&latency, 50),
+             latency_stats_percentile(&latency, 99), latency.max_us);
+#if CONFIG_PM_PROFILING
+    esp_pm_dump_locks(stdout); // time spent in each power mode, light sleep included
+#endif
+}
+
+static void power_update_radio(void *arg)
+{
+    // A node that isn't the master has to hear every beacon, a window would drop half of them
+    // and let it take over as a second master. The master only sends them.
+    net_time_stats_t stats;
+    net_time_get_stats(&stats);
+    bool windowed = stats.is_master;
+    if (windowed == radio_windowed) {
+        return;
+    }
+    esp_err_t err = esp_wifi_set_ps(windowed ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+    if (err == ESP_OK && windowed) {
+        err = esp_wifi_connectionless_module_set_wake_interval(LED_ESPNOW_WAKE_INTERVAL_MS);
+    }
+    if (err == ESP_OK && windowed) {
+        err = esp_now_set_wake_window(LED_ESPNOW_WAKE_WINDOW_MS);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to switch the radio mode: %s", esp_err_to_name(err));
+        return;
+    }
+    radio_windowed = windowed;
+    ESP_LOGI(TAG, "Radio %s", windowed ? "on ESP-NOW wake windows" : "always on");
+}
+
+esp_err_t power_init(void)
+{
+    latency_stats_reset(&wake_latency);
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = LED_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = LED_PM_MIN_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+        return err;
+    }
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, running at full clock");
+#endif
+
+    // The radio stays on until the node knows it is the master, so a booting node hears the beacons
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+    const esp_timer_create_args_t radio_timer_args = {
+        .callback = power_update_radio,
+        .name = "power_radio",
+    };
+    esp_timer_handle_t radio_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&radio_timer_args, &radio_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(radio_timer, LED_RADIO_CHECK_INTERVAL_MS * 1000ULL));
+
+    const esp_timer_create_args_t report_timer_args = {
+        .callback = power_report,
+        .name = "power_report",
+    };
+    esp_timer_handle_t report_timer;
+    ESP_ERROR_CHECK(esp_timer_create(&report_timer_args, &report_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(report_timer, LED_POWER_REPORT_INTERVAL_MS * 1000ULL));
+    return ESP_OK;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Enable dynamic frequency scaling, tickless light sleep and the ESP-NOW wake window
+ *
+ * Between frames, and whenever the strip is off, the chip drops to light
+ * sleep. Only the time master lets its radio sleep: it listens for
+ * LED_ESPNOW_WAKE_WINDOW_MS out of every LED_ESPNOW_WAKE_INTERVAL_MS, which
+ * bounds how long a tap can wait before it is heard. Every other node keeps
+ * the radio on so it doesn't miss the unacknowledged time beacons. A report
+ * of wake-to-action latency and idle time is logged every 10 seconds.
+ *
+ * @note Wi-Fi, ESP-NOW and net_time must already be started.
+ */
+esp_err_t power_init(void);
+
+/**
+ * @brief Record that the frame reacting to an event received at event_us has been sent
+ */
+void power_note_action(int64_t event_us);
+
+#ifdef __cplusplus
+}
+#endif
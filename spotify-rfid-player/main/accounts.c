@@ -0,0 +1,597 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "mbedtls/base64.h"
+#include <cJSON.h>
+#include "timer_wheel.h"
+#include "spotify.h"
+#include "spotify_client.h"
+#include "trace.h"
+#include "accounts.h"
+
+#define TAG "ACCOUNTS"
+
+#define ACCOUNTS_NVS_NAMESPACE   "accounts"
+#define ACCOUNTS_TASK_STACK_SIZE 8192 // token refreshes run a TLS handshake on this task
+#define ACCOUNTS_REDIRECT_URI    "http://192.168.149.88/"
+#define TOKEN_DEADLINE_MS        10000 // one token exchange or refresh, DNS to last byte
+#define TOKEN_RESPONSE_SIZE      1536
+#define TOKEN_REFRESH_MARGIN_US  (60 * 1000000LL) // refresh a minute early so in-flight requests don't race expiry
+#define ACCOUNTS_REFRESH_LEAD_S  300 // scheduled refreshes run this long before the token expires
+#define ACCOUNTS_STAGGER_S       15  // and each account this much later than the one before
+#define ACCOUNTS_RETRY_MIN_S     30  // first retry after a failed refresh, doubling up to the max
+#define ACCOUNTS_RETRY_MAX_S     600
+
+_Static_assert(ACCOUNTS_MAX <= 32, "due accounts are collected in a 32 bit mask");
+_Static_assert((ACCOUNTS_REFRESH_LEAD_S - (ACCOUNTS_MAX - 1) * ACCOUNTS_STAGGER_S) * 1000000LL > TOKEN_REFRESH_MARGIN_US,
+               "every account must be refreshed before its token stops counting as valid");
+
+// What survives a reboot, one NVS blob per account
+typedef struct {
+    char name[ACCOUNTS_NAME_SIZE];
+    char refresh_token[ACCOUNTS_TOKEN_SIZE];
+    char device_id[ACCOUNTS_DEVICE_ID_SIZE];
+} accounts_record_t;
+
+typedef struct {
+    accounts_record_t saved;
+    char access_token[ACCOUNTS_TOKEN_SIZE];
+    int64_t expires_us;             // esp_timer time after which access_token must be refreshed
+    uint32_t backoff_s;             // delay before the next retry, 0 after a successful refresh
+    SemaphoreHandle_t refresh_lock; // one token request per account at a time
+    timer_wheel_entry_t refresh;    // next scheduled refresh
+    uint32_t warm_hits;
+    uint32_t inline_refreshes;
+    uint32_t refreshes;
+    uint32_t refresh_failures;
+    esp_err_t last_result;
+} account_t;
+
+// Parsed token endpoint response
+typedef struct {
+    char access_token[ACCOUNTS_TOKEN_SIZE];
+    char refresh_token[ACCOUNTS_TOKEN_SIZE]; // empty when the old one stays valid
+    int expires_in;
+} accounts_tokens_t;
+
+static account_t pool[ACCOUNTS_MAX];
+static SemaphoreHandle_t pool_mutex = NULL; // slots, wheel and due_mask
+static SemaphoreHandle_t nvs_mutex = NULL;  // keeps account writes to flash in order
+static timer_wheel_t wheel;                 // one tick per second of esp_timer time
+static uint32_t due_mask = 0;               // accounts whose refresh fired, taken by the task
+static TaskHandle_t refresh_task = NULL;
+static volatile bool online = false;
+static char basic_auth[192];                // "Basic base64(client_id:client_secret)"
+
+static bool accounts_index_ok(int account)
+{
+    return account >= 0 && account < ACCOUNTS_MAX;
+}
+
+static uint32_t accounts_now_tick(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static bool accounts_token_valid_locked(const account_t *acct)
+{
+    return acct->access_token[0] != '\0' && esp_timer_get_time() < acct->expires_us - TOKEN_REFRESH_MARGIN_US;
+}
+
+static void accounts_fire(timer_wheel_entry_t *entry, void *ctx)
+{
+    due_mask |= 1UL << (uintptr_t)entry->arg;
+}
+
+// Wake the task to refresh what came due and to sleep until the next refresh
+static void accounts_kick(void)
+{
+    if (refresh_task != NULL) {
+        xTaskNotifyGive(refresh_task);
+    }
+}
+
+// The wheel only moves when the task looks at it, catch up first so the delay counts from now
+static void accounts_schedule_locked(int account, uint32_t delay_s)
+{
+    timer_wheel_advance(&wheel, accounts_now_tick(), accounts_fire, NULL);
+    timer_wheel_schedule(&wheel, &pool[account].refresh, delay_s);
+}
+
+// Schedule the next refresh from the token's expiry, or right away if it has run out
+static void accounts_plan_locked(int account)
+{
+    account_t *acct = &pool[account];
+    if (acct->saved.refresh_token[0] == '\0') {
+        timer_wheel_cancel(&wheel, &acct->refresh);
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t at = acct->expires_us - (ACCOUNTS_REFRESH_LEAD_S - account * ACCOUNTS_STAGGER_S) * 1000000LL;
+    // Accounts that all need a token at once, after boot or an outage, go a second apart
+    uint32_t delay_s = at > now ? (uint32_t)((at - now) / 1000000) : 1 + account;
+    accounts_schedule_locked(account, delay_s);
+}
+
+// Write the account to NVS if it differs from what is stored
+static void accounts_persist(int account)
+{
+    static accounts_record_t record, stored; // guarded by nvs_mutex
+    xSemaphoreTake(nvs_mutex, portMAX_DELAY);
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    record = pool[account].saved;
+    xSemaphoreGive(pool_mutex);
+
+    char key[8];
+    snprintf(key, sizeof(key), "acct%d", account);
+    nvs_handle_t nvs;
+    if (nvs_open(ACCOUNTS_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        size_t len = sizeof(stored);
+        bool same = nvs_get_blob(nvs, key, &stored, &len) == ESP_OK && len == sizeof(stored) &&
+                    memcmp(&stored, &record, sizeof(record)) == 0;
+        if (!same && nvs_set_blob(nvs, key, &record, sizeof(record)) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    memset(&record, 0, sizeof(record));
+    memset(&stored, 0, sizeof(stored));
+    xSemaphoreGive(nvs_mutex);
+}
+
+static void accounts_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(ACCOUNTS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "acct%d", i);
+        size_t len = sizeof(pool[i].saved);
+        if (nvs_get_blob(nvs, key, &pool[i].saved, &len) != ESP_OK || len != sizeof(pool[i].saved)) {
+            memset(&pool[i].saved, 0, sizeof(pool[i].saved));
+            continue;
+        }
+        ESP_LOGI(TAG, "Account %d: %s, %s", i, pool[i].saved.name[0] != '\0' ? pool[i].saved.name : "unnamed",
+                 pool[i].saved.refresh_token[0] != '\0' ? "authorized" : "not authorized");
+    }
+    nvs_close(nvs);
+}
+
+// Function to extract tokens from JSON response
+static esp_err_t extract_tokens(const char *json_response, accounts_tokens_t *tokens)
+{
+    memset(tokens, 0, sizeof(*tokens));
+    cJSON *json = cJSON_Parse(json_response);
+    if (json == NULL) {
+        const char *error_ptr = cJSON_GetErrorPtr();
+        if (error_ptr != NULL) {
+            ESP_LOGE(TAG, "JSON parse error: %s", error_ptr);
+        } else {
+            ESP_LOGE(TAG, "JSON parse error but error pointer is null");
+        }
+        return ESP_FAIL;
+    }
+
+    const cJSON *access_token_json = cJSON_GetObjectItemCaseSensitive(json, "access_token");
+    const cJSON *refresh_token_json = cJSON_GetObjectItemCaseSensitive(json, "refresh_token");
+    const cJSON *expires_in_json = cJSON_GetObjectItemCaseSensitive(json, "expires_in");
+
+    if (!cJSON_IsString(access_token_json) || access_token_json->valuestring == NULL) {
+        ESP_LOGE(TAG, "Access token not found or is not a string in JSON response");
+        cJSON_Delete(json);
+        return ESP_FAIL;
+    }
+    strlcpy(tokens->access_token, access_token_json->valuestring, sizeof(tokens->access_token));
+    // Spotify tokens last an hour, assume that if the field is missing
+    tokens->expires_in = cJSON_IsNumber(expires_in_json) ? expires_in_json->valueint : 3600;
+    // A refresh may or may not rotate the refresh token, keep the old one if it doesn't
+    if (cJSON_IsString(refresh_token_json) && refresh_token_json->valuestring != NULL) {
+        strlcpy(tokens->refresh_token, refresh_token_json->valuestring, sizeof(tokens->refresh_token));
+    }
+    TRACE(TOKEN_RECEIVED, tokens->expires_in, tokens->refresh_token[0] != '\0');
+
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+// POST a form to the accounts service under one deadline, the response body lands in response
+static esp_err_t token_request(const char *post_data, const char *auth_header, char *response, size_t response_size,
+                               int *status_code)
+{
+    spotify_deadline_t deadline = spotify_deadline_start(TOKEN_DEADLINE_MS, NULL);
+    spotify_response_t resp = {
+        .body = response,
+        .body_size = response_size,
+    };
+    esp_err_t err = spotify_client_post_form(&deadline, "https://accounts.spotify.com/api/token", auth_header,
+                                             post_data, &resp);
+    *status_code = resp.status_code;
+    if (err != ESP_OK) {
+        response[0] = '\0';
+        return err;
+    }
+    if (resp.status_code != 200) {
+        ESP_LOGE(TAG, "Token request failed with status code: %d", resp.status_code);
+        return ESP_FAIL;
+    }
+    return resp.body_len > 0 && !resp.truncated ? ESP_OK : ESP_FAIL;
+}
+
+// Store a token response in the account, with the pool locked
+static void accounts_store_locked(int account, const accounts_tokens_t *tokens)
+{
+    account_t *acct = &pool[account];
+    strlcpy(acct->access_token, tokens->access_token, sizeof(acct->access_token));
+    acct->expires_us = esp_timer_get_time() + tokens->expires_in * 1000000LL;
+    if (tokens->refresh_token[0] != '\0') {
+        strlcpy(acct->saved.refresh_token, tokens->refresh_token, sizeof(acct->saved.refresh_token));
+    }
+    acct->backoff_s = 0;
+    acct->last_result = ESP_OK;
+    accounts_plan_locked(account);
+}
+
+/*
+ * Trade the account's refresh token for a new access token.
+ *
+ * Scheduled refreshes run while the token is still good and are skipped if
+ * something else refreshed the account since they fired; callers waiting on
+ * a token skip the request as long as the token is valid. A 400 or 401 from
+ * the accounts service means the user revoked the app: the refresh token is
+ * dropped and the account has to be authorized again. Anything else is
+ * retried with a growing backoff.
+ */
+static esp_err_t accounts_refresh(int account, bool scheduled)
+{
+    account_t *acct = &pool[account];
+    xSemaphoreTake(acct->refresh_lock, portMAX_DELAY);
+
+    // Another task may have refreshed while we waited for the lock
+    char refresh_token[ACCOUNTS_TOKEN_SIZE];
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    bool skip = scheduled ? timer_wheel_scheduled(&acct->refresh) : accounts_token_valid_locked(acct);
+    strlcpy(refresh_token, acct->saved.refresh_token, sizeof(refresh_token));
+    xSemaphoreGive(pool_mutex);
+    if (skip || refresh_token[0] == '\0') {
+        xSemaphoreGive(acct->refresh_lock);
+        return skip ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    char post_data[320];
+    snprintf(post_data, sizeof(post_data), "grant_type=refresh_token&refresh_token=%s", refresh_token);
+    memset(refresh_token, 0, sizeof(refresh_token));
+    accounts_tokens_t *tokens = malloc(sizeof(*tokens));
+    char *response = malloc(TOKEN_RESPONSE_SIZE);
+    int status_code = 0;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (tokens != NULL && response != NULL) {
+        err = token_request(post_data, basic_auth, response, TOKEN_RESPONSE_SIZE, &status_code);
+        if (err == ESP_OK) {
+            err = extract_tokens(response, tokens);
+        }
+    }
+    bool revoked = status_code == 400 || status_code == 401;
+    if (revoked) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    if (err == ESP_OK) {
+        accounts_store_locked(account, tokens);
+        acct->refreshes++;
+    } else {
+        acct->refresh_failures++;
+        acct->last_result = err;
+        if (revoked) {
+            acct->access_token[0] = '\0';
+            acct->saved.refresh_token[0] = '\0';
+            timer_wheel_cancel(&wheel, &acct->refresh);
+        } else {
+            acct->backoff_s = acct->backoff_s == 0 ? ACCOUNTS_RETRY_MIN_S : MIN(acct->backoff_s * 2, ACCOUNTS_RETRY_MAX_S);
+            accounts_schedule_locked(account, acct->backoff_s);
+        }
+    }
+    uint32_t backoff_s = acct->backoff_s;
+    xSemaphoreGive(pool_mutex);
+    xSemaphoreGive(acct->refresh_lock);
+    accounts_kick();
+
+    if (tokens != NULL) {
+        memset(tokens, 0, sizeof(*tokens));
+    }
+    free(tokens);
+    free(response);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Access token of account %d refreshed", account);
+        accounts_persist(account); // only written if the refresh token was rotated
+    } else if (revoked) {
+        ESP_LOGE(TAG, "Account %d was revoked, authorize it again at /auth/login?account=%d", account, account);
+        accounts_persist(account);
+    } else {
+        ESP_LOGE(TAG, "Failed to refresh account %d: %s, retrying in %" PRIu32 " s", account, esp_err_to_name(err),
+                 backoff_s);
+    }
+    return err;
+}
+
+static void accounts_task(void *arg)
+{
+    while (1) {
+        xSemaphoreTake(pool_mutex, portMAX_DELAY);
+        timer_wheel_advance(&wheel, accounts_now_tick(), accounts_fire, NULL);
+        uint32_t due = due_mask;
+        due_mask = 0;
+        uint32_t wait_s = 0;
+        bool pending = timer_wheel_next_due(&wheel, &wait_s);
+        xSemaphoreGive(pool_mutex);
+
+        if (due != 0) {
+            for (int i = 0; i < ACCOUNTS_MAX; i++) {
+                // Offline refreshes are left off the wheel, going online plans them again
+                if ((due & (1UL << i)) && online) {
+                    accounts_refresh(i, true);
+                }
+            }
+            continue; // the requests took a while, look at the wheel again
+        }
+        // Asleep until the next refresh, or until someone schedules an earlier one
+        ulTaskNotifyTake(pdTRUE, pending ? pdMS_TO_TICKS(wait_s * 1000) : portMAX_DELAY);
+    }
+}
+
+esp_err_t accounts_start(void)
+{
+    pool_mutex = xSemaphoreCreateMutex();
+    nvs_mutex = xSemaphoreCreateMutex();
+    if (pool_mutex == NULL || nvs_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer_wheel_init(&wheel, accounts_now_tick());
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        pool[i].refresh_lock = xSemaphoreCreateMutex();
+        if (pool[i].refresh_lock == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        timer_wheel_entry_init(&pool[i].refresh, (void *)(uintptr_t)i);
+        pool[i].last_result = ESP_ERR_NOT_FINISHED;
+    }
+    accounts_load();
+
+    // The app's credentials are the same for every account
+    char credentials[128];
+    snprintf(credentials, sizeof(credentials), "%s:%s", client_id, client_secret);
+    unsigned char encoded[176];
+    size_t encoded_len = 0;
+    mbedtls_base64_encode(encoded, sizeof(encoded) - 1, &encoded_len, (const unsigned char *)credentials, strlen(credentials));
+    encoded[encoded_len] = '\0';
+    snprintf(basic_auth, sizeof(basic_auth), "Basic %s", encoded);
+
+    if (xTaskCreate(accounts_task, "accounts", ACCOUNTS_TASK_STACK_SIZE, NULL, 4, &refresh_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void accounts_set_online(bool is_online)
+{
+    online = is_online;
+    if (!is_online || pool_mutex == NULL) {
+        return;
+    }
+    // Whatever ran out or was waiting on a retry while offline is refreshed now
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        account_t *acct = &pool[i];
+        if (!timer_wheel_scheduled(&acct->refresh) || !accounts_token_valid_locked(acct)) {
+            acct->backoff_s = 0;
+            accounts_plan_locked(i);
+        }
+    }
+    xSemaphoreGive(pool_mutex);
+    accounts_kick();
+}
+
+esp_err_t accounts_exchange_code(int account, const char *auth_code)
+{
+    if (!accounts_index_ok(account)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Prepare the POST data
+    char post_data[670];
+    int post_data_len = snprintf(post_data, sizeof(post_data),
+                                 "grant_type=authorization_code&code=%s&redirect_uri=%s&client_id=%s&client_secret=%s",
+                                 auth_code, ACCOUNTS_REDIRECT_URI, client_id, client_secret);
+    if (post_data_len >= sizeof(post_data) - 1) {
+        ESP_LOGE(TAG, "Post data was truncated");
+        return ESP_ERR_NO_MEM;
+    }
+
+    account_t *acct = &pool[account];
+    accounts_tokens_t *tokens = malloc(sizeof(*tokens));
+    char *response = malloc(TOKEN_RESPONSE_SIZE);
+    int status_code = 0;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    xSemaphoreTake(acct->refresh_lock, portMAX_DELAY);
+    if (tokens != NULL && response != NULL) {
+        err = token_request(post_data, NULL, response, TOKEN_RESPONSE_SIZE, &status_code);
+        memset(post_data, 0, sizeof(post_data));
+        if (err == ESP_OK) {
+            err = extract_tokens(response, tokens);
+        }
+        if (err == ESP_OK && tokens->refresh_token[0] == '\0') {
+            ESP_LOGE(TAG, "Refresh token not found in JSON response");
+            err = ESP_FAIL;
+        }
+    }
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    if (err == ESP_OK) {
+        // The code may come from a different user than the account had before
+        memset(&acct->saved, 0, sizeof(acct->saved));
+        accounts_store_locked(account, tokens);
+    } else {
+        acct->last_result = err;
+    }
+    xSemaphoreGive(pool_mutex);
+    xSemaphoreGive(acct->refresh_lock);
+
+    if (tokens != NULL) {
+        memset(tokens, 0, sizeof(*tokens));
+    }
+    free(tokens);
+    free(response);
+    if (err == ESP_OK) {
+        accounts_persist(account);
+        accounts_kick();
+    } else {
+        ESP_LOGE(TAG, "Code exchange for account %d failed: %s", account, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t accounts_get_token(int account, char *token, size_t token_size)
+{
+    if (!accounts_index_ok(account)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    account_t *acct = &pool[account];
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    bool valid = accounts_token_valid_locked(acct);
+    if (valid) {
+        strlcpy(token, acct->access_token, token_size);
+        acct->warm_hits++;
+    }
+    xSemaphoreGive(pool_mutex);
+    if (valid) {
+        return ESP_OK;
+    }
+
+    // Cold: the scheduled refresh failed or hasn't run yet, the caller has to wait for one
+    esp_err_t err = accounts_refresh(account, false);
+    if (err == ESP_OK) {
+        xSemaphoreTake(pool_mutex, portMAX_DELAY);
+        strlcpy(token, acct->access_token, token_size);
+        acct->inline_refreshes++;
+        xSemaphoreGive(pool_mutex);
+    }
+    return err;
+}
+
+esp_err_t accounts_get_any_token(char *token, size_t token_size)
+{
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        int account = (ACCOUNTS_DEFAULT + i) % ACCOUNTS_MAX;
+        if (accounts_token_valid(account)) {
+            return accounts_get_token(account, token, token_size);
+        }
+    }
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        int account = (ACCOUNTS_DEFAULT + i) % ACCOUNTS_MAX;
+        if (accounts_get_token(account, token, token_size) == ESP_OK) {
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+bool accounts_token_valid(int account)
+{
+    if (!accounts_index_ok(account)) {
+        return false;
+    }
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    bool valid = accounts_token_valid_locked(&pool[account]);
+    xSemaphoreGive(pool_mutex);
+    return valid;
+}
+
+bool accounts_any_authorized(void)
+{
+    bool any = false;
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    for (int i = 0; i < ACCOUNTS_MAX && !any; i++) {
+        any = pool[i].saved.refresh_token[0] != '\0';
+    }
+    xSemaphoreGive(pool_mutex);
+    return any;
+}
+
+// Copy value into a saved field and persist the account if it changed
+static void accounts_set_saved(int account, char *field, size_t field_size, const char *value)
+{
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    bool changed = strncmp(field, value, field_size - 1) != 0;
+    strlcpy(field, value, field_size);
+    xSemaphoreGive(pool_mutex);
+    if (changed) {
+        accounts_persist(account);
+    }
+}
+
+void accounts_set_device(int account, const char *device_id)
+{
+    if (accounts_index_ok(account)) {
+        accounts_set_saved(account, pool[account].saved.device_id, sizeof(pool[account].saved.device_id), device_id);
+    }
+}
+
+void accounts_get_device(int account, char *device_id, size_t device_id_size)
+{
+    device_id[0] = '\0';
+    if (!accounts_index_ok(account)) {
+        return;
+    }
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    strlcpy(device_id, pool[account].saved.device_id, device_id_size);
+    xSemaphoreGive(pool_mutex);
+}
+
+void accounts_set_name(int account, const char *name)
+{
+    if (accounts_index_ok(account)) {
+        accounts_set_saved(account, pool[account].saved.name, sizeof(pool[account].saved.name), name);
+    }
+}
+
+esp_err_t accounts_get_info(int account, accounts_info_t *info)
+{
+    if (!accounts_index_ok(account)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const account_t *acct = &pool[account];
+    memset(info, 0, sizeof(*info));
+    xSemaphoreTake(pool_mutex, portMAX_DELAY);
+    info->authorized = acct->saved.refresh_token[0] != '\0';
+    info->token_valid = accounts_token_valid_locked(acct);
+    info->has_device = acct->saved.device_id[0] != '\0';
+    strlcpy(info->name, acct->saved.name, sizeof(info->name));
+    info->expires_us = acct->access_token[0] != '\0' ? acct->expires_us : 0;
+    // Wheel ticks are seconds of esp_timer time
+    info->next_refresh_us = timer_wheel_scheduled(&acct->refresh) ? acct->refresh.due_tick * 1000000LL : 0;
+    info->warm_hits = acct->warm_hits;
+    info->inline_refreshes = acct->inline_refreshes;
+    info->refreshes = acct->refreshes;
+    info->refresh_failures = acct->refresh_failures;
+    info->last_result = acct->last_result;
+    xSemaphoreGive(pool_mutex);
+    return ESP_OK;
+}
+
+esp_err_t accounts_authorize_url(int account, char *url, size_t url_size)
+{
+    if (!accounts_index_ok(account)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int len = snprintf(url, url_size, "https://accounts.spotify.com/authorize?client_id=%s&response_type=code&redirect_uri=%s&state=%d&show_dialog=true&scope=user-read-private%%20user-read-email%%20user-modify-playback-state%%20user-read-playback-position%%20user-library-read%%20streaming%%20user-read-playback-state%%20user-read-recently-played%%20playlist-read-private",
+                       client_id, ACCOUNTS_REDIRECT_URI, account);
+    return len < url_size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define ACCOUNTS_MAX            CONFIG_SPOTIFY_ACCOUNTS_MAX
+#define ACCOUNTS_DEFAULT        0   // account of cards that don't name one, and of the first authorization
+#define ACCOUNTS_TOKEN_SIZE     252
+#define ACCOUNTS_DEVICE_ID_SIZE 100
+#define ACCOUNTS_NAME_SIZE      32
+
+/**
+ * @brief Snapshot of one account, for /auth/status
+ */
+typedef struct {
+    bool authorized;                /*!< A refresh token is stored */
+    bool token_valid;               /*!< The access token is usable right now */
+    bool has_device;                /*!< A Spotify Connect device ID is cached */
+    char name[ACCOUNTS_NAME_SIZE];  /*!< Spotify display name, empty until the profile lookup */
+    int64_t expires_us;             /*!< esp_timer time the access token runs out, 0 without one */
+    int64_t next_refresh_us;        /*!< esp_timer time of the next scheduled refresh, 0 if none */
+    uint32_t warm_hits;             /*!< Tokens handed out without waiting */
+    uint32_t inline_refreshes;      /*!< Tokens the caller had to wait for a refresh for */
+    uint32_t refreshes;             /*!< Successful refreshes */
+    uint32_t refresh_failures;
+    esp_err_t last_result;          /*!< Result of the last refresh or code exchange */
+} accounts_info_t;
+
+/**
+ * @brief Load the stored accounts and start the refresh task
+ *
+ * Every account keeps its refresh token, display name and device ID in NVS,
+ * so a reboot doesn't need the browser again. Access tokens only live in RAM.
+ * The refreshes of all accounts run on one task driven by a timer wheel with
+ * one second ticks: each account is refreshed a few minutes before its token
+ * expires, staggered so accounts don't all refresh in the same second, and
+ * a failed refresh is retried with a growing backoff. A tap therefore finds a
+ * valid token for any account already waiting.
+ */
+esp_err_t accounts_start(void);
+
+/**
+ * @brief Tell the pool whether the network is usable
+ *
+ * Going online refreshes every account whose token ran out meanwhile.
+ */
+void accounts_set_online(bool online);
+
+/**
+ * @brief Trade an authorization code from the OAuth redirect for this account's tokens
+ *
+ * The account's name and device are forgotten, the code may belong to another user.
+ */
+esp_err_t accounts_exchange_code(int account, const char *auth_code);
+
+/**
+ * @brief Copy the account's access token, refreshing it first only if it isn't valid
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an account outside the pool,
+ *         ESP_ERR_INVALID_STATE if the account isn't authorized or its
+ *         refresh token was revoked, or the refresh's error
+ */
+esp_err_t accounts_get_token(int account, char *token, size_t token_size);
+
+/**
+ * @brief Copy the token of any authorized account, for requests that aren't about a user
+ *
+ * Valid tokens are preferred, starting with ACCOUNTS_DEFAULT.
+ */
+esp_err_t accounts_get_any_token(char *token, size_t token_size);
+
+/**
+ * @brief Whether the account has an access token that is not about to expire
+ */
+bool accounts_token_valid(int account);
+
+/**
+ * @brief Whether any account has a refresh token
+ */
+bool accounts_any_authorized(void);
+
+/**
+ * @brief Remember the Spotify Connect device the account plays on
+ */
+void accounts_set_device(int account, const char *device_id);
+
+/**
+ * @brief Copy the account's device ID, empty if none is known
+ */
+void accounts_get_device(int account, char *device_id, size_t device_id_size);
+
+/**
+ * @brief Remember the account's display name
+ */
+void accounts_set_name(int account, const char *name);
+
+/**
+ * @brief Copy the state of one account
+ */
+esp_err_t accounts_get_info(int account, accounts_info_t *info);
+
+/**
+ * @brief Build the Spotify authorize URL for an account
+ *
+ * The account index travels in the OAuth state parameter and comes back
+ * with the code on the redirect.
+ */
+esp_err_t accounts_authorize_url(int account, char *url, size_t url_size);
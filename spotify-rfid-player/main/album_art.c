@@ -0,0 +1,455 @@
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_now.h"
+#include "esp_http_client.h"
+#include "nvs.h"
+#include "espnow_proto.h"
+#include "jpeg_dc.h"
+#include "palette.h"
+#include "album_art.h"
+#include "playback.h"
+#include "accounts.h"
+#include "spotify_client.h"
+#include "power.h"
+#include "trace.h"
+
+#define TAG "ALBUM_ART"
+
+#define ALBUM_ART_TASK_STACK_SIZE 8192  // TLS handshakes run on this task
+#define ALBUM_ART_CACHE_ENTRIES   16
+#define ALBUM_ART_LOOKUP_SIZE     4096  // enough of an album or track object to reach its images
+#define ALBUM_ART_TIMEOUT_MS      10000 // one palette fetch, URL lookup and image download together
+#define ALBUM_ART_MAX_IMAGE_BYTES (256 * 1024) // give up on a runaway download
+#define ALBUM_ART_SEND_REPEATS    3     // broadcasts aren't acked and LED nodes only listen half the time
+#define ALBUM_ART_SEND_GAP_MS     35
+#define ALBUM_ART_NVS_NAMESPACE   "palette"
+#define ALBUM_ART_NVS_SLOTS       32    // covers remembered across reboots, the oldest is overwritten
+#define ALBUM_ART_NVS_NEXT_KEY    "next"
+
+#define SPOTIFY_API_URL "https://api.spotify.com/v1"
+
+typedef struct {
+    uint8_t uid[PLAYBACK_UID_LEN];
+    char uri[64];
+} album_art_job_t;
+
+// Stored in NVS as is, keep the layout stable
+typedef struct {
+    uint8_t count;
+    palette_color_t colors[PALETTE_MAX_COLORS];
+} album_art_palette_t;
+
+typedef struct {
+    uint32_t uri_hash; // 0 for an empty slot
+    uint32_t last_used;
+    album_art_palette_t palette;
+} album_art_entry_t;
+
+// One slot of the NVS ring, stored as is
+typedef struct {
+    uint32_t uri_hash;
+    album_art_palette_t palette;
+} album_art_nvs_slot_t;
+
+typedef struct {
+    esp_http_client_handle_t client;
+    const spotify_deadline_t *deadline;
+    size_t total;
+} album_art_stream_t;
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+static QueueHandle_t album_art_queue = NULL;
+static volatile uint32_t job_generation = 0; // a newer card cancels the lookup for the older one
+static portMUX_TYPE mood_lock = portMUX_INITIALIZER_UNLOCKED;
+static album_art_palette_t mood; // last palette sent
+
+// Worker-only state, too big for the task stack
+static album_art_entry_t cache[ALBUM_ART_CACHE_ENTRIES];
+static uint32_t cache_clock = 0;
+static jpeg_dc_decoder_t decoder;
+static palette_sampler_t sampler;
+
+static uint32_t album_art_hash(const char *uri)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char *c = uri; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static bool album_art_cache_get(uint32_t hash, album_art_palette_t *palette)
+{
+    for (int i = 0; i < ALBUM_ART_CACHE_ENTRIES; i++) {
+        if (cache[i].uri_hash == hash) {
+            cache[i].last_used = ++cache_clock;
+            *palette = cache[i].palette;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void album_art_cache_put(uint32_t hash, const album_art_palette_t *palette)
+{
+    album_art_entry_t *victim = &cache[0];
+    for (int i = 0; i < ALBUM_ART_CACHE_ENTRIES; i++) {
+        if (cache[i].uri_hash == 0 || cache[i].uri_hash == hash) {
+            victim = &cache[i];
+            break;
+        }
+        if (cache[i].last_used < victim->last_used) {
+            victim = &cache[i];
+        }
+    }
+    victim->uri_hash = hash;
+    victim->last_used = ++cache_clock;
+    victim->palette = *palette;
+}
+
+/*
+ * NVS keeps the palettes in a fixed ring of ALBUM_ART_NVS_SLOTS keys, so the
+ * namespace can't grow with every cover ever played. The ring is only read
+ * after a RAM miss, which is about to cost a download anyway.
+ */
+static bool album_art_nvs_get(uint32_t hash, album_art_palette_t *palette)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(ALBUM_ART_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    bool found = false;
+    for (int i = 0; i < ALBUM_ART_NVS_SLOTS && !found; i++) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), "s%02d", i);
+        album_art_nvs_slot_t slot;
+        size_t len = sizeof(slot);
+        found = nvs_get_blob(nvs, key, &slot, &len) == ESP_OK && len == sizeof(slot) && slot.uri_hash == hash &&
+                slot.palette.count > 0 && slot.palette.count <= PALETTE_MAX_COLORS;
+        if (found) {
+            *palette = slot.palette;
+        }
+    }
+    nvs_close(nvs);
+    return found;
+}
+
+static void album_art_nvs_put(uint32_t hash, const album_art_palette_t *palette)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(ALBUM_ART_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    uint8_t next = 0;
+    esp_err_t err = nvs_get_u8(nvs, ALBUM_ART_NVS_NEXT_KEY, &next);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // No ring yet, drop the one-key-per-URI entries older firmware left behind
+        nvs_erase_all(nvs);
+    }
+    if (next >= ALBUM_ART_NVS_SLOTS) {
+        next = 0;
+    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    snprintf(key, sizeof(key), "s%02d", next);
+    album_art_nvs_slot_t slot = {
+        .uri_hash = hash,
+        .palette = *palette,
+    };
+    if (nvs_set_blob(nvs, key, &slot, sizeof(slot)) == ESP_OK &&
+        nvs_set_u8(nvs, ALBUM_ART_NVS_NEXT_KEY, (next + 1) % ALBUM_ART_NVS_SLOTS) == ESP_OK) {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+// Web API object that lists the cover images of a URI
+static bool album_art_lookup_url(const char *uri, char *url, size_t url_size)
+{
+    static const struct {
+        const char *prefix;
+        const char *format;
+    } endpoints[] = {
+        {"spotify:album:", SPOTIFY_API_URL "/albums/%s?market=from_token"},
+        {"spotify:playlist:", SPOTIFY_API_URL "/playlists/%s/images"},
+        {"spotify:track:", SPOTIFY_API_URL "/tracks/%s?market=from_token"},
+        {"spotify:artist:", SPOTIFY_API_URL "/artists/%s"},
+    };
+    for (size_t i = 0; i < sizeof(endpoints) / sizeof(endpoints[0]); i++) {
+        size_t len = strlen(endpoints[i].prefix);
+        if (strncmp(uri, endpoints[i].prefix, len) == 0) {
+            return snprintf(url, url_size, endpoints[i].format, uri + len) < url_size;
+        }
+    }
+    return false;
+}
+
+/*
+ * Pull the last "url" out of the first "images" array, or out of the body when
+ * it is the array itself. Spotify lists images largest first, so the last one
+ * is the 64 px thumbnail. The body may be cut short, so this scans instead of
+ * parsing.
+ */
+static bool album_art_find_image_url(const char *json, char *url, size_t url_size)
+{
+    const char *p = strstr(json, "\"images\"");
+    p = p != NULL ? strchr(p, '[') : (json[0] == '[' ? json : NULL);
+    if (p == NULL) {
+        return false;
+    }
+    bool found = false;
+    int depth = 0;
+    for (; *p != '\0'; p++) {
+        if (*p == '[' || *p == '{') {
+            depth++;
+        } else if (*p == ']' || *p == '}') {
+            if (--depth == 0) {
+                break;
+            }
+        } else if (*p == '"') {
+            const char *end = strchr(p + 1, '"');
+            if (end == NULL) {
+                break;
+            }
+            if (end - p == 4 && strncmp(p + 1, "url", 3) == 0) {
+                const char *value = strchr(end + 1, '"');
+                const char *value_end = value != NULL ? strchr(value + 1, '"') : NULL;
+                if (value_end == NULL) {
+                    break;
+                }
+                size_t len = value_end - value - 1;
+                if (len < url_size) {
+                    memcpy(url, value + 1, len);
+                    url[len] = '\0';
+                    found = true;
+                }
+                end = value_end;
+            }
+            p = end;
+        }
+    }
+    return found;
+}
+
+static esp_err_t album_art_image_url(const char *uri, const spotify_deadline_t *deadline,
+                                     char *image_url, size_t image_url_size)
+{
+    char url[160];
+    if (!album_art_lookup_url(uri, url, sizeof(url))) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    // Catalog lookups aren't about a user, any signed in account will do
+    static char bearer[ACCOUNTS_TOKEN_SIZE]; // only the art task looks images up
+    if (accounts_get_any_token(bearer, sizeof(bearer)) != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char *body = malloc(ALBUM_ART_LOOKUP_SIZE);
+    if (body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    spotify_response_t resp = {
+        .body = body,
+        .body_size = ALBUM_ART_LOOKUP_SIZE,
+    };
+    // One lookup per album ever played, the result is cached for good
+    esp_err_t err = spotify_client_request(SPOTIFY_PRIORITY_USER, deadline, HTTP_METHOD_GET, url, bearer, NULL, &resp);
+    if (err == ESP_OK && resp.status_code != 200) {
+        ESP_LOGW(TAG, "Image lookup failed with status code: %d", resp.status_code);
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK && !album_art_find_image_url(body, image_url, image_url_size)) {
+        err = ESP_ERR_NOT_FOUND;
+    }
+    free(body);
+    return err;
+}
+
+static size_t album_art_stream_read(void *ctx, uint8_t *buf, size_t len)
+{
+    album_art_stream_t *stream = ctx;
+    uint32_t left_ms = spotify_deadline_remaining_ms(stream->deadline);
+    if (stream->total >= ALBUM_ART_MAX_IMAGE_BYTES || left_ms == 0 || spotify_deadline_cancelled(stream->deadline)) {
+        return 0;
+    }
+    esp_http_client_set_timeout_ms(stream->client, left_ms);
+    int n = esp_http_client_read(stream->client, (char *)buf, len);
+    if (n <= 0) {
+        return 0;
+    }
+    stream->total += n;
+    return n;
+}
+
+static void album_art_stream_block(void *ctx, uint16_t bx, uint16_t by, const uint8_t rgb[3])
+{
+    palette_sampler_add(ctx, rgb);
+}
+
+// Decode the image straight off the socket, only the decoder's 256 byte buffer is ever held
+static esp_err_t album_art_decode(const char *image_url, const spotify_deadline_t *deadline,
+                                  album_art_palette_t *palette)
+{
+    // The download shares the operation's deadline with the image URL lookup before it
+    if (spotify_deadline_cancelled(deadline)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    uint32_t left_ms = spotify_deadline_remaining_ms(deadline);
+    if (left_ms == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_http_client_config_t config = {
+        .url = image_url,
+        .timeout_ms = left_ms,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_FAIL;
+    }
+    power_request_begin();
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK && esp_http_client_fetch_headers(client) < 0) {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK && esp_http_client_get_status_code(client) != 200) {
+        ESP_LOGW(TAG, "Image download failed with status code: %d", esp_http_client_get_status_code(client));
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK) {
+        album_art_stream_t stream = {
+            .client = client,
+            .deadline = deadline,
+        };
+        uint16_t width, height;
+        palette_sampler_init(&sampler);
+        jpeg_dc_result_t result = jpeg_dc_decode(&decoder, album_art_stream_read, &stream,
+                                                 album_art_stream_block, &sampler, &width, &height);
+        if (result == JPEG_DC_OK) {
+            palette->count = palette_extract(&sampler, palette->colors, PALETTE_MAX_COLORS);
+            ESP_LOGD(TAG, "%ux%u cover, %u bytes read, %u colors", width, height, (unsigned)stream.total,
+                     palette->count);
+        } else {
+            ESP_LOGW(TAG, "Cover image not decoded (%d) after %u bytes", result, (unsigned)stream.total);
+            err = result == JPEG_DC_ERR_UNSUPPORTED ? ESP_ERR_NOT_SUPPORTED : ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    power_request_end();
+    return err == ESP_OK && palette->count == 0 ? ESP_ERR_NOT_FOUND : err;
+}
+
+static void album_art_send(const uint8_t *uid, const album_art_palette_t *palette)
+{
+    espnow_proto_palette_t frame = {
+        .magic = ESPNOW_PROTO_PALETTE_MAGIC,
+        .count = palette->count,
+    };
+    memcpy(frame.uid, uid, sizeof(frame.uid));
+    for (int i = 0; i < palette->count && i < ESPNOW_PROTO_PALETTE_MAX; i++) {
+        memcpy(frame.rgb[i], palette->colors[i].rgb, 3);
+        frame.weight[i] = palette->colors[i].weight;
+    }
+    for (int i = 0; i < ALBUM_ART_SEND_REPEATS; i++) {
+        if (i > 0) {
+            vTaskDelay(pdMS_TO_TICKS(ALBUM_ART_SEND_GAP_MS));
+        }
+        esp_err_t err = esp_now_send(broadcast_mac, (const uint8_t *)&frame, sizeof(frame));
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Palette broadcast failed: %s", esp_err_to_name(err));
+            return;
+        }
+    }
+}
+
+static void album_art_task(void *arg)
+{
+    album_art_job_t job;
+    while (1) {
+        xQueueReceive(album_art_queue, &job, portMAX_DELAY);
+        spotify_deadline_t deadline = spotify_deadline_start(ALBUM_ART_TIMEOUT_MS, &job_generation);
+        int64_t start_us = esp_timer_get_time();
+        uint32_t hash = album_art_hash(job.uri);
+
+        album_art_palette_t palette = {0};
+        bool cached = album_art_cache_get(hash, &palette);
+        if (!cached && album_art_nvs_get(hash, &palette)) {
+            album_art_cache_put(hash, &palette);
+            cached = true;
+        }
+        if (!cached) {
+            char image_url[128];
+            esp_err_t err = album_art_image_url(job.uri, &deadline, image_url, sizeof(image_url));
+            if (err == ESP_OK) {
+                err = album_art_decode(image_url, &deadline, &palette);
+            }
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "No palette for %s: %s", job.uri, esp_err_to_name(err));
+                continue;
+            }
+            album_art_cache_put(hash, &palette);
+            album_art_nvs_put(hash, &palette);
+        }
+
+        TRACE(ALBUM_ART, hash, esp_timer_get_time() - start_us);
+        ESP_LOGI(TAG, "Palette of %s: %u colors, first #%02x%02x%02x%s", job.uri, palette.count,
+                 palette.colors[0].rgb[0], palette.colors[0].rgb[1], palette.colors[0].rgb[2],
+                 cached ? " (cached)" : "");
+        taskENTER_CRITICAL(&mood_lock);
+        mood = palette;
+        taskEXIT_CRITICAL(&mood_lock);
+        album_art_send(job.uid, &palette);
+    }
+}
+
+esp_err_t album_art_start(void)
+{
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK) {
+        return err;
+    }
+    esp_now_peer_info_t peer = {
+        .channel = 0, // whatever channel the station is on
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,
+    };
+    memcpy(peer.peer_addr, broadcast_mac, ESP_NOW_ETH_ALEN);
+    err = esp_now_add_peer(&peer);
+    if (err != ESP_OK && err != ESP_ERR_ESPNOW_EXIST) {
+        return err;
+    }
+
+    album_art_queue = xQueueCreate(1, sizeof(album_art_job_t));
+    if (album_art_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Below the playback worker, taps never wait on a cover download
+    if (xTaskCreate(album_art_task, "album_art", ALBUM_ART_TASK_STACK_SIZE, NULL, 3, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void album_art_request(const uint8_t *uid, const char *uri)
+{
+    if (album_art_queue == NULL || uri == NULL || uri[0] == '\0') {
+        return;
+    }
+    album_art_job_t job;
+    memcpy(job.uid, uid, sizeof(job.uid));
+    strlcpy(job.uri, uri, sizeof(job.uri));
+    job_generation++;
+    xQueueOverwrite(album_art_queue, &job);
+}
+
+size_t album_art_get_mood(palette_color_t colors[PALETTE_MAX_COLORS])
+{
+    taskENTER_CRITICAL(&mood_lock);
+    size_t count = mood.count;
+    memcpy(colors, mood.colors, sizeof(mood.colors));
+    taskEXIT_CRITICAL(&mood_lock);
+    return count;
+}
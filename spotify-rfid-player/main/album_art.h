@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "palette.h"
+
+/**
+ * @brief Start the album art worker and ESP-NOW
+ *
+ * Needs Wi-Fi to be started. Palettes are broadcast on the channel of the
+ * access point, so LED nodes only hear them when they are on the same channel.
+ */
+esp_err_t album_art_start(void);
+
+/**
+ * @brief Send the cover art palette of a Spotify URI to the LED nodes
+ *
+ * Returns immediately. The worker looks the URI up in its RAM and NVS caches,
+ * and only on a miss fetches the smallest cover image, streams it through the
+ * 1/8 scale JPEG decoder and clusters the result. A request made while the
+ * worker is busy replaces any request still waiting.
+ *
+ * @param uid Card that started playback, PLAYBACK_UID_LEN bytes
+ * @param uri spotify:album:, spotify:playlist:, spotify:track: or spotify:artist: URI
+ */
+void album_art_request(const uint8_t *uid, const char *uri);
+
+/**
+ * @brief Copy the palette last sent to the LED nodes, strongest color first
+ *
+ * @return Number of colors, 0 until the first palette is known
+ */
+size_t album_art_get_mood(palette_color_t colors[PALETTE_MAX_COLORS]);
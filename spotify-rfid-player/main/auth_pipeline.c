@@ -0,0 +1,308 @@
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cJSON.h>
+#include "spotify.h"
+#include "accounts.h"
+#include "auth_pipeline.h"
+
+#define TAG "AUTH_PIPELINE"
+
+#define AUTH_CODE_MAX_LEN         512
+#define AUTH_PIPELINE_STACK_SIZE  8192 // TLS handshakes run on both tasks
+#define AUTH_LOOKUP_WAIT_MS       30000 // the profile lookup has its own deadline, this only guards against a hang
+#define AUTH_DEVICE_NAME          "Akhil’s Laptop"
+#define AUTH_LOGIN_URL_SIZE       512
+
+typedef struct {
+    int account;
+    uint32_t seq;         // tags the status updates of this run
+    int64_t submitted_us;
+    char code[AUTH_CODE_MAX_LEN];
+} auth_pipeline_job_t;
+
+typedef struct {
+    int account;
+    uint32_t seq;
+} auth_profile_job_t;
+
+static QueueHandle_t code_queue = NULL;
+static QueueHandle_t profile_queue = NULL;
+static QueueHandle_t profile_done = NULL; // seq of each finished profile lookup
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t last_seq = 0;    // last seq handed out by auth_pipeline_submit()
+static uint32_t status_seq = 0;  // run the status describes, older runs can't touch it
+static auth_pipeline_status_t status = {
+    .state = AUTH_PIPELINE_IDLE,
+    .exchange_result = ESP_ERR_NOT_FINISHED,
+    .profile_result = ESP_ERR_NOT_FINISHED,
+    .device_result = ESP_ERR_NOT_FINISHED,
+};
+
+// The status belongs to the run the worker took last, updates from any other run are dropped
+static void auth_pipeline_begin(const auth_pipeline_job_t *job)
+{
+    taskENTER_CRITICAL(&status_lock);
+    status_seq = job->seq;
+    status.state = AUTH_PIPELINE_EXCHANGING;
+    status.account = job->account;
+    status.exchange_result = ESP_ERR_NOT_FINISHED;
+    status.profile_result = ESP_ERR_NOT_FINISHED;
+    status.device_result = ESP_ERR_NOT_FINISHED;
+    status.started_us = job->submitted_us;
+    status.finished_us = 0;
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+static void auth_pipeline_set_state(uint32_t seq, auth_pipeline_state_t state)
+{
+    taskENTER_CRITICAL(&status_lock);
+    if (seq == status_seq) {
+        status.state = state;
+        if (state == AUTH_PIPELINE_READY || state == AUTH_PIPELINE_FAILED) {
+            status.finished_us = esp_timer_get_time();
+        }
+    }
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+static void auth_pipeline_set_result(uint32_t seq, esp_err_t *field, esp_err_t result)
+{
+    taskENTER_CRITICAL(&status_lock);
+    if (seq == status_seq) {
+        *field = result;
+    }
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+// Second lane for the lookups: runs the profile request while the pipeline task fetches devices
+static void auth_profile_task(void *arg)
+{
+    auth_profile_job_t job;
+    while (1) {
+        xQueueReceive(profile_queue, &job, portMAX_DELAY);
+        esp_err_t err = get_user_profile(job.account);
+        // A lookup that outlived its run only reports to a run that has stopped listening
+        auth_pipeline_set_result(job.seq, &status.profile_result, err);
+        xQueueSend(profile_done, &job.seq, 0);
+    }
+}
+
+// Wait for this run's profile lookup, skipping completions of runs that gave up on theirs
+static bool auth_pipeline_wait_profile(uint32_t seq)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t wait = pdMS_TO_TICKS(AUTH_LOOKUP_WAIT_MS);
+    uint32_t done_seq;
+    while (xTaskGetTickCount() - start < wait) {
+        if (xQueueReceive(profile_done, &done_seq, wait - (xTaskGetTickCount() - start)) != pdTRUE) {
+            break;
+        }
+        if (done_seq == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void auth_pipeline_task(void *arg)
+{
+    static auth_pipeline_job_t job;
+    while (1) {
+        xQueueReceive(code_queue, &job, portMAX_DELAY);
+        auth_pipeline_begin(&job);
+
+        esp_err_t err = accounts_exchange_code(job.account, job.code);
+        memset(job.code, 0, sizeof(job.code)); // single use, don't keep it around
+        auth_pipeline_set_result(job.seq, &status.exchange_result, err);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Token exchange failed: %s", esp_err_to_name(err));
+            auth_pipeline_set_state(job.seq, AUTH_PIPELINE_FAILED);
+            continue;
+        }
+
+        // Both lookups only need the token, so neither waits for the other
+        auth_pipeline_set_state(job.seq, AUTH_PIPELINE_LOOKING_UP);
+        auth_profile_job_t profile_job = {
+            .account = job.account,
+            .seq = job.seq,
+        };
+        xQueueOverwrite(profile_queue, &profile_job);
+        err = get_spotify_device_id(job.account, AUTH_DEVICE_NAME);
+        auth_pipeline_set_result(job.seq, &status.device_result, err);
+        if (!auth_pipeline_wait_profile(job.seq)) {
+            ESP_LOGW(TAG, "Profile lookup still running, not waiting for it");
+            auth_pipeline_set_result(job.seq, &status.profile_result, ESP_ERR_TIMEOUT);
+        }
+
+        // The token is what matters, a missing device only means playback goes to the active one
+        auth_pipeline_set_state(job.seq, AUTH_PIPELINE_READY);
+        auth_pipeline_status_t done;
+        auth_pipeline_get_status(&done);
+        ESP_LOGI(TAG, "Account %d authorized in %lld ms: profile %s, device %s", job.account,
+                 (long long)((done.finished_us - done.started_us) / 1000),
+                 esp_err_to_name(done.profile_result), esp_err_to_name(done.device_result));
+    }
+}
+
+esp_err_t auth_pipeline_start(void)
+{
+    code_queue = xQueueCreate(1, sizeof(auth_pipeline_job_t));
+    profile_queue = xQueueCreate(1, sizeof(auth_profile_job_t));
+    profile_done = xQueueCreate(2, sizeof(uint32_t)); // this run's completion and a stale one
+    if (code_queue == NULL || profile_queue == NULL || profile_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(auth_profile_task, "auth_profile", AUTH_PIPELINE_STACK_SIZE, NULL, 5, NULL) != pdPASS ||
+        xTaskCreate(auth_pipeline_task, "auth_pipeline", AUTH_PIPELINE_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t auth_pipeline_submit(int account, const char *auth_code)
+{
+    if (code_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (account < 0 || account >= ACCOUNTS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auth_pipeline_job_t job = {
+        .account = account,
+        .submitted_us = esp_timer_get_time(),
+    };
+    if (strlcpy(job.code, auth_code, sizeof(job.code)) >= sizeof(job.code)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // The status is left to the worker, it may still be reporting the run it is on
+    taskENTER_CRITICAL(&status_lock);
+    job.seq = ++last_seq;
+    taskEXIT_CRITICAL(&status_lock);
+    xQueueOverwrite(code_queue, &job);
+    memset(job.code, 0, sizeof(job.code));
+    return ESP_OK;
+}
+
+void auth_pipeline_get_status(auth_pipeline_status_t *out)
+{
+    taskENTER_CRITICAL(&status_lock);
+    *out = status;
+    taskEXIT_CRITICAL(&status_lock);
+}
+
+const char *auth_pipeline_state_name(auth_pipeline_state_t state)
+{
+    switch (state) {
+        case AUTH_PIPELINE_IDLE:
+            return "idle";
+        case AUTH_PIPELINE_EXCHANGING:
+            return "exchanging";
+        case AUTH_PIPELINE_LOOKING_UP:
+            return "looking_up";
+        case AUTH_PIPELINE_READY:
+            return "ready";
+        case AUTH_PIPELINE_FAILED:
+            return "failed";
+    }
+    return "unknown";
+}
+
+static esp_err_t auth_status_get_handler(httpd_req_t *req)
+{
+    auth_pipeline_status_t current;
+    auth_pipeline_get_status(&current);
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "state", auth_pipeline_state_name(current.state));
+    cJSON_AddNumberToObject(root, "account", current.account);
+    cJSON_AddStringToObject(root, "exchange", esp_err_to_name(current.exchange_result));
+    cJSON_AddStringToObject(root, "profile", esp_err_to_name(current.profile_result));
+    cJSON_AddStringToObject(root, "device", esp_err_to_name(current.device_result));
+    cJSON_AddBoolToObject(root, "token_valid", accounts_token_valid(current.account));
+    int64_t now_us = esp_timer_get_time();
+    int64_t end_us = current.finished_us != 0 ? current.finished_us : now_us;
+    cJSON_AddNumberToObject(root, "elapsed_ms", current.started_us != 0 ? (double)((end_us - current.started_us) / 1000) : 0);
+
+    // Every account in the pool, signed in or not
+    cJSON *accounts = cJSON_AddArrayToObject(root, "accounts");
+    for (int i = 0; i < ACCOUNTS_MAX; i++) {
+        accounts_info_t info;
+        accounts_get_info(i, &info);
+        cJSON *account = cJSON_CreateObject();
+        cJSON_AddNumberToObject(account, "account", i);
+        cJSON_AddStringToObject(account, "name", info.name);
+        cJSON_AddBoolToObject(account, "authorized", info.authorized);
+        cJSON_AddBoolToObject(account, "token_valid", info.token_valid);
+        cJSON_AddBoolToObject(account, "device", info.has_device);
+        cJSON_AddNumberToObject(account, "expires_in_s", info.expires_us > now_us ? (double)((info.expires_us - now_us) / 1000000) : 0);
+        cJSON_AddNumberToObject(account, "refresh_in_s", info.next_refresh_us > now_us ? (double)((info.next_refresh_us - now_us) / 1000000) : 0);
+        cJSON_AddNumberToObject(account, "warm_hits", info.warm_hits);
+        cJSON_AddNumberToObject(account, "inline_refreshes", info.inline_refreshes);
+        cJSON_AddNumberToObject(account, "refreshes", info.refreshes);
+        cJSON_AddNumberToObject(account, "refresh_failures", info.refresh_failures);
+        cJSON_AddStringToObject(account, "last_result", esp_err_to_name(info.last_result));
+        cJSON_AddItemToArray(accounts, account);
+    }
+
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (body == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_sendstr(req, body);
+    cJSON_free(body);
+    return err;
+}
+
+// Send the browser to the Spotify sign-in, the account comes back in the state parameter
+static esp_err_t auth_login_get_handler(httpd_req_t *req)
+{
+    int account = ACCOUNTS_DEFAULT;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "account", value, sizeof(value)) == ESP_OK) {
+        account = atoi(value);
+    }
+    char *url = malloc(AUTH_LOGIN_URL_SIZE);
+    if (url == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    esp_err_t err = accounts_authorize_url(account, url, AUTH_LOGIN_URL_SIZE);
+    if (err != ESP_OK) {
+        free(url);
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No such account");
+    }
+    httpd_resp_set_status(req, "302 Found");
+    httpd_resp_set_hdr(req, "Location", url);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    err = httpd_resp_send(req, NULL, 0);
+    free(url);
+    return err;
+}
+
+esp_err_t auth_pipeline_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t login_uri = {
+        .uri = "/auth/login",
+        .method = HTTP_GET,
+        .handler = auth_login_get_handler,
+        .user_ctx = NULL};
+    esp_err_t err = httpd_register_uri_handler(server, &login_uri);
+    if (err != ESP_OK) {
+        return err;
+    }
+    httpd_uri_t status_uri = {
+        .uri = "/auth/status",
+        .method = HTTP_GET,
+        .handler = auth_status_get_handler,
+        .user_ctx = NULL};
+    return httpd_register_uri_handler(server, &status_uri);
+}
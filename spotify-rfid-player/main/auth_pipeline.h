@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Where the setup after an OAuth redirect stands
+ */
+typedef enum {
+    AUTH_PIPELINE_IDLE,       /*!< No authorization code received since boot */
+    AUTH_PIPELINE_EXCHANGING, /*!< Trading the code for tokens */
+    AUTH_PIPELINE_LOOKING_UP, /*!< Profile and device lookups in flight */
+    AUTH_PIPELINE_READY,      /*!< Tokens stored and both lookups done */
+    AUTH_PIPELINE_FAILED,     /*!< The token exchange failed, a new authorization is needed */
+} auth_pipeline_state_t;
+
+/**
+ * @brief Progress of the last authorization, for GET /auth/status
+ */
+typedef struct {
+    auth_pipeline_state_t state;
+    int account;               /*!< Account the code was for */
+    esp_err_t exchange_result; /*!< ESP_ERR_NOT_FINISHED until known */
+    esp_err_t profile_result;
+    esp_err_t device_result;   /*!< ESP_ERR_NOT_FOUND if the target device isn't online */
+    int64_t started_us;        /*!< esp_timer time the code arrived */
+    int64_t finished_us;       /*!< esp_timer time it reached READY or FAILED, 0 before */
+} auth_pipeline_status_t;
+
+/**
+ * @brief Start the pipeline tasks
+ */
+esp_err_t auth_pipeline_start(void);
+
+/**
+ * @brief Hand an authorization code to the pipeline and return at once
+ *
+ * The code is exchanged for the account's tokens, then the user profile and
+ * the device list are fetched at the same time on two tasks. A code
+ * submitted while an older one is still waiting replaces it. The status
+ * switches to the new code once the pipeline takes it up, results still
+ * coming in for an older code are dropped.
+ *
+ * @param account Account in the pool the code signs in
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE if the code is too long,
+ *         ESP_ERR_INVALID_ARG for an account outside the pool,
+ *         ESP_ERR_INVALID_STATE if the pipeline isn't started
+ */
+esp_err_t auth_pipeline_submit(int account, const char *auth_code);
+
+/**
+ * @brief Copy the progress of the last authorization
+ */
+void auth_pipeline_get_status(auth_pipeline_status_t *status);
+
+/**
+ * @brief Short name of a state, as used by /auth/status
+ */
+const char *auth_pipeline_state_name(auth_pipeline_state_t state);
+
+/**
+ * @brief Register GET /auth/status and GET /auth/login on the given server
+ *
+ * /auth/login?account=N redirects to the Spotify sign-in for account N, the
+ * default account without the parameter. /auth/status reports the last
+ * authorization and the token state of every account.
+ */
+esp_err_t auth_pipeline_register_handlers(httpd_handle_t server);
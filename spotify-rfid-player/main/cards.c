@@ -0,0 +1,35 @@
+#include <stddef.h>
+#include "cards.h"
+
+// Track lists are sent as a single request, keep them to a dozen or so tracks
+// static const char *const road_trip[] = {
+//     "spotify:track:4cOdK2wGLETKBW3PvgPWqT",
+//     "spotify:track:0VjIjW4GlUZAMYd2vXMi3b",
+//     NULL,
+// };
+
+// Each UID corresponds to a unique Spotify URI, keyed on the first byte of the UID
+static const card_t cards[] = {
+    {0x33, "spotify:album:4SZko61aMnmgvNhfhgTuD3", "Graduation"},
+    {0x93, "spotify:album:18NOKLkZETa4sWwLMIm0UZ", "Utopia"},
+    {0x8B, "spotify:playlist:5W7LO7gT68cTmUefJkrmI2", "Sad Mix"},
+    {0x76, "spotify:playlist:3ULJmafcgqIt9dDngDlufQ", "Clown Mix"},
+    {0xC4, "spotify:playlist:4VEYXB0BHVcRn1xvQh0asU", "Spicy Mix"},
+    {0xB6, "spotify:playlist:2j24pbwBa42NSiAz6PrZ0G", "Shrek"},
+    {0x39, "spotify:playlist:67AIpw122AZCIfHW5R1Lt3", "Oakar's Playlist"},
+    // Add more entries for different UIDs, for example:
+    // {0x5A, "spotify:track:4cOdK2wGLETKBW3PvgPWqT", "Queue a song", CARD_MODE_QUEUE},
+    // {0x6C, NULL, "Road trip", CARD_MODE_TRACK_LIST, road_trip},
+    // Cards of other household members name their account, see /auth/login?account=N:
+    // {0x4D, "spotify:playlist:37i9dQZF1DX6z20IXmBjWI", "Kids Mix", .account = 1},
+};
+
+const card_t *cards_lookup(const uint8_t *uid)
+{
+    for (size_t i = 0; i < sizeof(cards) / sizeof(cards[0]); i++) {
+        if (cards[i].uid0 == uid[0]) {
+            return &cards[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief What a tap on the card does
+ */
+typedef enum {
+    CARD_MODE_PLAY_NOW,   // replace playback with the context in uri
+    CARD_MODE_QUEUE,      // add the track in uri to the play queue
+    CARD_MODE_TRACK_LIST, // replace playback with the tracks in uris, in one request
+} card_mode_t;
+
+/**
+ * @brief Spotify content bound to an RFID card
+ */
+typedef struct {
+    uint8_t uid0;            // first byte of the card UID
+    const char *uri;         // context URI (play now) or track URI (queue)
+    const char *label;       // human readable name for logs and the local API
+    card_mode_t mode;        // defaults to CARD_MODE_PLAY_NOW
+    const char *const *uris; // CARD_MODE_TRACK_LIST: track URIs, NULL terminated
+    uint8_t account;         // household account that plays it, defaults to ACCOUNTS_DEFAULT
+} card_t;
+
+/**
+ * @brief Find the card entry for a UID
+ *
+ * @param uid Card UID, at least one byte
+ * @return The matching entry, or NULL for an unknown card
+ */
+const card_t *cards_lookup(const uint8_t *uid);
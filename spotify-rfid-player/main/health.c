@@ -0,0 +1,266 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include <cJSON.h>
+#include "health.h"
+
+#define TAG "HEALTH"
+
+#define HEALTH_MAX_TASKS    20 // tasks stored per sample, the rest are counted but not stored
+#define HEALTH_TASK_HEADROOM 4 // tasks that may be created between sizing the snapshot and taking it
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_hwm_bytes; // least free stack ever seen for the task
+    uint8_t cpu_percent;      // share of CPU time since the previous sample
+} health_task_sample_t;
+
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t largest_free_block;
+    uint8_t task_count;       // entries in tasks
+    uint8_t task_total;       // tasks running, more than task_count when the list is truncated
+    bool tasks_truncated;
+    health_task_sample_t tasks[HEALTH_MAX_TASKS];
+} health_sample_t;
+
+static health_sample_t history[CONFIG_HEALTH_HISTORY_LEN];
+static size_t history_head = 0;  // next slot to write
+static size_t history_count = 0;
+static SemaphoreHandle_t history_mutex = NULL;
+static int64_t boot_to_ready_us = -1;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+// uxTaskGetSystemState() fills nothing unless every task fits, so this grows with the task count
+static TaskStatus_t *task_status = NULL;
+static UBaseType_t task_capacity = 0;
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// Run time counters from the previous sample, to turn totals into a share per period
+typedef struct {
+    UBaseType_t task_number;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} health_prev_runtime_t;
+
+static health_prev_runtime_t *prev_runtime = NULL; // task_capacity entries
+static UBaseType_t prev_runtime_count = 0;
+static configRUN_TIME_COUNTER_TYPE prev_total_runtime = 0;
+
+static configRUN_TIME_COUNTER_TYPE health_prev_runtime_of(UBaseType_t task_number)
+{
+    for (UBaseType_t i = 0; i < prev_runtime_count; i++) {
+        if (prev_runtime[i].task_number == task_number) {
+            return prev_runtime[i].runtime;
+        }
+    }
+    return 0;
+}
+#endif
+
+static bool health_reserve_tasks(UBaseType_t needed)
+{
+    if (needed <= task_capacity) {
+        return true;
+    }
+    TaskStatus_t *status = realloc(task_status, needed * sizeof(*task_status));
+    if (status == NULL) {
+        return false;
+    }
+    task_status = status;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    health_prev_runtime_t *runtime = realloc(prev_runtime, needed * sizeof(*prev_runtime));
+    if (runtime == NULL) {
+        return false;
+    }
+    prev_runtime = runtime;
+#endif
+    task_capacity = needed;
+    return true;
+}
+#endif
+
+static void health_take_sample(health_sample_t *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    sample->timestamp_us = esp_timer_get_time();
+    sample->free_heap = esp_get_free_heap_size();
+    sample->min_free_heap = esp_get_minimum_free_heap_size();
+    sample->largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    configRUN_TIME_COUNTER_TYPE total_runtime = 0;
+    UBaseType_t running = uxTaskGetNumberOfTasks();
+    health_reserve_tasks(running + HEALTH_TASK_HEADROOM);
+    UBaseType_t count = uxTaskGetSystemState(task_status, task_capacity, &total_runtime);
+    sample->task_total = MIN(running, UINT8_MAX);
+    if (count == 0) {
+        // Out of memory for the snapshot, or tasks were created faster than the headroom
+        ESP_LOGW(TAG, "%u tasks don't fit the snapshot, per-task stats skipped", (unsigned)running);
+        sample->tasks_truncated = true;
+        return;
+    }
+    sample->task_total = MIN(count, UINT8_MAX);
+    sample->task_count = MIN(count, HEALTH_MAX_TASKS);
+    sample->tasks_truncated = count > HEALTH_MAX_TASKS;
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE total_delta = total_runtime - prev_total_runtime;
+#endif
+    for (UBaseType_t i = 0; i < sample->task_count; i++) {
+        health_task_sample_t *task = &sample->tasks[i];
+        strlcpy(task->name, task_status[i].pcTaskName, sizeof(task->name));
+        task->stack_hwm_bytes = task_status[i].usStackHighWaterMark; // IDF stacks are counted in bytes
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        if (total_delta > 0) {
+            configRUN_TIME_COUNTER_TYPE delta = task_status[i].ulRunTimeCounter -
+                                                health_prev_runtime_of(task_status[i].xTaskNumber);
+            task->cpu_percent = (uint8_t)((uint64_t)delta * 100 / total_delta);
+        }
+#endif
+    }
+
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev_runtime[i].task_number = task_status[i].xTaskNumber;
+        prev_runtime[i].runtime = task_status[i].ulRunTimeCounter;
+    }
+    prev_runtime_count = count;
+    prev_total_runtime = total_runtime;
+#endif
+#endif
+}
+
+static void health_task(void *arg)
+{
+    // Sample into a scratch buffer so the mutex is only held for the copy
+    static health_sample_t sample;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        health_take_sample(&sample);
+
+        xSemaphoreTake(history_mutex, portMAX_DELAY);
+        history[history_head] = sample;
+        history_head = (history_head + 1) % CONFIG_HEALTH_HISTORY_LEN;
+        if (history_count < CONFIG_HEALTH_HISTORY_LEN) {
+            history_count++;
+        }
+        xSemaphoreGive(history_mutex);
+
+        ESP_LOGD(TAG, "free %" PRIu32 " min %" PRIu32 " largest %" PRIu32,
+                 sample.free_heap, sample.min_free_heap, sample.largest_free_block);
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_HEALTH_SAMPLE_PERIOD_MS));
+    }
+}
+
+esp_err_t health_get_summary(health_summary_t *summary)
+{
+    if (history_mutex == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    if (history_count > 0) {
+        const health_sample_t *latest = &history[(history_head + CONFIG_HEALTH_HISTORY_LEN - 1) % CONFIG_HEALTH_HISTORY_LEN];
+        summary->free_heap = latest->free_heap;
+        summary->min_free_heap = latest->min_free_heap;
+        summary->largest_free_block = latest->largest_free_block;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(history_mutex);
+    return err;
+}
+
+void health_note_boot_to_ready(int64_t us)
+{
+    // Only the first connection after boot is interesting
+    if (boot_to_ready_us < 0) {
+        boot_to_ready_us = us;
+    }
+}
+
+esp_err_t health_start(void)
+{
+    history_mutex = xSemaphoreCreateMutex();
+    if (history_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(health_task, "health", 3072, NULL, 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// GET /debug/health: latest sample in full, plus the heap history oldest first
+static esp_err_t health_get_handler(httpd_req_t *req)
+{
+    static health_sample_t latest;
+    cJSON *root = cJSON_CreateObject();
+    cJSON *heap_history = cJSON_AddArrayToObject(root, "history");
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    size_t count = history_count;
+    size_t oldest = (history_head + CONFIG_HEALTH_HISTORY_LEN - history_count) % CONFIG_HEALTH_HISTORY_LEN;
+    for (size_t i = 0; i < count; i++) {
+        const health_sample_t *s = &history[(oldest + i) % CONFIG_HEALTH_HISTORY_LEN];
+        cJSON *entry = cJSON_CreateObject();
+        cJSON_AddNumberToObject(entry, "t_ms", (double)(s->timestamp_us / 1000));
+        cJSON_AddNumberToObject(entry, "free", s->free_heap);
+        cJSON_AddNumberToObject(entry, "min_free", s->min_free_heap);
+        cJSON_AddNumberToObject(entry, "largest_block", s->largest_free_block);
+        cJSON_AddItemToArray(heap_history, entry);
+    }
+    if (count > 0) {
+        latest = history[(history_head + CONFIG_HEALTH_HISTORY_LEN - 1) % CONFIG_HEALTH_HISTORY_LEN];
+    }
+    xSemaphoreGive(history_mutex);
+
+    cJSON_AddNumberToObject(root, "period_ms", CONFIG_HEALTH_SAMPLE_PERIOD_MS);
+    cJSON_AddNumberToObject(root, "boot_to_ready_ms", boot_to_ready_us < 0 ? -1 : (double)(boot_to_ready_us / 1000));
+    if (count > 0) {
+        cJSON_AddNumberToObject(root, "free", latest.free_heap);
+        cJSON_AddNumberToObject(root, "min_free", latest.min_free_heap);
+        cJSON_AddNumberToObject(root, "largest_block", latest.largest_free_block);
+        cJSON_AddNumberToObject(root, "task_total", latest.task_total);
+        cJSON_AddBoolToObject(root, "tasks_truncated", latest.tasks_truncated);
+        cJSON *tasks = cJSON_AddArrayToObject(root, "tasks");
+        for (uint8_t i = 0; i < latest.task_count; i++) {
+            cJSON *task = cJSON_CreateObject();
+            cJSON_AddStringToObject(task, "name", latest.tasks[i].name);
+            cJSON_AddNumberToObject(task, "stack_free_min", latest.tasks[i].stack_hwm_bytes);
+            cJSON_AddNumberToObject(task, "cpu", latest.tasks[i].cpu_percent);
+            cJSON_AddItemToArray(tasks, task);
+        }
+    }
+
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (body == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_sendstr(req, body);
+    cJSON_free(body);
+    return err;
+}
+
+esp_err_t health_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t health_uri = {
+        .uri = "/debug/health",
+        .method = HTTP_GET,
+        .handler = health_get_handler,
+        .user_ctx = NULL};
+    return httpd_register_uri_handler(server, &health_uri);
+}
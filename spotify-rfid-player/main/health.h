@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Start the periodic memory and task health sampler
+ *
+ * Every CONFIG_HEALTH_SAMPLE_PERIOD_MS the sampler records per-task stack
+ * high-water marks and CPU share, free and minimum-free heap, and the largest
+ * free block into a ring of CONFIG_HEALTH_HISTORY_LEN samples.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the sampler task could not be created
+ */
+esp_err_t health_start(void);
+
+/**
+ * @brief Heap figures of the latest sample
+ */
+typedef struct {
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t largest_free_block;
+} health_summary_t;
+
+/**
+ * @brief Copy the heap figures of the latest sample
+ *
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND before the first sample
+ */
+esp_err_t health_get_summary(health_summary_t *summary);
+
+/**
+ * @brief Record how long the device took from boot until it got an IP address
+ */
+void health_note_boot_to_ready(int64_t boot_to_ready_us);
+
+/**
+ * @brief Register the GET /debug/health handler on the given server
+ */
+esp_err_t health_register_handlers(httpd_handle_t server);
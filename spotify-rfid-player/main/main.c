@@ -1,100 +1,109 @@
 #include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "esp_system.h"
+#include "esp_random.h"
 #include "esp_netif.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
+#include "nvs.h"
+#include "esp_timer.h"
 #include "esp_http_client.h"
 #include "esp_wifi.h"
+#include "esp_mac.h"
 #include "esp_http_server.h"
 #include "freertos/task.h"
-#include "mbedtls/base64.h"
+#include "freertos/semphr.h"
 #include <inttypes.h> // Include this header for PRId64
 #include <cJSON.h>
 #include "driver/uart.h"
+#include "health.h"
+#include "spotify.h"
+#include "playback.h"
+#include "rest_api.h"
+#include "uid_codec.h"
+#include "power.h"
+#include "trace.h"
+#include "spotify_limiter.h"
+#include "spotify_client.h"
+#include "album_art.h"
+#include "ws_push.h"
+#include "auth_pipeline.h"
+#include "accounts.h"
 
 #define TAG "SPOTIFY_API"
-#define TAG2 "espserial_receiver"
 
 #define UART_NUM UART_NUM_1 // Replace with the appropriate UART number
 #define BUF_SIZE (3072)
+#define RX_LINE_SIZE 64 // longest line kept from the RFID reader, "UID:" and ten hex bytes fit easily
 static QueueHandle_t uart_queue;
 
 
 
-// Placeholder for client ID, client secret, access token, and refresh token
+// Placeholder for client ID and client secret, the tokens of each household account live in accounts.c
 char client_id[] = "INSERT_CLIENT_ID"; //can be stored securely in NVS_FLASH for persistance across reboots
 char client_secret[] = "INSERT_CLIENT_SECRET"; //can be stored securely in NVS_FLASH for persistance across reboots 
-char access_token[252];
-char refresh_token[252];
+static volatile bool auth_task_running = false;
 
 const char *ssid = "INSERT_WIFI_SSID"; //can be stored securely in NVS_FLASH for persistance across reboots
 const char *pass = "INSERT_WIFI_PASS"; //can be stored securely in NVS_FLASH for persistance across reboots
 int8_t retry_num = 0;
+static esp_timer_handle_t reconnect_timer = NULL;
 
-#define AUTH_TASK_STACK_SIZE 4096 // Adjust the size as needed
+static esp_netif_t *sta_netif = NULL;
+static wifi_config_t wifi_config = {0};
+static bool using_cached_ap = false; // connecting straight to the BSSID/channel stored in NVS
 
+#define WIFI_CACHE_NAMESPACE "wifi_cache"
 
-// Global buffer and its current size
-static char *response_buffer = NULL;
-static int response_buffer_len = 0;
+#ifdef CONFIG_EXAMPLE_STATIC_DNS_AUTO
+#define EXAMPLE_MAIN_DNS_SERVER   CONFIG_EXAMPLE_STATIC_GW_ADDR
+#define EXAMPLE_BACKUP_DNS_SERVER "0.0.0.0"
+#else
+#define EXAMPLE_MAIN_DNS_SERVER   CONFIG_EXAMPLE_STATIC_DNS_SERVER_MAIN
+#define EXAMPLE_BACKUP_DNS_SERVER CONFIG_EXAMPLE_STATIC_DNS_SERVER_BACKUP
+#endif
 
-// UID Message
-typedef struct struct_message {
-    uint8_t uid[4]; // Changed struct to only include RFID UID
-} struct_message;
+#define AUTH_TASK_STACK_SIZE 8192 // the authorization request runs a TLS handshake on this task
+#define AUTH_DEADLINE_MS     10000 // the authorization request, DNS to last byte
+#define LOOKUP_DEADLINE_MS   10000 // profile or device list after authorization
+#define LOOKUP_BUFFER_SIZE   4096  // a few devices' worth of /me/player/devices
 
-char saved_device_id[100]; // Assuming the device ID will not exceed this length
-
-esp_err_t handle_http_response(esp_http_client_event_t *evt)
+// Traces the authorization request, the body is counted in *user_data and discarded
+static esp_err_t handle_http_response(esp_http_client_event_t *evt)
 {
-
+    size_t *received = evt->user_data;
     switch (evt->event_id)
     {
         case HTTP_EVENT_ERROR:
-            ESP_LOGE(TAG, "HTTP_EVENT_ERROR: %s", esp_err_to_name(evt->data));
+            TRACE(HTTP_ERROR, (intptr_t)evt->data, 0);
             break;
         case HTTP_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+            TRACE(HTTP_CONNECTED, 0, 0);
             break;
         case HTTP_EVENT_HEADER_SENT:
-            ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
+            TRACE(HTTP_HEADER_SENT, 0, 0);
             break;
         case HTTP_EVENT_ON_HEADER:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+            TRACE(HTTP_HEADER, strlen(evt->header_key), strlen(evt->header_value));
             break;
         case HTTP_EVENT_ON_DATA:
-            // Reallocate the buffer to hold the received data and ensure there's an extra byte for null termination
-            char *new_buffer = realloc(response_buffer, response_buffer_len + evt->data_len + 1);
-            if (new_buffer == NULL) {
-                ESP_LOGE(TAG, "Failed to allocate memory for response");
-                free(response_buffer);
-                response_buffer = NULL;
-                response_buffer_len = 0;
-                return ESP_FAIL;
-            }
-            response_buffer = new_buffer;
-
-            // Append the new data to the buffer
-            memcpy(response_buffer + response_buffer_len, evt->data, evt->data_len);
-            response_buffer_len += evt->data_len;
-            response_buffer[response_buffer_len] = '\0'; // Null-terminate the buffer
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
+            *received += evt->data_len;
+            TRACE(HTTP_DATA, evt->data_len, *received);
             break;
 
         case HTTP_EVENT_ON_FINISH:
-            ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
             int status_code = esp_http_client_get_status_code(evt->client);
-            ESP_LOGI(TAG, "HTTP Status Code: %d", status_code);
+            TRACE(HTTP_FINISH, status_code, *received);
 
             if (status_code >= 200 && status_code < 300) {
                 // Successful response
-                if (esp_http_client_get_content_length(evt->client) != response_buffer_len) {
+                if (esp_http_client_get_content_length(evt->client) != (int64_t)*received) {
                     ESP_LOGW(TAG, "Read less data than expected");
                 }
-                // Handle the response data
-                ESP_LOGI(TAG, "Response: %s", response_buffer);
             } else {
                 // Error response
                 ESP_LOGE(TAG, "HTTP request failed with status code: %d", status_code);
@@ -103,14 +112,7 @@ esp_err_t handle_http_response(esp_http_client_event_t *evt)
             break;
 
         case HTTP_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
-            status_code = esp_http_client_get_status_code(evt->client);
-            ESP_LOGI(TAG, "HTTP Status Code: %d", status_code);
-            if (response_buffer != NULL) {
-                free(response_buffer);
-                response_buffer = NULL;
-                response_buffer_len = 0;
-            }
+            TRACE(HTTP_DISCONNECTED, esp_http_client_get_status_code(evt->client), 0);
             break;
         default:
             break;
@@ -119,45 +121,43 @@ esp_err_t handle_http_response(esp_http_client_event_t *evt)
 }
 
 // Function to get Spotify device ID of a specific device by name
-esp_err_t get_spotify_device_id(const char *access_token, const char* target_device_name) {
-    ESP_LOGI(TAG, "Getting list of Spotify devices for device name: %s", target_device_name);
-
-    const char *devices_url = "https://api.spotify.com/v1/me/player/devices";
-    char auth_header[300];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", access_token);
+esp_err_t get_spotify_device_id(int account, const char* target_device_name) {
+    ESP_LOGI(TAG, "Getting list of Spotify devices of account %d for device name: %s", account, target_device_name);
 
-    esp_http_client_config_t config = {
-        .url = devices_url,
-        .event_handler = handle_http_response,
+    char access_token[ACCOUNTS_TOKEN_SIZE];
+    esp_err_t err = accounts_get_token(account, access_token, sizeof(access_token));
+    if (err != ESP_OK) {
+        return err;
+    }
+    char *body = malloc(LOOKUP_BUFFER_SIZE);
+    if (body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    spotify_response_t resp = {
+        .body = body,
+        .body_size = LOOKUP_BUFFER_SIZE,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    // Set headers
-    esp_http_client_set_header(client, "Authorization", auth_header);
-
-    // Perform the HTTP GET request
-    esp_err_t err = esp_http_client_perform(client);
+    spotify_deadline_t deadline = spotify_deadline_start(LOOKUP_DEADLINE_MS, NULL);
+    err = spotify_client_request(SPOTIFY_PRIORITY_USER, &deadline, HTTP_METHOD_GET,
+                                 "https://api.spotify.com/v1/me/player/devices", access_token, NULL, &resp);
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %lld",
-                 esp_http_client_get_status_code(client),
-                 esp_http_client_get_content_length(client));
-        
+        ESP_LOGI(TAG, "HTTP GET Status = %d, content_length = %u", resp.status_code, (unsigned)resp.body_len);
+
         // Parse the response to find the device ID
-        cJSON *root = cJSON_Parse(response_buffer);
+        cJSON *root = cJSON_ParseWithLength(body, resp.body_len);
         cJSON *devices = cJSON_GetObjectItemCaseSensitive(root, "devices");
         cJSON *device;
         bool device_found = false;
         cJSON_ArrayForEach(device, devices) {
             cJSON *name = cJSON_GetObjectItemCaseSensitive(device, "name");
-            if (strcmp(name->valuestring, target_device_name) == 0) {
+            if (cJSON_IsString(name) && strcmp(name->valuestring, target_device_name) == 0) {
                 // Found the target device
                 cJSON *id = cJSON_GetObjectItemCaseSensitive(device, "id");
-                if (id != NULL) {
+                if (cJSON_IsString(id)) {
                     // Save the device ID for later use
-                    strncpy(saved_device_id, id->valuestring, sizeof(saved_device_id) - 1);
-                    saved_device_id[sizeof(saved_device_id) - 1] = '\0'; // Ensure null-termination
+                    accounts_set_device(account, id->valuestring);
                     device_found = true;
-                    ESP_LOGI(TAG, "Device ID for '%s' saved: %s", name->valuestring, saved_device_id);
+                    ESP_LOGI(TAG, "Device ID for '%s' saved: %s", name->valuestring, id->valuestring);
                     break; // Stop searching as we've found our device
                 }
             }
@@ -166,68 +166,25 @@ esp_err_t get_spotify_device_id(const char *access_token, const char* target_dev
 
         if (!device_found) {
             ESP_LOGW(TAG, "Target device '%s' not found.", target_device_name);
+            err = ESP_ERR_NOT_FOUND;
         }
     } else {
         ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
-    return ESP_OK;
-}
-
-// PUT request
-esp_err_t http_put_request(const char *url, const char *data, const char *auth_header) {
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_PUT,
-        .event_handler = handle_http_response,
-        .timeout_ms = 5000,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    // Set the authorization header
-    esp_http_client_set_header(client, "Authorization", auth_header);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-
-    // Open the connection
-    esp_err_t err = esp_http_client_open(client, strlen(data));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
-        return err;
-    }
-
-    // Write the data for the PUT request
-    int wlen = esp_http_client_write(client, data, strlen(data));
-    if (wlen < 0) {
-        ESP_LOGE(TAG, "Write failed");
-        esp_http_client_cleanup(client);
-        return ESP_FAIL;
-    }
-
-    // Perform the HTTP PUT request
-    esp_err_t perform_err = esp_http_client_perform(client);
-    if (perform_err == ESP_OK) {
-        ESP_LOGI(TAG, "HTTP PUT Status = %d, content_length = %lld",
-                 esp_http_client_get_status_code(client),
-                 esp_http_client_get_content_length(client));
-    } else {
-        ESP_LOGE(TAG, "HTTP PUT request failed: %s", esp_err_to_name(perform_err));
-    }
-
-    // Clean up the client
-    esp_http_client_cleanup(client);
-
-    return perform_err;
+    free(body);
+    return err;
 }
 
-
 // Function to perform HTTP GET request
 esp_err_t http_get_request(const char *url)
 {
+  size_t received = 0;
   esp_http_client_config_t config = {
       .url = url,
       .event_handler = handle_http_response,
+      .user_data = &received,
+      .timeout_ms = AUTH_DEADLINE_MS,
   };
   esp_http_client_handle_t client = esp_http_client_init(&config);
   esp_err_t err = esp_http_client_perform(client);
@@ -239,11 +196,14 @@ esp_err_t http_get_request(const char *url)
   return err;
 }
 
-// Function to request authorization
+// Function to request authorization for the default account, others sign in through /auth/login?account=N
 void request_authorization()
 {
-  char url[415];
-  sprintf(url, "https://accounts.spotify.com/authorize?client_id=%s&response_type=code&redirect_uri=http://192.168.149.88/&show_dialog=true&scope=user-read-private%%20user-read-email%%20user-modify-playback-state%%20user-read-playback-position%%20user-library-read%%20streaming%%20user-read-playback-state%%20user-read-recently-played%%20playlist-read-private", client_id);
+  char url[430];
+  if (accounts_authorize_url(ACCOUNTS_DEFAULT, url, sizeof(url)) != ESP_OK) {
+    ESP_LOGE(TAG, "Authorization URL does not fit");
+    return;
+  }
   ESP_LOGI(TAG, "Authorization URL: %s", url);
   // Perform HTTP GET request to authorization URL
   esp_err_t err = http_get_request(url);
@@ -255,261 +215,102 @@ void request_authorization()
 
 static void request_authorization_task(void *pvParameters)
 {
-  UBaseType_t uxHighWaterMark;
-  uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
-  printf("Stack high water mark for AuthTask is %u\n", uxHighWaterMark);
+  // Only started while no account has a refresh token, the accounts task refreshes the others
   request_authorization();
-  // After the task has done some work, check the remaining stack space.
-  uxHighWaterMark = uxTaskGetStackHighWaterMark(NULL);
-  printf("Stack high water mark for AuthTask is %u\n", uxHighWaterMark);
+  ESP_LOGD(TAG, "Auth task stack high water mark: %u", (unsigned)uxTaskGetStackHighWaterMark(NULL));
+  auth_task_running = false;
   vTaskDelete(NULL);
-  
-}
-
-// Function to perform HTTP POST request for token exchange
-esp_err_t http_post_request(const char *url, const char *post_data, const char *headers)
-{
-  esp_http_client_config_t config = {
-      .url = url,
-      .event_handler = handle_http_response,
-      .method = HTTP_METHOD_POST,
-  };
-  esp_http_client_handle_t client = esp_http_client_init(&config);
-
-  // Set headers
-  if (headers != NULL) {
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-    esp_http_client_set_header(client, "Authorization", headers);
-    // esp_http_client_set_header(client, "Accept-Encoding", "identity");
-  }
-
-  // Set POST data
-  if (post_data != NULL) {
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
-  }
-
-  esp_err_t err = esp_http_client_perform(client);
-  if (err == ESP_OK) {
-    ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %lld",
-         esp_http_client_get_status_code(client),
-         esp_http_client_get_content_length(client));
-  } else {
-    ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-  }
-  
-  esp_http_client_cleanup(client);
-  return err;
 }
 
 /**
- * @brief Get the currently authenticated user's profile information
+ * @brief Get the profile information of an authenticated account
  *
- * @param access_token The access token for authentication
+ * @param account Account whose token is used and whose name is set
  * @return esp_err_t ESP_OK if the request was successful, or an error code otherwise
  */
-esp_err_t get_user_profile(const char *access_token)
+esp_err_t get_user_profile(int account)
 {
-    const char *base_url = "https://api.spotify.com/v1/me";
-
-    char request_url[300];
-    snprintf(request_url, sizeof(request_url), "%s?access_token=%s", base_url, access_token);
-
-    ESP_LOGI(TAG, "Request URL: %s", request_url); // Print the complete request URL
-
-    esp_http_client_config_t config = {
-        .url = base_url,
-        .method = HTTP_METHOD_GET,
-        .event_handler = handle_http_response,
+    char access_token[ACCOUNTS_TOKEN_SIZE];
+    esp_err_t err = accounts_get_token(account, access_token, sizeof(access_token));
+    if (err != ESP_OK) {
+        return err;
+    }
+    char *body = malloc(LOOKUP_BUFFER_SIZE);
+    if (body == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    spotify_response_t resp = {
+        .body = body,
+        .body_size = LOOKUP_BUFFER_SIZE,
     };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    char auth_header[512];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", access_token);
-    esp_http_client_set_header(client, "Authorization", auth_header);
-
-    esp_err_t err = esp_http_client_perform(client);
+    spotify_deadline_t deadline = spotify_deadline_start(LOOKUP_DEADLINE_MS, NULL);
+    err = spotify_client_request(SPOTIFY_PRIORITY_USER, &deadline, HTTP_METHOD_GET,
+                                 "https://api.spotify.com/v1/me", access_token, NULL, &resp);
     if (err == ESP_OK) {
-        while (response_buffer_len == 0) {
-            vTaskDelay(pdMS_TO_TICKS(10));
-        }
-
-        cJSON *root = cJSON_ParseWithLength(response_buffer, response_buffer_len);
+        cJSON *root = cJSON_ParseWithLength(body, resp.body_len);
         if (root == NULL) {
             ESP_LOGE(TAG, "Failed to parse JSON response");
-            free(response_buffer);
-            response_buffer = NULL;
-            response_buffer_len = 0;
-            esp_http_client_cleanup(client);
+            free(body);
             return ESP_FAIL;
         }
 
         cJSON *display_name = cJSON_GetObjectItemCaseSensitive(root, "display_name");
         if (cJSON_IsString(display_name)) {
-            ESP_LOGI(TAG, "User display name: %s", display_name->valuestring);
+            ESP_LOGI(TAG, "User display name of account %d: %s", account, display_name->valuestring);
+            accounts_set_name(account, display_name->valuestring);
         }
 
         cJSON_Delete(root);
-        free(response_buffer);
-        response_buffer = NULL;
-        response_buffer_len = 0;
     } else {
         ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
+    free(body);
     return err;
 }
 
-static const char *TAG3 = "SPOTIFY_PLAY";
-
-#define SPOTIFY_API_BASE_URL "https://api.spotify.com/v1/me/player/play"
-
-esp_err_t play_spotify_album(const char *access_token, const char *device_id, const char *album_uri) {
-    esp_http_client_config_t config = {
-        .url = SPOTIFY_API_BASE_URL,
-        .method = HTTP_METHOD_PUT,
-        .event_handler = NULL,
-        .user_data = NULL,
-        .timeout_ms = 10000,  // Adjust the timeout value as needed
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == NULL) {
-        ESP_LOGE(TAG3, "Failed to initialize HTTP client");
-        return ESP_FAIL;
-    }
-    char auth_header[512];
-    // Set the request headers
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", access_token);
-    esp_http_client_set_header(client, "Authorization", auth_header);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-
-    // Prepare the request body
-    char request_body[256];
-    snprintf(request_body, sizeof(request_body), "{\"context_uri\":\"%s\"}", album_uri);
-
-    // Set the request body
-    esp_http_client_set_post_field(client, request_body, strlen(request_body));
-
-    // Construct the complete URL with the query parameter
-    char url[128];
-    snprintf(url, sizeof(url), "%s?device_id=%s", SPOTIFY_API_BASE_URL, device_id);
-
-    // Set the URL
-    esp_http_client_set_url(client, url);
-    // Print the complete PUT request for debugging
-    ESP_LOGI(TAG3, "PUT Request: %s %s", url, request_body);
-
-    // Send the PUT request
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        if (status_code == 204) {
-            ESP_LOGI(TAG3, "Successfully played Spotify album: %s", album_uri);
-        } else {
-            ESP_LOGE(TAG3, "Failed to play Spotify album, status code: %d", status_code);
-            // Print the HTTP response
-            char response_buffer[2048];
-            int response_len = esp_http_client_read_response(client, response_buffer, sizeof(response_buffer));
-            if (response_len > 0) {
-                response_buffer[response_len] = '\0';  // Null-terminate the buffer
-                ESP_LOGE(TAG3, "HTTP Response: %s", response_buffer);
-} else {
-    ESP_LOGE(TAG3, "Failed to read HTTP response");
-}
-
-        
+// One complete line from the RFID reader, without its newline
+static void rx_handle_line(const char *line, size_t len)
+{
+    uint8_t uid[UID_CODEC_MAX_LEN]; // Buffer to store the received UID
+    size_t uid_len = uid_parse_line(line, len, uid, sizeof(uid));
+    if (uid_len > 0) {
+        power_note_tap();
+        // Cards are keyed on the first four bytes, shorter UIDs are zero padded
+        if (uid_len < PLAYBACK_UID_LEN) {
+            memset(uid + uid_len, 0, PLAYBACK_UID_LEN - uid_len);
         }
-    } else {
-        ESP_LOGE(TAG3, "Failed to perform HTTP request: %s", esp_err_to_name(err));
+        TRACE(TAP_UART, TRACE_UID32(uid), uid_len);
+        playback_submit_uid(uid); // Hand the tap to the playback worker
     }
-
-    // Clean up
-    esp_http_client_cleanup(client);
-
-    return err;
-}
-
-
-// ESP-serial functions
-void play_spotify_content_by_uid(const uint8_t *uid) {
-    ESP_LOGI(TAG2, "First byte of UID: 0x%02X", uid[0]);
-    // Assuming each UID corresponds to a unique Spotify URI 
-    // simple switch case based on the first byte of the UID
-    switch(uid[0]) {
-        case 0x33:
-            play_spotify_album(access_token, saved_device_id, "spotify:album:4SZko61aMnmgvNhfhgTuD3");//graduation
-            ESP_LOGI(TAG2, "Free heap size: %lu bytes", esp_get_free_heap_size());
-            // get_user_profile(access_token);
-            break;
-        case 0x93:
-            play_spotify_album(access_token, saved_device_id, "spotify:album:18NOKLkZETa4sWwLMIm0UZ"); //Utopia
-            break;
-        case  0x8B:
-            play_spotify_album(access_token, saved_device_id, "spotify:playlist:5W7LO7gT68cTmUefJkrmI2"); //Sad Mix
-            break;
-        case  0x76:
-            play_spotify_album(access_token, saved_device_id, "spotify:playlist:3ULJmafcgqIt9dDngDlufQ"); //Clown Mix
-            break;
-        case  0xC4:
-            play_spotify_album(access_token, saved_device_id, "spotify:playlist:4VEYXB0BHVcRn1xvQh0asU"); //Spicy mix
-            break;
-        case  0xB6:
-            play_spotify_album(access_token, saved_device_id, "spotify:playlist:2j24pbwBa42NSiAz6PrZ0G"); //Shrek
-            break;
-        case  0x39:
-            play_spotify_album(access_token, saved_device_id, "spotify:playlist:67AIpw122AZCIfHW5R1Lt3"); //Oakar's Playlist
-            break;
-        // Add more cases for different UIDs
-        default:
-            ESP_LOGI(TAG2, "Unknown UID, cannot play Spotify content");
-            break;
-    }
-}
-
-
-
-void print_uid(const uint8_t *uid) {
-    ESP_LOGI(TAG2, "Received UID: %02X %02X %02X %02X", uid[0], uid[1], uid[2], uid[3]);
 }
 
 static void rx_task(void *arg) {
     uint8_t data[BUF_SIZE];
     int length = 0;
     uart_event_t event;
-    static uint8_t uid[5] = {0}; // Buffer to store the received UID
-    static uint8_t uid_index = 0;
+    // A line can arrive split over several reads, it is only parsed once its newline is in
+    char line[RX_LINE_SIZE];
+    size_t line_len = 0;
+    bool line_overflow = false; // the current line outgrew the buffer, drop it up to its newline
 
     for (;;) {
         if (xQueueReceive(uart_queue, (void *)&event, portMAX_DELAY)) {
             switch (event.type) {
                 case UART_DATA:
-                    length = uart_read_bytes(UART_NUM, data, event.size, portMAX_DELAY);
-                    data[length] = 0; // Null-terminate the received data
-
-                    // Process the received data to extract the UID
-                    uint8_t *ptr = (uint8_t *)strstr((char *)data, "UID:");
-                    if (ptr != NULL) {
-                        ptr += 4; // Skip past "UID:"
-                        uid_index = 0;
-                        while (*ptr) {
-                            if (isspace(*ptr)) {
-                                ptr++; // Skip whitespace characters
-                            } else if (isxdigit(*ptr)) {
-                                char hex_byte[3] = {ptr[0], ptr[1], '\0'};
-                                uid[uid_index++] = (uint8_t)strtoul(hex_byte, NULL, 16);
-                                ptr += 3; // Skip past the hex byte and the space
-                            } else {
-                                break; // Stop processing if an unexpected character is encountered
-                            }
-                            if (uid_index >= sizeof(uid)) {
-                                ESP_LOGW(TAG2, "UID buffer overflow");
-                                break;
+                    length = uart_read_bytes(UART_NUM, data, MIN(event.size, sizeof(data)), portMAX_DELAY);
+                    for (int i = 0; i < length; i++) {
+                        if (data[i] == '\n') {
+                            if (!line_overflow) {
+                                rx_handle_line(line, line_len);
                             }
+                            line_len = 0;
+                            line_overflow = false;
+                        } else if (line_len < sizeof(line)) {
+                            line[line_len++] = (char)data[i];
+                        } else {
+                            line_overflow = true;
                         }
-                        uid[uid_index] = 0; // Null-terminate the UID
-                        print_uid(uid); // Print the UID for debugging
-                        play_spotify_content_by_uid(uid); // Play Spotify content based on UID
                     }
                     break;
                 default:
@@ -519,137 +320,185 @@ static void rx_task(void *arg) {
     }
 }
 
-// Function to extract tokens from JSON response
-static esp_err_t extract_tokens(const char *json_response, char *access_token, size_t access_token_size, char *refresh_token, size_t refresh_token_size) {
-    ESP_LOGI(TAG, "JSON Response: %s", json_response);
-    cJSON *json = cJSON_Parse(json_response);
-    if (json == NULL) {
-        const char *error_ptr = cJSON_GetErrorPtr();
-        if (error_ptr != NULL) {
-            ESP_LOGE(TAG, "JSON parse error: %s", error_ptr);
-        } else {
-            ESP_LOGE(TAG, "JSON parse error but error pointer is null");
-        }
-        return ESP_FAIL;
-    }
-
-    const cJSON *access_token_json = cJSON_GetObjectItemCaseSensitive(json, "access_token");
-    const cJSON *refresh_token_json = cJSON_GetObjectItemCaseSensitive(json, "refresh_token");
-
-    if (access_token_json && cJSON_IsString(access_token_json) && (access_token_json->valuestring != NULL)) {
-        strncpy(access_token, access_token_json->valuestring, access_token_size - 1);
-        access_token[access_token_size - 1] = '\0'; // Ensure null-termination
-    } else {
-        ESP_LOGE(TAG, "Access token not found or is not a string in JSON response");
-        cJSON_Delete(json);
-        return ESP_FAIL;
-    }
-
-    // Check if refresh_token is required by the caller (refresh_token_size > 0)
-    if (refresh_token_size > 0) {
-        if (refresh_token_json && cJSON_IsString(refresh_token_json) && (refresh_token_json->valuestring != NULL)) {
-            strncpy(refresh_token, refresh_token_json->valuestring, refresh_token_size - 1);
-            refresh_token[refresh_token_size - 1] = '\0'; // Ensure null-termination
-        } else {
-            ESP_LOGW(TAG, "Refresh token not found or is not a string in JSON response");
-            // Not failing the function here as refresh token might be optional
-        }
-    }
-
-    cJSON_Delete(json);
-    return ESP_OK;
+// Load the BSSID and channel of the last AP we associated with
+static bool wifi_cache_load(uint8_t bssid[6], uint8_t *channel)
+{
+  nvs_handle_t nvs;
+  if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+    return false;
+  }
+  size_t len = 6;
+  bool found = nvs_get_blob(nvs, "bssid", bssid, &len) == ESP_OK && len == 6 &&
+               nvs_get_u8(nvs, "channel", channel) == ESP_OK && *channel != 0;
+  nvs_close(nvs);
+  return found;
 }
 
-esp_err_t exchange_auth_code_for_tokens(const char *auth_code)
+// Only touch flash when the AP actually changed
+static void wifi_cache_store(const uint8_t bssid[6], uint8_t channel)
 {
-    esp_http_client_config_t config = {
-        .url = "https://accounts.spotify.com/api/token",
-        .method = HTTP_METHOD_POST,
-        .event_handler = handle_http_response,
-    };
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-
-    // Prepare the POST data
-    char post_data[670];
-    int post_data_len = snprintf(post_data, sizeof(post_data),
-                                 "grant_type=authorization_code&code=%s&redirect_uri=%s&client_id=%s&client_secret=%s",
-                                 auth_code, "http://192.168.149.88/", client_id, client_secret);
-
-    if (post_data_len >= sizeof(post_data) - 1) {
-        ESP_LOGE(TAG, "Post data was truncated");
-        esp_http_client_cleanup(client);
-        return ESP_ERR_NO_MEM;
-    }
-
-    esp_http_client_set_post_field(client, post_data, post_data_len);
-    esp_http_client_set_header(client, "Content-Type", "application/x-www-form-urlencoded");
-
-    // Perform the HTTP POST request
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        // Wait for the complete response to be received
-        while (response_buffer_len == 0) {
-            vTaskDelay(pdMS_TO_TICKS(10)); // Delay for 10 milliseconds
-        }
+  uint8_t cached_bssid[6];
+  uint8_t cached_channel;
+  if (wifi_cache_load(cached_bssid, &cached_channel) && cached_channel == channel &&
+      memcmp(cached_bssid, bssid, 6) == 0) {
+    return;
+  }
+  nvs_handle_t nvs;
+  if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+    return;
+  }
+  if (nvs_set_blob(nvs, "bssid", bssid, 6) == ESP_OK && nvs_set_u8(nvs, "channel", channel) == ESP_OK) {
+    nvs_commit(nvs);
+    ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d", MAC2STR(bssid), channel);
+  }
+  nvs_close(nvs);
+}
 
-        // Extract tokens from the response
-        err = extract_tokens(response_buffer, access_token, sizeof(access_token), refresh_token, sizeof(refresh_token));
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to extract tokens from the response");
-        } else {
-            ESP_LOGI(TAG, "Access token: %s", access_token);
-            ESP_LOGI(TAG, "Refresh token: %s", refresh_token);
-        }
+static void wifi_cache_clear(void)
+{
+  nvs_handle_t nvs;
+  if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+    nvs_erase_key(nvs, "bssid");
+    nvs_erase_key(nvs, "channel");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+  }
+}
 
-        // Free the response buffer
-        free(response_buffer);
-        response_buffer = NULL;
-        response_buffer_len = 0;
-    } else {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
-    }
+#if CONFIG_EXAMPLE_STATIC_IP_ENABLE
+static void set_dns_server(esp_netif_t *netif, uint32_t addr, esp_netif_dns_type_t type)
+{
+  if (addr != 0 && addr != UINT32_MAX) {
+    esp_netif_dns_info_t dns = {0};
+    dns.ip.u_addr.ip4.addr = addr;
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    ESP_ERROR_CHECK(esp_netif_set_dns_info(netif, type, &dns));
+  }
+}
 
-    esp_http_client_cleanup(client);
-    return err;
+// Skip DHCP and use the addresses from menuconfig
+static void set_static_ip(esp_netif_t *netif)
+{
+  esp_err_t err = esp_netif_dhcpc_stop(netif);
+  if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+    ESP_LOGE(TAG, "Failed to stop dhcp client");
+    return;
+  }
+  esp_netif_ip_info_t ip = {0};
+  ip.ip.addr = esp_ip4addr_aton(CONFIG_EXAMPLE_STATIC_IP_ADDR);
+  ip.netmask.addr = esp_ip4addr_aton(CONFIG_EXAMPLE_STATIC_NETMASK_ADDR);
+  ip.gw.addr = esp_ip4addr_aton(CONFIG_EXAMPLE_STATIC_GW_ADDR);
+  if (esp_netif_set_ip_info(netif, &ip) != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to set ip info");
+    return;
+  }
+  ESP_LOGI(TAG, "Static ip: %s, netmask: %s, gw: %s", CONFIG_EXAMPLE_STATIC_IP_ADDR,
+           CONFIG_EXAMPLE_STATIC_NETMASK_ADDR, CONFIG_EXAMPLE_STATIC_GW_ADDR);
+  set_dns_server(netif, esp_ip4addr_aton(EXAMPLE_MAIN_DNS_SERVER), ESP_NETIF_DNS_MAIN);
+  set_dns_server(netif, esp_ip4addr_aton(EXAMPLE_BACKUP_DNS_SERVER), ESP_NETIF_DNS_BACKUP);
 }
+#endif
 
 // WiFi event handler
 static void wifi_event_handler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
-  if (event_id == WIFI_EVENT_STA_START)
+  if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
   {
     printf("WIFI CONNECTING....\n");
   }
-  else if (event_id == WIFI_EVENT_STA_CONNECTED)
+  else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
   {
     printf("WiFi CONNECTED\n");
+    const wifi_event_sta_connected_t *connected = event_data;
+#if CONFIG_EXAMPLE_WIFI_FAST_CONNECT
+    wifi_cache_store(connected->bssid, connected->channel);
+#endif
+#if CONFIG_EXAMPLE_STATIC_IP_ENABLE
+    set_static_ip(sta_netif);
+#endif
+    (void)connected;
   }
-  else if (event_id == WIFI_EVENT_STA_DISCONNECTED)
+  else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
   {
     printf("WiFi lost connection\n");
-    if (retry_num < 5)
+    const wifi_event_sta_disconnected_t *disconnected = event_data;
+    if (using_cached_ap && disconnected->reason == WIFI_REASON_NO_AP_FOUND)
     {
+      // The cached AP is gone or moved channel, forget it and scan everything
+      ESP_LOGW(TAG, "Cached AP not found, falling back to a full scan");
+      using_cached_ap = false;
+      wifi_cache_clear();
+      wifi_config.sta.bssid_set = false;
+      wifi_config.sta.channel = 0;
+      wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+      esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
       esp_wifi_connect();
+      return;
+    }
+    playback_set_online(false);
+    accounts_set_online(false);
+
+    // Keep trying forever, backing off exponentially with jitter so a dead AP isn't hammered
+    int shift = retry_num < 10 ? retry_num : 10;
+    // Shifted in 64 bits and clamped, so no start value can wrap the delay around to something short
+    uint64_t backoff_ms = (uint64_t)CONFIG_EXAMPLE_RECONNECT_MIN_MS << shift;
+    uint32_t delay_ms = backoff_ms > CONFIG_EXAMPLE_RECONNECT_MAX_MS ? CONFIG_EXAMPLE_RECONNECT_MAX_MS : (uint32_t)backoff_ms;
+    delay_ms += esp_random() % (delay_ms / 4 + 1);
+    if (retry_num < INT8_MAX) {
       retry_num++;
-      printf("Retrying to Connect...\n");
+    }
+    if (!esp_timer_is_active(reconnect_timer)) {
+      esp_timer_start_once(reconnect_timer, delay_ms * 1000ULL);
+      printf("Retrying to Connect in %" PRIu32 " ms...\n", delay_ms);
     }
   }
-  else if (event_id == IP_EVENT_STA_GOT_IP)
+  else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
   {
     printf("Wifi got IP...\n\n");
-    // Create a task for requesting authorization to avoid stack overflow
-    xTaskCreate(request_authorization_task, "auth_task", AUTH_TASK_STACK_SIZE, NULL, 5, NULL);
-    
+    // Later IPs come from reconnects, the time since boot says nothing about startup then
+    static bool network_ready_seen = false;
+    if (!network_ready_seen) {
+      network_ready_seen = true;
+      int64_t boot_to_ready_us = esp_timer_get_time();
+      ESP_LOGI(TAG, "Boot to network ready: %" PRId64 " ms (%s)", boot_to_ready_us / 1000,
+               using_cached_ap ? "cached AP" : "full scan");
+      health_note_boot_to_ready(boot_to_ready_us);
+    }
+    retry_num = 0;
+    playback_set_online(true);
+    accounts_set_online(true); // refreshes whatever expired while we were away
+
+    // Stored accounts refresh on their own, only authorize when there are none
+    if (accounts_any_authorized()) {
+      ESP_LOGI(TAG, "Accounts already authorized, skipping authorization");
+    } else if (!auth_task_running) {
+      auth_task_running = true;
+      // Create a task for requesting authorization to avoid stack overflow
+      if (xTaskCreate(request_authorization_task, "auth_task", AUTH_TASK_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+        auth_task_running = false;
+      }
+    }
   }
 }
 
+static void reconnect_timer_cb(void *arg)
+{
+  esp_wifi_connect();
+}
+
 // Function to initialize WiFi connection
 void wifi_connection()
 {
   // Initialize Wi-Fi
   ESP_ERROR_CHECK(esp_netif_init());
   ESP_ERROR_CHECK(esp_event_loop_create_default());
-  esp_netif_create_default_wifi_sta();
+  sta_netif = esp_netif_create_default_wifi_sta();
+
+  const esp_timer_create_args_t reconnect_timer_args = {
+      .callback = reconnect_timer_cb,
+      .name = "wifi_reconnect",
+  };
+  ESP_ERROR_CHECK(esp_timer_create(&reconnect_timer_args, &reconnect_timer));
 
   // Initialize Wi-Fi configuration
   wifi_init_config_t wifi_init_config = WIFI_INIT_CONFIG_DEFAULT();
@@ -660,14 +509,30 @@ void wifi_connection()
   ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, NULL));
 
   // Set Wi-Fi configuration
-  wifi_config_t wifi_config = {0}; // Zero-initialize the config struct
   strcpy((char *)wifi_config.sta.ssid, ssid);
   strcpy((char *)wifi_config.sta.password, pass);
 
+#if CONFIG_EXAMPLE_WIFI_FAST_CONNECT
+  // Go straight to the last known AP instead of scanning every channel
+  uint8_t channel;
+  if (wifi_cache_load(wifi_config.sta.bssid, &channel))
+  {
+    wifi_config.sta.bssid_set = true;
+    wifi_config.sta.channel = channel;
+    wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    using_cached_ap = true;
+    ESP_LOGI(TAG, "Fast connect to " MACSTR " on channel %d", MAC2STR(wifi_config.sta.bssid), channel);
+  }
+#endif
+
+  // Wake for every Nth beacon only; requests we send wake the radio right away
+  wifi_config.sta.listen_interval = CONFIG_EXAMPLE_WIFI_LISTEN_INTERVAL;
+
   // Start Wi-Fi connection
   ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
   ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
   ESP_ERROR_CHECK(esp_wifi_start());
+  ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MAX_MODEM));
   ESP_ERROR_CHECK(esp_wifi_connect());
   printf("Wi-Fi connection initiated\n");
 }
@@ -695,31 +560,25 @@ esp_err_t redirect_handler(httpd_req_t *req)
     // Get the query string
     if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK)
     {
-      ESP_LOGI("redirect_handler", "Query string: %s", buf);
       // Now parse the URI to extract the "code" query parameter
       char param[512]; // Buffer to store the value of the "code" parameter
       if (httpd_query_key_value(buf, "code", param, sizeof(param)) == ESP_OK)
       {
-        ESP_LOGI("redirect_handler", "Received code: %s", param);
-        // Code to handle the received 'code' parameter
-        // exchange_auth_code_for_tokens(param);
-        esp_err_t err = exchange_auth_code_for_tokens(param);
-        if (err == ESP_OK) {
-           
-            // Access token successfully obtained
-            err = get_user_profile(access_token);
-  
-            err = get_spotify_device_id(access_token, "Akhil’s Laptop");
-            // err = play_spotify_album(access_token, "26ddd1d634a07ce6e730676e4bbfe122f489b1e0", "spotify:album:06mXfvDsRZNfnsGZvX2zpb");
-            // err = play_spotify_track(access_token,"26ddd1d634a07ce6e730676e4bbfe122f489b1e0","spotify:track:58xpZwxUpgrnJMTEmvkZMP");
-            // err = get_currently_playing(access_token);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to get user profile");
-                ESP_LOGE(TAG, "Failed to get user devices");
-                ESP_LOGE(TAG3, "Failed to play Spotify album");
-            }
+        // The state parameter carries the account the code is for, old links without it mean the default one
+        char state[8];
+        int account = ACCOUNTS_DEFAULT;
+        if (httpd_query_key_value(buf, "state", state, sizeof(state)) == ESP_OK) {
+          account = atoi(state);
+        }
+        ESP_LOGI("redirect_handler", "Received authorization code for account %d", account);
+        // The token exchange and lookups take several HTTPS round trips, don't hold the server task for them
+        esp_err_t err = auth_pipeline_submit(account, param);
+        memset(param, 0, sizeof(param));
+        if (err != ESP_OK) {
+          ESP_LOGE("redirect_handler", "Authorization code not accepted: %s", esp_err_to_name(err));
+          free(buf);
+          return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Authorization could not be started");
         }
-        
       }
       else
       {
@@ -743,8 +602,8 @@ esp_err_t redirect_handler(httpd_req_t *req)
     return ESP_FAIL;
   }
 
-  // Send response to the client
-  const char *resp_str = "Authorization received";
+  // Send response to the client, the setup finishes in the background
+  const char *resp_str = "Authorization received. Setup progress: /auth/status";
   httpd_resp_send(req, resp_str, strlen(resp_str));
 
   return ESP_OK;
@@ -758,6 +617,7 @@ httpd_handle_t start_webserver(void)
   httpd_handle_t server = NULL;
   httpd_config_t config = HTTPD_DEFAULT_CONFIG();
   config.stack_size = 8192; // Set the stack size of the server task
+  config.max_uri_handlers = 16;
 
   // Start the httpd server
   if (httpd_start(&server, &config) == ESP_OK)
@@ -769,6 +629,19 @@ httpd_handle_t start_webserver(void)
         .handler = redirect_handler,
         .user_ctx = NULL};
     httpd_register_uri_handler(server, &redirect_uri);
+
+    auth_pipeline_register_handlers(server);
+
+    // Runtime memory and task statistics
+    health_register_handlers(server);
+    trace_register_handlers(server);
+    power_register_handlers(server);
+
+    // Local control API for home automation
+    rest_api_register_handlers(server);
+
+    // Live state for dashboards, without polling
+    ws_push_register_handlers(server);
   }
 
   return server;
@@ -783,14 +656,27 @@ void stop_webserver(httpd_handle_t server)
 void app_main(void)
 {
   // Initialize NVS
-  // Set log level for all components to verbose
-  esp_log_level_set("*", ESP_LOG_VERBOSE);
+  // Hot-path events go to the trace ring (GET /debug/trace), the console only gets INFO and up
+  esp_log_level_set("*", ESP_LOG_INFO);
   esp_log_level_set("wifi", ESP_LOG_WARN);
   ESP_ERROR_CHECK(nvs_flash_init());
 
+  // Start sampling heap and task stacks before anything else allocates
+  ESP_ERROR_CHECK(health_start());
+
+  // Scale the clock down and sleep between taps
+  ESP_ERROR_CHECK(power_init());
+
+  // Tokens of every household account, refreshed ahead of their expiry
+  ESP_ERROR_CHECK(accounts_start());
+  ESP_ERROR_CHECK(auth_pipeline_start());
+
   // Start WiFi connection
   wifi_connection();
 
+  // Cover art palettes go out to the LED nodes over ESP-NOW
+  ESP_ERROR_CHECK(album_art_start());
+
   uart_config_t uart_config = {
         .baud_rate = 115200,
         .data_bits = UART_DATA_8_BITS,
@@ -802,6 +688,11 @@ void app_main(void)
     uart_set_pin(UART_NUM, 4, 5, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE); // Replace with the appropriate RX and TX pins
 
     uart_driver_install(UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 20, &uart_queue, 0);
+    ESP_ERROR_CHECK(power_enable_uart_wakeup(UART_NUM));
+
+    // Spotify calls run on the playback worker so the UART task never blocks on HTTPS
+    ESP_ERROR_CHECK(spotify_limiter_init());
+    ESP_ERROR_CHECK(playback_start());
 
     xTaskCreate(rx_task, "uart_rx_task", 16384, NULL, configMAX_PRIORITIES - 1, NULL);
 
@@ -0,0 +1,525 @@
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cJSON.h>
+#include "cards.h"
+#include "accounts.h"
+#include "spotify_client.h"
+#include "tap_buffer.h"
+#include "playback.h"
+#include "power.h"
+#include "trace.h"
+#include "album_art.h"
+
+#define TAG "SPOTIFY_PLAY"
+
+#define PLAYBACK_QUEUE_LEN        8
+#define PLAYBACK_TASK_STACK_SIZE  8192 // TLS handshakes run on this task
+#define PLAYBACK_POLL_BUFFER_SIZE 8192 // /me/player without available_markets fits comfortably
+#define PLAYBACK_PENDING_MAX_AGE_US (10 * 60 * 1000000LL) // taps older than this are stale after an outage
+#define PLAYBACK_BATCH_MAX        8    // queue taps merged into one batch
+#define PLAYBACK_BODY_SIZE        1024 // {"uris":[...]} for a batch or a track list card
+#define PLAYBACK_POLL_DEADLINE_MS 5000 // a state poll that takes longer is stale anyway
+
+// A newer play replaces everything queued before it, only the last volume or pause matters
+#define PLAYBACK_SUPERSEDE_MASK (1UL << PLAYBACK_CMD_PLAY_UID)
+#define PLAYBACK_COALESCE_MASK  ((1UL << PLAYBACK_CMD_VOLUME) | (1UL << PLAYBACK_CMD_PAUSE))
+// Buffer kind of a card tap that adds to what is playing, each one is replayed
+#define PLAYBACK_KIND_ADD_UID   (PLAYBACK_CMD_REPLAY + 1)
+
+_Static_assert(sizeof(playback_cmd_t) <= TAP_BUFFER_PAYLOAD_LEN, "playback_cmd_t must fit a tap buffer payload");
+
+#define SPOTIFY_PLAYER_URL "https://api.spotify.com/v1/me/player"
+
+static QueueHandle_t playback_queue = NULL;
+static SemaphoreHandle_t state_mutex = NULL;
+static playback_state_t state = {
+    .volume_percent = -1,
+    .account = ACCOUNTS_DEFAULT,
+};
+static tap_buffer_t pending; // only touched by the worker task
+static volatile bool online = false;
+static volatile uint32_t play_generation = 0; // bumped under state_mutex by every play that replaces what is playing
+
+// Queue taps collected during CONFIG_PLAYBACK_QUEUE_BATCH_MS, also worker-only
+static const card_t *batch[PLAYBACK_BATCH_MAX];
+static size_t batch_len = 0;
+static int64_t batch_deadline_us = 0;
+static int batch_account = ACCOUNTS_DEFAULT; // every tap in a batch belongs to one account
+static char request_body[PLAYBACK_BODY_SIZE];
+
+// Credentials of the account being served, reloaded from the pool before each request, worker-only
+static int active_account = ACCOUNTS_DEFAULT; // set by the last card played
+static char bearer[ACCOUNTS_TOKEN_SIZE];
+static char device_id[ACCOUNTS_DEVICE_ID_SIZE];
+
+void playback_get_state(playback_state_t *out)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    *out = state;
+    xSemaphoreGive(state_mutex);
+}
+
+// Queue cards add to what is playing, every other card replaces it
+static bool playback_replaces(const playback_cmd_t *cmd)
+{
+    if (cmd->type != PLAYBACK_CMD_PLAY_UID) {
+        return false;
+    }
+    const card_t *card = cards_lookup(cmd->uid);
+    return card != NULL && card->mode != CARD_MODE_QUEUE;
+}
+
+esp_err_t playback_submit(const playback_cmd_t *submitted)
+{
+    if (playback_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    playback_cmd_t stamped = *submitted;
+    const playback_cmd_t *cmd = &stamped;
+    // The budget runs from the tap, time spent in the queue behind a slow request counts against it
+    stamped.expires_us = esp_timer_get_time() + CONFIG_SPOTIFY_TAP_DEADLINE_MS * 1000LL;
+    bool supersedes = playback_replaces(cmd);
+    // The UART task and several server tasks submit, bump and read the counter as one step
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (supersedes) {
+        play_generation++;
+    }
+    stamped.generation = play_generation;
+    xSemaphoreGive(state_mutex);
+    if (xQueueSend(playback_queue, cmd, 0) == pdTRUE) {
+        return ESP_OK;
+    }
+    // Full: the newest command matters most, make room by dropping the oldest
+    playback_cmd_t dropped;
+    if (xQueueReceive(playback_queue, &dropped, 0) == pdTRUE) {
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        state.commands_dropped++;
+        xSemaphoreGive(state_mutex);
+        ESP_LOGW(TAG, "Playback queue full, dropped command %d", dropped.type);
+    }
+    return xQueueSend(playback_queue, cmd, 0) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t playback_submit_uid(const uint8_t *uid)
+{
+    playback_cmd_t cmd = {
+        .type = PLAYBACK_CMD_PLAY_UID,
+    };
+    memcpy(cmd.uid, uid, PLAYBACK_UID_LEN);
+    return playback_submit(&cmd);
+}
+
+// Load an account's token and device, the token is normally warm and this is only a copy
+static esp_err_t playback_use_account(int account)
+{
+    esp_err_t err = accounts_get_token(account, bearer, sizeof(bearer));
+    accounts_get_device(account, device_id, sizeof(device_id));
+    return err;
+}
+
+// Append the target device to a player URL, or leave it to Spotify's active device
+static void playback_build_url(char *url, size_t url_size, const char *path, const char *query)
+{
+    int len = snprintf(url, url_size, "%s%s", SPOTIFY_PLAYER_URL, path);
+    char sep = '?';
+    if (query != NULL && len < url_size) {
+        len += snprintf(url + len, url_size - len, "?%s", query);
+        sep = '&';
+    }
+    if (device_id[0] != '\0' && len < url_size) {
+        snprintf(url + len, url_size - len, "%cdevice_id=%s", sep, device_id);
+    }
+}
+
+static esp_err_t playback_request(int account, const spotify_deadline_t *deadline, esp_http_client_method_t method,
+                                  const char *path, const char *query, const char *body)
+{
+    spotify_response_t resp = {0};
+    esp_err_t err = playback_use_account(account);
+    if (err == ESP_OK) {
+        char url[256];
+        playback_build_url(url, sizeof(url), path, query);
+        ESP_LOGD(TAG, "%s %s", method == HTTP_METHOD_POST ? "POST" : "PUT", url);
+        err = spotify_client_request(SPOTIFY_PRIORITY_USER, deadline, method, url, bearer, body, &resp);
+    }
+    if (err == ESP_OK && (resp.status_code < 200 || resp.status_code >= 300)) {
+        ESP_LOGE(TAG, "Request failed with status code: %d", resp.status_code);
+        err = ESP_FAIL;
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    state.last_status = resp.status_code;
+    state.last_result = err;
+    state.commands_done++;
+    xSemaphoreGive(state_mutex);
+    return err;
+}
+
+// {"uris":["a","b",...]} into request_body, false if it doesn't fit
+static bool playback_build_uris_body(const char *const *uris, size_t count)
+{
+    size_t len = strlcpy(request_body, "{\"uris\":[", sizeof(request_body));
+    for (size_t i = 0; i < count && len < sizeof(request_body); i++) {
+        len += snprintf(request_body + len, sizeof(request_body) - len, "%s\"%s\"", i > 0 ? "," : "", uris[i]);
+    }
+    if (len < sizeof(request_body)) {
+        len += strlcpy(request_body + len, "]}", sizeof(request_body) - len);
+    }
+    return len < sizeof(request_body);
+}
+
+static void playback_note_playing(const uint8_t *uid, const char *uri, const char *label)
+{
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    state.is_playing = true;
+    if (uid != NULL) {
+        state.has_uid = true;
+        memcpy(state.uid, uid, PLAYBACK_UID_LEN);
+    }
+    strlcpy(state.context_uri, uri, sizeof(state.context_uri));
+    strlcpy(state.label, label, sizeof(state.label));
+    state.updated_us = esp_timer_get_time();
+    xSemaphoreGive(state_mutex);
+    if (uid != NULL) {
+        album_art_request(uid, uri); // the LED nodes pick up the cover colors of what the card plays
+    }
+}
+
+/*
+ * Send the queue taps collected in the batch window.
+ *
+ * The Web API only queues one item per request, so repeated taps of the same
+ * card are merged and the rest go out one by one. When nothing is playing the
+ * whole batch starts as a single track list instead.
+ */
+static void playback_flush_batch(void)
+{
+    if (batch_len == 0) {
+        return;
+    }
+    const char *uris[PLAYBACK_BATCH_MAX];
+    size_t n = 0;
+    for (size_t i = 0; i < batch_len; i++) {
+        bool seen = false;
+        for (size_t j = 0; j < n && !seen; j++) {
+            seen = strcmp(uris[j], batch[i]->uri) == 0;
+        }
+        if (!seen) {
+            uris[n++] = batch[i]->uri;
+        }
+    }
+    const card_t *last = batch[batch_len - 1];
+    batch_len = 0;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    bool is_playing = state.is_playing;
+    xSemaphoreGive(state_mutex);
+
+    // Queue taps are never superseded, they only run out of time
+    spotify_deadline_t deadline = spotify_deadline_start(CONFIG_SPOTIFY_TAP_DEADLINE_MS, NULL);
+    if (!is_playing && playback_build_uris_body(uris, n)) {
+        if (playback_request(batch_account, &deadline, HTTP_METHOD_PUT, "/play", NULL, request_body) == ESP_OK) {
+            playback_note_playing(NULL, uris[0], last->label);
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            // Colons are escaped, the URI is a query parameter here
+            char query[96];
+            size_t len = strlcpy(query, "uri=", sizeof(query));
+            for (const char *c = uris[i]; *c != '\0' && len + 3 < sizeof(query); c++) {
+                len += *c == ':' ? snprintf(query + len, sizeof(query) - len, "%%3A") :
+                                   snprintf(query + len, sizeof(query) - len, "%c", *c);
+            }
+            if (playback_request(batch_account, &deadline, HTTP_METHOD_POST, "/queue", query, NULL) == ESP_ERR_TIMEOUT) {
+                break; // the rest would time out too
+            }
+        }
+    }
+    TRACE(PLAYBACK_BATCH, n, is_playing ? n : 1);
+    power_note_tap_done();
+}
+
+static void playback_play_uid(const uint8_t *uid, const spotify_deadline_t *deadline)
+{
+    power_note_tap_dispatched();
+    const card_t *card = cards_lookup(uid);
+    if (card == NULL) {
+        power_note_tap_done();
+        TRACE(PLAYBACK_UNKNOWN, TRACE_UID32(uid), 0);
+        ESP_LOGI(TAG, "Unknown UID, cannot play Spotify content");
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        state.last_result = ESP_ERR_NOT_FOUND;
+        xSemaphoreGive(state_mutex);
+        return;
+    }
+
+    // Whoever tapped last is who the player serves until the next card
+    active_account = card->account;
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    state.account = card->account;
+    xSemaphoreGive(state_mutex);
+
+    if (card->mode == CARD_MODE_QUEUE) {
+        // Hold it for a moment, a few more queue taps usually follow; a batch only holds one account's taps
+        if (batch_len == PLAYBACK_BATCH_MAX || (batch_len > 0 && batch_account != card->account)) {
+            playback_flush_batch();
+        }
+        if (batch_len == 0) {
+            batch_deadline_us = esp_timer_get_time() + CONFIG_PLAYBACK_QUEUE_BATCH_MS * 1000LL;
+            batch_account = card->account;
+        }
+        batch[batch_len++] = card;
+        if (CONFIG_PLAYBACK_QUEUE_BATCH_MS == 0) {
+            playback_flush_batch();
+        }
+        return;
+    }
+
+    // Queue taps made before this one go first, in tap order
+    playback_flush_batch();
+
+    const char *uri = card->uri;
+    esp_err_t err;
+    if (card->mode == CARD_MODE_TRACK_LIST) {
+        size_t count = 0;
+        while (card->uris[count] != NULL) {
+            count++;
+        }
+        if (count == 0 || !playback_build_uris_body(card->uris, count)) {
+            ESP_LOGE(TAG, "Track list of %s is empty or too long", card->label);
+            power_note_tap_done();
+            return;
+        }
+        uri = card->uris[0];
+        err = playback_request(card->account, deadline, HTTP_METHOD_PUT, "/play", NULL, request_body);
+    } else {
+        snprintf(request_body, sizeof(request_body), "{\"context_uri\":\"%s\"}", card->uri);
+        err = playback_request(card->account, deadline, HTTP_METHOD_PUT, "/play", NULL, request_body);
+    }
+    power_note_tap_done();
+    if (err != ESP_OK) {
+        return;
+    }
+    TRACE(PLAYBACK_PLAYED, TRACE_UID32(uid), state.last_status);
+    ESP_LOGD(TAG, "Playing %s: %s", card->label, uri);
+    playback_note_playing(uid, uri, card->label);
+}
+
+static void playback_execute(const playback_cmd_t *cmd)
+{
+    char query[32];
+    // A card plays on its own account, everything else goes to the account that played last
+    int account = active_account;
+    if (cmd->type == PLAYBACK_CMD_PLAY_UID) {
+        const card_t *card = cards_lookup(cmd->uid);
+        account = card != NULL ? card->account : account;
+    }
+    if (playback_use_account(account) != ESP_OK) {
+        ESP_LOGE(TAG, "No valid access token for account %d, command %d not sent", account, cmd->type);
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        state.last_result = ESP_ERR_INVALID_STATE;
+        xSemaphoreGive(state_mutex);
+        return;
+    }
+    if (cmd->type != PLAYBACK_CMD_PLAY_UID) {
+        playback_flush_batch(); // keep queue taps ahead of a later pause or skip
+    }
+    // Plays are cancelled by a newer play, everything else only by its deadline
+    spotify_deadline_t deadline = spotify_deadline_start(CONFIG_SPOTIFY_TAP_DEADLINE_MS,
+                                                         cmd->type == PLAYBACK_CMD_PLAY_UID ? &play_generation : NULL);
+    deadline.started_generation = cmd->generation;
+    deadline.expires_us = cmd->expires_us;
+    switch (cmd->type) {
+        case PLAYBACK_CMD_PLAY_UID:
+            playback_play_uid(cmd->uid, &deadline);
+            break;
+        case PLAYBACK_CMD_PAUSE:
+            if (playback_request(account, &deadline, HTTP_METHOD_PUT, "/pause", NULL, NULL) == ESP_OK) {
+                xSemaphoreTake(state_mutex, portMAX_DELAY);
+                state.is_playing = false;
+                state.updated_us = esp_timer_get_time();
+                xSemaphoreGive(state_mutex);
+            }
+            break;
+        case PLAYBACK_CMD_NEXT:
+            playback_request(account, &deadline, HTTP_METHOD_POST, "/next", NULL, NULL);
+            break;
+        case PLAYBACK_CMD_VOLUME:
+            snprintf(query, sizeof(query), "volume_percent=%u", cmd->volume_percent);
+            if (playback_request(account, &deadline, HTTP_METHOD_PUT, "/volume", query, NULL) == ESP_OK) {
+                xSemaphoreTake(state_mutex, portMAX_DELAY);
+                state.volume_percent = cmd->volume_percent;
+                state.updated_us = esp_timer_get_time();
+                xSemaphoreGive(state_mutex);
+            }
+            break;
+        case PLAYBACK_CMD_REPLAY:
+            break;
+    }
+}
+
+void playback_set_online(bool is_online)
+{
+    online = is_online;
+    if (state_mutex != NULL) {
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        state.online = is_online;
+        xSemaphoreGive(state_mutex);
+    }
+    if (is_online && playback_queue != NULL) {
+        playback_cmd_t cmd = {
+            .type = PLAYBACK_CMD_REPLAY,
+        };
+        xQueueSendToFront(playback_queue, &cmd, 0);
+    }
+}
+
+static void playback_buffer(const playback_cmd_t *cmd)
+{
+    bool adds = cmd->type == PLAYBACK_CMD_PLAY_UID && !playback_replaces(cmd);
+    tap_buffer_item_t item = {
+        .kind = adds ? PLAYBACK_KIND_ADD_UID : cmd->type,
+        .queued_us = esp_timer_get_time(),
+    };
+    memcpy(item.payload, cmd, sizeof(*cmd));
+    bool kept_all = tap_buffer_push(&pending, &item);
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    state.commands_buffered++;
+    if (!kept_all) {
+        state.commands_dropped++;
+    }
+    xSemaphoreGive(state_mutex);
+    ESP_LOGW(TAG, "Offline, buffered command %d (%u pending)", cmd->type, (unsigned)pending.count);
+}
+
+static void playback_replay(void)
+{
+    tap_buffer_item_t items[TAP_BUFFER_CAPACITY];
+    size_t n = tap_buffer_drain(&pending, items, TAP_BUFFER_CAPACITY, PLAYBACK_SUPERSEDE_MASK,
+                                PLAYBACK_COALESCE_MASK, esp_timer_get_time(), PLAYBACK_PENDING_MAX_AGE_US);
+    if (n > 0) {
+        ESP_LOGI(TAG, "Back online, replaying %u buffered command(s)", (unsigned)n);
+    }
+    for (size_t i = 0; i < n; i++) {
+        playback_cmd_t cmd;
+        memcpy(&cmd, items[i].payload, sizeof(cmd));
+        // Replaying is a fresh attempt, the budget set at the tap ran out during the outage
+        cmd.expires_us = esp_timer_get_time() + CONFIG_SPOTIFY_TAP_DEADLINE_MS * 1000LL;
+        playback_execute(&cmd);
+    }
+}
+
+// Refresh the snapshot from Spotify while idle, so changes made from other apps show up too
+static void playback_poll(void)
+{
+    // Only with a warm token, a poll isn't worth a refresh
+    if (!online || !accounts_token_valid(active_account) || playback_use_account(active_account) != ESP_OK) {
+        return;
+    }
+    char *body = malloc(PLAYBACK_POLL_BUFFER_SIZE);
+    if (body == NULL) {
+        return;
+    }
+    spotify_response_t resp = {
+        .body = body,
+        .body_size = PLAYBACK_POLL_BUFFER_SIZE,
+    };
+    spotify_deadline_t deadline = spotify_deadline_start(PLAYBACK_POLL_DEADLINE_MS, NULL);
+    esp_err_t err = spotify_client_request(SPOTIFY_PRIORITY_BACKGROUND, &deadline, HTTP_METHOD_GET, SPOTIFY_PLAYER_URL "?market=from_token", bearer, NULL, &resp);
+    if (err != ESP_OK || resp.truncated) {
+        free(body);
+        return;
+    }
+
+    if (resp.status_code == 204) {
+        // Nothing is playing on any device
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        if (state.is_playing) {
+            state.is_playing = false;
+            state.updated_us = esp_timer_get_time();
+        }
+        xSemaphoreGive(state_mutex);
+    } else if (resp.status_code == 200) {
+        cJSON *root = cJSON_ParseWithLength(body, resp.body_len);
+        if (root != NULL) {
+            cJSON *is_playing = cJSON_GetObjectItemCaseSensitive(root, "is_playing");
+            cJSON *device = cJSON_GetObjectItemCaseSensitive(root, "device");
+            cJSON *volume = cJSON_GetObjectItemCaseSensitive(device, "volume_percent");
+            cJSON *context = cJSON_GetObjectItemCaseSensitive(root, "context");
+            cJSON *uri = cJSON_GetObjectItemCaseSensitive(context, "uri");
+            cJSON *item = cJSON_GetObjectItemCaseSensitive(root, "item");
+            cJSON *name = cJSON_GetObjectItemCaseSensitive(item, "name");
+
+            xSemaphoreTake(state_mutex, portMAX_DELAY);
+            state.is_playing = cJSON_IsTrue(is_playing);
+            if (cJSON_IsNumber(volume)) {
+                state.volume_percent = volume->valueint;
+            }
+            if (cJSON_IsString(uri)) {
+                strlcpy(state.context_uri, uri->valuestring, sizeof(state.context_uri));
+            }
+            if (cJSON_IsString(name)) {
+                strlcpy(state.label, name->valuestring, sizeof(state.label));
+            }
+            state.updated_us = esp_timer_get_time();
+            xSemaphoreGive(state_mutex);
+            cJSON_Delete(root);
+        }
+    }
+    free(body);
+}
+
+static void playback_task(void *arg)
+{
+    const TickType_t poll_ticks = CONFIG_PLAYBACK_POLL_INTERVAL_MS > 0 ?
+                                  pdMS_TO_TICKS(CONFIG_PLAYBACK_POLL_INTERVAL_MS) : portMAX_DELAY;
+    playback_cmd_t cmd;
+    while (1) {
+        TickType_t wait = poll_ticks;
+        if (batch_len > 0) {
+            int64_t left_us = batch_deadline_us - esp_timer_get_time();
+            TickType_t batch_ticks = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) + 1 : 0;
+            wait = MIN(wait, batch_ticks);
+        }
+        if (xQueueReceive(playback_queue, &cmd, wait) == pdTRUE) {
+            if (cmd.type == PLAYBACK_CMD_REPLAY) {
+                playback_replay();
+            } else if (!online) {
+                playback_buffer(&cmd);
+            } else {
+                playback_execute(&cmd);
+            }
+        } else if (batch_len > 0 && esp_timer_get_time() >= batch_deadline_us) {
+            if (online && playback_use_account(batch_account) == ESP_OK) {
+                playback_flush_batch();
+            } else {
+                batch_deadline_us = esp_timer_get_time() + 1000000; // try again once the network is back
+            }
+        } else {
+            playback_poll();
+        }
+    }
+}
+
+esp_err_t playback_start(void)
+{
+    state_mutex = xSemaphoreCreateMutex();
+    playback_queue = xQueueCreate(PLAYBACK_QUEUE_LEN, sizeof(playback_cmd_t));
+    if (state_mutex == NULL || playback_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tap_buffer_init(&pending);
+    if (xTaskCreate(playback_task, "playback", PLAYBACK_TASK_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define PLAYBACK_UID_LEN 4
+
+/**
+ * @brief Commands executed by the playback worker
+ */
+typedef enum {
+    PLAYBACK_CMD_PLAY_UID, /*!< Play the content bound to a card */
+    PLAYBACK_CMD_PAUSE,    /*!< Pause playback */
+    PLAYBACK_CMD_NEXT,     /*!< Skip to the next track */
+    PLAYBACK_CMD_VOLUME,   /*!< Set the volume */
+    PLAYBACK_CMD_REPLAY,   /*!< Internal: replay commands buffered while offline */
+} playback_cmd_type_t;
+
+typedef struct {
+    playback_cmd_type_t type;
+    uint8_t uid[PLAYBACK_UID_LEN]; /*!< PLAYBACK_CMD_PLAY_UID */
+    uint8_t volume_percent;        /*!< PLAYBACK_CMD_VOLUME */
+    uint32_t generation;           /*!< Set by playback_submit(): plays submitted so far, a newer one cancels this */
+    int64_t expires_us;            /*!< Set by playback_submit(): esp_timer time the command is stale after */
+} playback_cmd_t;
+
+/**
+ * @brief Last known player state, kept in memory so reads never touch Spotify
+ */
+typedef struct {
+    bool is_playing;
+    bool has_uid;
+    uint8_t uid[PLAYBACK_UID_LEN]; /*!< Last card played */
+    char context_uri[64];          /*!< Spotify context being played */
+    char label[32];                /*!< Card label, or the track name when polled */
+    int volume_percent;            /*!< -1 when unknown */
+    int last_status;               /*!< HTTP status of the last command, 0 if it never got a response */
+    esp_err_t last_result;         /*!< Result of the last command */
+    int64_t updated_us;            /*!< esp_timer time of the last change */
+    uint32_t commands_done;
+    uint32_t commands_dropped;     /*!< Commands discarded because the queue or offline buffer was full */
+    uint32_t commands_buffered;    /*!< Commands held back while offline */
+    bool online;                   /*!< The station has an IP address */
+    int account;                   /*!< Account of the last card played, pause, skip, volume and polls go to it */
+} playback_state_t;
+
+/**
+ * @brief Start the playback worker task
+ *
+ * All Spotify player calls run on this task, so UART and HTTP server tasks
+ * only enqueue commands and never block on HTTPS.
+ */
+esp_err_t playback_start(void);
+
+/**
+ * @brief Enqueue a command without blocking
+ *
+ * When the queue is full the oldest pending command is dropped, so the most
+ * recent tap always gets through. A play supersedes any play submitted before
+ * it: if the worker is still on the older one, its remaining requests are
+ * cancelled.
+ */
+esp_err_t playback_submit(const playback_cmd_t *cmd);
+
+/**
+ * @brief Convenience wrapper to enqueue a card tap
+ */
+esp_err_t playback_submit_uid(const uint8_t *uid);
+
+/**
+ * @brief Tell the worker whether the network is usable
+ *
+ * While offline, commands are kept in a bounded buffer instead of failing.
+ * Going online replays them, with the latest play superseding older ones.
+ */
+void playback_set_online(bool online);
+
+/**
+ * @brief Copy the cached player state
+ */
+void playback_get_state(playback_state_t *state);
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include <cJSON.h>
+#include "latency_stats.h"
+#include "power.h"
+
+#define TAG "POWER"
+
+#define POWER_MAX_FREQ_MHZ 160
+#define POWER_MIN_FREQ_MHZ 40 // XTAL
+
+static portMUX_TYPE power_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_pm_lock_handle_t request_lock = NULL;
+static int64_t request_started_us = 0;
+static int request_depth = 0;
+static int64_t request_total_us = 0; // time spent holding the CPU at full speed
+static uint32_t requests = 0;
+
+static int64_t tap_us = 0; // arrival of the tap not yet dispatched, 0 if none
+static int64_t dispatched_tap_us = 0;
+static latency_stats_t tap_to_request;
+static latency_stats_t tap_to_done;
+
+esp_err_t power_init(void)
+{
+    latency_stats_reset(&tap_to_request);
+    latency_stats_reset(&tap_to_done);
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = POWER_MAX_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+#if CONFIG_EXAMPLE_PM_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+        return err;
+    }
+    err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "spotify", &request_lock);
+    if (err != ESP_OK) {
+        return err;
+    }
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, running at full clock");
+#endif
+    return ESP_OK;
+}
+
+esp_err_t power_enable_uart_wakeup(uart_port_t uart_num)
+{
+#if CONFIG_EXAMPLE_PM_LIGHT_SLEEP
+    esp_err_t err = uart_set_wakeup_threshold(uart_num, CONFIG_EXAMPLE_UART_WAKEUP_THRESHOLD);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return esp_sleep_enable_uart_wakeup(uart_num);
+#else
+    return ESP_OK;
+#endif
+}
+
+void power_request_begin(void)
+{
+    if (request_lock != NULL) {
+        esp_pm_lock_acquire(request_lock);
+    }
+    taskENTER_CRITICAL(&power_lock);
+    if (request_depth++ == 0) {
+        request_started_us = esp_timer_get_time();
+    }
+    requests++;
+    taskEXIT_CRITICAL(&power_lock);
+}
+
+void power_request_end(void)
+{
+    taskENTER_CRITICAL(&power_lock);
+    if (request_depth > 0 && --request_depth == 0) {
+        request_total_us += esp_timer_get_time() - request_started_us;
+    }
+    taskEXIT_CRITICAL(&power_lock);
+    if (request_lock != NULL) {
+        esp_pm_lock_release(request_lock);
+    }
+}
+
+void power_note_tap(void)
+{
+    taskENTER_CRITICAL(&power_lock);
+    tap_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&power_lock);
+}
+
+void power_note_tap_dispatched(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&power_lock);
+    // Commands submitted over the REST API have no tap to measure from
+    if (tap_us != 0) {
+        latency_stats_add(&tap_to_request, now - tap_us);
+        dispatched_tap_us = tap_us;
+        tap_us = 0;
+    }
+    taskEXIT_CRITICAL(&power_lock);
+}
+
+void power_note_tap_done(void)
+{
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&power_lock);
+    if (dispatched_tap_us != 0) {
+        latency_stats_add(&tap_to_done, now - dispatched_tap_us);
+        dispatched_tap_us = 0;
+    }
+    taskEXIT_CRITICAL(&power_lock);
+}
+
+static void power_add_latency(cJSON *root, const char *name, const latency_stats_t *stats)
+{
+    cJSON *obj = cJSON_AddObjectToObject(root, name);
+    cJSON_AddNumberToObject(obj, "count", stats->count);
+    cJSON_AddNumberToObject(obj, "last_us", stats->last_us);
+    cJSON_AddNumberToObject(obj, "p50_us", latency_stats_percentile(stats, 50));
+    cJSON_AddNumberToObject(obj, "p99_us", latency_stats_percentile(stats, 99));
+    cJSON_AddNumberToObject(obj, "max_us", stats->max_us);
+}
+
+// GET /debug/power: how the chip spends its time and how long taps take to act on
+static esp_err_t power_get_handler(httpd_req_t *req)
+{
+    static int64_t last_read_us = 0;
+    static configRUN_TIME_COUNTER_TYPE last_idle = 0;
+    static latency_stats_t request_stats, done_stats;
+
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&power_lock);
+    request_stats = tap_to_request;
+    done_stats = tap_to_done;
+    int64_t full_speed_us = request_total_us;
+    uint32_t request_count = requests;
+    taskEXIT_CRITICAL(&power_lock);
+
+    bool light_sleep = false;
+#if CONFIG_EXAMPLE_PM_LIGHT_SLEEP
+    light_sleep = true;
+#endif
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "pm", request_lock != NULL);
+    cJSON_AddBoolToObject(root, "light_sleep", light_sleep);
+    cJSON_AddNumberToObject(root, "listen_interval", CONFIG_EXAMPLE_WIFI_LISTEN_INTERVAL);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // Idle time is time the chip was free to sleep, the closest thing to a current reading we have
+    configRUN_TIME_COUNTER_TYPE idle = ulTaskGetIdleRunTimeCounter();
+    if (now > last_read_us) {
+        cJSON_AddNumberToObject(root, "idle_pct", (double)((uint64_t)(idle - last_idle) * 100 / (now - last_read_us)));
+    }
+    last_idle = idle;
+#endif
+    last_read_us = now;
+    cJSON_AddNumberToObject(root, "requests", request_count);
+    cJSON_AddNumberToObject(root, "full_speed_ms", (double)(full_speed_us / 1000));
+    power_add_latency(root, "tap_to_request", &request_stats);
+    power_add_latency(root, "tap_to_done", &done_stats);
+#if CONFIG_PM_PROFILING
+    esp_pm_dump_locks(stdout); // time spent in each power mode, light sleep included
+#endif
+
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (body == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_sendstr(req, body);
+    cJSON_free(body);
+    return err;
+}
+
+esp_err_t power_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t power_uri = {
+        .uri = "/debug/power",
+        .method = HTTP_GET,
+        .handler = power_get_handler,
+        .user_ctx = NULL};
+    return httpd_register_uri_handler(server, &power_uri);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "driver/uart.h"
+
+/**
+ * @brief Enable dynamic frequency scaling and, if configured, automatic light sleep
+ *
+ * Between taps the CPU drops to the XTAL clock and sleeps while Wi-Fi is in
+ * modem sleep. Spotify requests hold a lock that keeps the CPU at full speed.
+ */
+esp_err_t power_init(void);
+
+/**
+ * @brief Let activity on the UART that carries taps wake the chip from light sleep
+ *
+ * The characters that wake the chip are lost, so the RFID sender sends a short
+ * preamble before each UID line.
+ */
+esp_err_t power_enable_uart_wakeup(uart_port_t uart_num);
+
+/**
+ * @brief Keep the CPU at full speed while a Spotify request is in flight
+ *
+ * Calls nest; every power_request_begin() needs a matching power_request_end().
+ */
+void power_request_begin(void);
+void power_request_end(void);
+
+/**
+ * @brief Record that a tap has arrived on the UART
+ */
+void power_note_tap(void);
+
+/**
+ * @brief Record that the request for the last tap is about to be sent
+ */
+void power_note_tap_dispatched(void);
+
+/**
+ * @brief Record that Spotify has answered the request for the last tap
+ */
+void power_note_tap_done(void);
+
+/**
+ * @brief Register the GET /debug/power handler on the given server
+ */
+esp_err_t power_register_handlers(httpd_handle_t server);
@@ -0,0 +1,171 @@
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <cJSON.h>
+#include "playback.h"
+#include "rest_api.h"
+#include "spotify_limiter.h"
+#include "spotify_client.h"
+#include "uid_codec.h"
+
+#define TAG "REST_API"
+
+static esp_err_t rest_send_json(httpd_req_t *req, const char *status, cJSON *root)
+{
+    char *body = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (body == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    esp_err_t err = httpd_resp_sendstr(req, body);
+    cJSON_free(body);
+    return err;
+}
+
+// Answer a write once the command is queued; the worker does the Spotify call later
+static esp_err_t rest_submit(httpd_req_t *req, const playback_cmd_t *cmd)
+{
+    if (playback_submit(cmd) != ESP_OK) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_type(req, "application/json");
+        return httpd_resp_sendstr(req, "{\"queued\":false}");
+    }
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, "{\"queued\":true}");
+}
+
+// Read one query parameter into buf, ESP_FAIL if it is missing
+static esp_err_t rest_query_param(httpd_req_t *req, const char *key, char *buf, size_t buf_size)
+{
+    char query[96];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_query_key_value(query, key, buf, buf_size);
+}
+
+static esp_err_t state_get_handler(httpd_req_t *req)
+{
+    playback_state_t state;
+    playback_get_state(&state);
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "is_playing", state.is_playing);
+    if (state.has_uid) {
+        char uid[PLAYBACK_UID_LEN * 2 + 1];
+        snprintf(uid, sizeof(uid), "%02X%02X%02X%02X", state.uid[0], state.uid[1], state.uid[2], state.uid[3]);
+        cJSON_AddStringToObject(root, "uid", uid);
+    }
+    cJSON_AddStringToObject(root, "context_uri", state.context_uri);
+    cJSON_AddStringToObject(root, "label", state.label);
+    cJSON_AddNumberToObject(root, "account", state.account);
+    cJSON_AddNumberToObject(root, "volume", state.volume_percent);
+    cJSON_AddNumberToObject(root, "last_status", state.last_status);
+    cJSON_AddStringToObject(root, "last_result", esp_err_to_name(state.last_result));
+    cJSON_AddNumberToObject(root, "age_ms", state.updated_us ? (double)((esp_timer_get_time() - state.updated_us) / 1000) : -1);
+    cJSON_AddNumberToObject(root, "commands_done", state.commands_done);
+    cJSON_AddNumberToObject(root, "commands_dropped", state.commands_dropped);
+
+    spotify_limiter_stats_t limiter;
+    spotify_limiter_get_stats(&limiter);
+    int64_t blocked_us = limiter.blocked_until_us - esp_timer_get_time();
+    cJSON *rate_limit = cJSON_AddObjectToObject(root, "rate_limit");
+    cJSON_AddNumberToObject(rate_limit, "per_min", limiter.rate_per_min);
+    cJSON_AddNumberToObject(rate_limit, "granted", limiter.granted);
+    cJSON_AddNumberToObject(rate_limit, "deferred", limiter.deferred);
+    cJSON_AddNumberToObject(rate_limit, "timed_out", limiter.timed_out);
+    cJSON_AddNumberToObject(rate_limit, "rate_limited", limiter.rate_limited);
+    cJSON_AddNumberToObject(rate_limit, "blocked_ms", blocked_us > 0 ? (double)(blocked_us / 1000) : 0);
+    spotify_client_stats_t client;
+    spotify_client_get_stats(&client);
+    cJSON *requests = cJSON_AddObjectToObject(root, "requests");
+    cJSON_AddNumberToObject(requests, "deadline_misses", client.deadline_misses);
+    cJSON_AddNumberToObject(requests, "cancelled", client.cancelled);
+    cJSON_AddNumberToObject(requests, "compressed", client.compressed);
+    cJSON_AddNumberToObject(requests, "inflate_errors", client.inflate_errors);
+    cJSON_AddNumberToObject(requests, "wire_bytes", client.wire_bytes);
+    cJSON_AddNumberToObject(requests, "body_bytes", client.body_bytes);
+    cJSON_AddBoolToObject(requests, "compression_off", client.compression_off);
+    return rest_send_json(req, HTTPD_200, root);
+}
+
+static esp_err_t play_post_handler(httpd_req_t *req)
+{
+    char hex[PLAYBACK_UID_LEN * 2 + 1];
+    if (rest_query_param(req, "uid", hex, sizeof(hex)) != ESP_OK || strlen(hex) < 2) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "uid query parameter required");
+    }
+
+    playback_cmd_t cmd = {
+        .type = PLAYBACK_CMD_PLAY_UID,
+    };
+    size_t hex_len = strlen(hex);
+    if (hex_len % 2 != 0) {
+        // The parser would read a trailing single digit as a byte of its own
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "uid must be whole hex bytes");
+    }
+    size_t uid_len = uid_parse_hex(hex, hex_len, cmd.uid, PLAYBACK_UID_LEN);
+    if (uid_len * 2 != hex_len) {
+        // The parser stopped early, so something in there wasn't a hex digit
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "uid must be hex");
+    }
+    return rest_submit(req, &cmd);
+}
+
+static esp_err_t pause_post_handler(httpd_req_t *req)
+{
+    playback_cmd_t cmd = {
+        .type = PLAYBACK_CMD_PAUSE,
+    };
+    return rest_submit(req, &cmd);
+}
+
+static esp_err_t next_post_handler(httpd_req_t *req)
+{
+    playback_cmd_t cmd = {
+        .type = PLAYBACK_CMD_NEXT,
+    };
+    return rest_submit(req, &cmd);
+}
+
+static esp_err_t volume_post_handler(httpd_req_t *req)
+{
+    char value[8];
+    if (rest_query_param(req, "percent", value, sizeof(value)) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "percent query parameter required");
+    }
+    char *end;
+    long percent = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || percent < 0 || percent > 100) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "percent must be 0-100");
+    }
+
+    playback_cmd_t cmd = {
+        .type = PLAYBACK_CMD_VOLUME,
+        .volume_percent = (uint8_t)percent,
+    };
+    return rest_submit(req, &cmd);
+}
+
+esp_err_t rest_api_register_handlers(httpd_handle_t server)
+{
+    const httpd_uri_t handlers[] = {
+        {.uri = "/api/state", .method = HTTP_GET, .handler = state_get_handler},
+        {.uri = "/api/play", .method = HTTP_POST, .handler = play_post_handler},
+        {.uri = "/api/pause", .method = HTTP_POST, .handler = pause_post_handler},
+        {.uri = "/api/next", .method = HTTP_POST, .handler = next_post_handler},
+        {.uri = "/api/volume", .method = HTTP_POST, .handler = volume_post_handler},
+    };
+    for (size_t i = 0; i < sizeof(handlers) / sizeof(handlers[0]); i++) {
+        esp_err_t err = httpd_register_uri_handler(server, &handlers[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to register %s: %s", handlers[i].uri, esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
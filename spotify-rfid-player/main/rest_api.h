@@ -0,0 +1,17 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Register the local control API on the given server
+ *
+ * - GET  /api/state               cached player state, never touches Spotify
+ * - POST /api/play?uid=33AB12CD   play the content bound to a card
+ * - POST /api/pause               pause playback
+ * - POST /api/next                skip to the next track
+ * - POST /api/volume?percent=40   set the volume
+ *
+ * Writes are queued to the playback worker and answered with 202 right away.
+ */
+esp_err_t rest_api_register_handlers(httpd_handle_t server);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Credentials of the Spotify app, owned by main.c and shared by every account
+extern char client_id[];
+extern char client_secret[];
+
+/**
+ * @brief Fetch the display name of an authorized account and keep it as the account's name
+ */
+esp_err_t get_user_profile(int account);
+
+/**
+ * @brief Look up a Spotify Connect device by name and keep its ID as the account's device
+ *
+ * @return ESP_OK if found, ESP_ERR_NOT_FOUND if no such device is online, or the request's error
+ */
+esp_err_t get_spotify_device_id(int account, const char *target_device_name);
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spotify_client.h"
+#include "spotify_inflate.h"
+#include "power.h"
+#include "trace.h"
+
+#define TAG "SPOTIFY_CLIENT"
+
+#define SPOTIFY_CLIENT_MAX_ATTEMPTS  3
+#define SPOTIFY_CLIENT_MIN_STEP_MS   50 // no point starting a step with less time than this
+#define SPOTIFY_CLIENT_CHUNK_SIZE    256 // compressed bytes read at a time, decoded straight into the body
+
+// Response headers the client acts on
+typedef struct {
+    int retry_after_s;
+    spotify_encoding_t encoding;
+} spotify_client_headers_t;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static spotify_client_stats_t counters;
+
+spotify_deadline_t spotify_deadline_start(uint32_t budget_ms, const volatile uint32_t *generation)
+{
+    spotify_deadline_t deadline = {
+        .expires_us = esp_timer_get_time() + budget_ms * 1000LL,
+        .generation = generation,
+        .started_generation = generation != NULL ? *generation : 0,
+    };
+    return deadline;
+}
+
+uint32_t spotify_deadline_remaining_ms(const spotify_deadline_t *deadline)
+{
+    int64_t left_us = deadline->expires_us - esp_timer_get_time();
+    return left_us > 0 ? left_us / 1000 : 0;
+}
+
+bool spotify_deadline_cancelled(const spotify_deadline_t *deadline)
+{
+    return deadline->generation != NULL && *deadline->generation != deadline->started_generation;
+}
+
+void spotify_client_get_stats(spotify_client_stats_t *stats)
+{
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = counters;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+// ESP_OK while the operation may go on, otherwise why it has to stop
+static esp_err_t spotify_client_check(const spotify_deadline_t *deadline)
+{
+    if (spotify_deadline_cancelled(deadline)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    return spotify_deadline_remaining_ms(deadline) >= SPOTIFY_CLIENT_MIN_STEP_MS ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static bool spotify_client_compression_on(void)
+{
+#if CONFIG_SPOTIFY_COMPRESSED_RESPONSES
+    taskENTER_CRITICAL(&stats_lock);
+    bool on = !counters.compression_off;
+    taskEXIT_CRITICAL(&stats_lock);
+    return on;
+#else
+    return false;
+#endif
+}
+
+static void spotify_client_count_body(bool compressed, size_t wire_bytes, size_t body_bytes, bool inflate_error)
+{
+    taskENTER_CRITICAL(&stats_lock);
+    counters.compressed += compressed;
+    counters.wire_bytes += wire_bytes;
+    counters.body_bytes += body_bytes;
+    if (inflate_error) {
+        counters.inflate_errors++;
+        counters.compression_off = true;
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+// Response headers only reach us through the event handler
+static esp_err_t spotify_client_event(esp_http_client_event_t *evt)
+{
+    spotify_client_headers_t *headers = evt->user_data;
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Retry-After") == 0) {
+        headers->retry_after_s = atoi(evt->header_value);
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Encoding") == 0) {
+        headers->encoding = spotify_inflate_encoding(evt->header_value);
+    }
+    return ESP_OK;
+}
+
+// Next piece of the body within the deadline, *len is 0 at its end
+static esp_err_t spotify_client_read(esp_http_client_handle_t client, const spotify_deadline_t *deadline,
+                                     char *buf, size_t size, int *len)
+{
+    uint32_t left_ms = spotify_deadline_remaining_ms(deadline);
+    if (left_ms == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    esp_http_client_set_timeout_ms(client, left_ms);
+    *len = esp_http_client_read(client, buf, size);
+    if (*len < 0) {
+        ESP_LOGE(TAG, "Failed to read response body");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Decode a gzip or deflate body into resp->body as it arrives
+static esp_err_t spotify_client_read_inflated(esp_http_client_handle_t client, const spotify_deadline_t *deadline,
+                                              spotify_inflate_t *inflate, spotify_encoding_t encoding,
+                                              spotify_response_t *resp)
+{
+    char chunk[SPOTIFY_CLIENT_CHUNK_SIZE];
+    size_t wire_bytes = 0;
+    esp_err_t err = ESP_OK;
+    spotify_inflate_begin(inflate, encoding, (uint8_t *)resp->body, resp->body_size - 1);
+    while (!spotify_inflate_done(inflate)) {
+        int len;
+        err = spotify_client_read(client, deadline, chunk, sizeof(chunk), &len);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (len == 0) {
+            ESP_LOGE(TAG, "Compressed response ended early");
+            err = ESP_FAIL;
+            break;
+        }
+        wire_bytes += len;
+        err = spotify_inflate_feed(inflate, (const uint8_t *)chunk, len);
+        if (err == ESP_ERR_INVALID_SIZE) {
+            resp->truncated = true;
+            err = ESP_OK;
+            break;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Response body does not decode, requesting uncompressed responses from now on");
+            break;
+        }
+    }
+    resp->body_len = spotify_inflate_out_len(inflate);
+    resp->body[resp->body_len] = '\0';
+    spotify_client_count_body(true, wire_bytes, resp->body_len, err == ESP_ERR_INVALID_RESPONSE);
+    return err;
+}
+
+static esp_err_t spotify_client_send(const spotify_deadline_t *deadline, esp_http_client_method_t method,
+                                     const char *url, const char *authorization, const char *content_type,
+                                     const char *body, spotify_response_t *resp, spotify_client_headers_t *headers)
+{
+    resp->status_code = 0;
+    resp->body_len = 0;
+    resp->truncated = false;
+    headers->retry_after_s = 0;
+    headers->encoding = SPOTIFY_ENCODING_IDENTITY;
+
+    // Connect and TLS get whatever is left of the budget, each later step is trimmed again
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = method,
+        .timeout_ms = spotify_deadline_remaining_ms(deadline),
+        .event_handler = spotify_client_event,
+        .user_data = headers,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return ESP_FAIL;
+    }
+    // TLS at full clock, and no light sleep until the response is in
+    power_request_begin();
+    int64_t start_us = esp_timer_get_time();
+
+    if (authorization != NULL) {
+        esp_http_client_set_header(client, "Authorization", authorization);
+    }
+    if (body != NULL) {
+        esp_http_client_set_header(client, "Content-Type", content_type);
+    }
+    // Only bodies read in full are worth compressing, and only if the decoder fits in memory
+    bool capture = resp->body != NULL && resp->body_size > 0;
+    spotify_inflate_t *inflate = capture && spotify_client_compression_on() ? spotify_inflate_create() : NULL;
+    if (inflate != NULL) {
+        esp_http_client_set_header(client, "Accept-Encoding", SPOTIFY_INFLATE_ACCEPT);
+    }
+
+    // Spotify rejects PUT and POST without a Content-Length, so always send one
+    int body_len = body != NULL ? strlen(body) : 0;
+    TRACE(SPOTIFY_REQUEST, method, body_len);
+    esp_err_t err = esp_http_client_open(client, body_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection: %s", esp_err_to_name(err));
+        TRACE(SPOTIFY_FAILED, err, esp_timer_get_time() - start_us);
+        esp_http_client_cleanup(client);
+        spotify_inflate_destroy(inflate);
+        power_request_end();
+        esp_err_t stop = spotify_client_check(deadline);
+        return stop != ESP_OK ? stop : err;
+    }
+
+    if (body_len > 0 && esp_http_client_write(client, body, body_len) < 0) {
+        ESP_LOGE(TAG, "Write failed");
+        err = ESP_FAIL;
+        goto out;
+    }
+
+    // A request already sent is seen through, even if superseded, only time can stop it now
+    if (spotify_deadline_remaining_ms(deadline) < SPOTIFY_CLIENT_MIN_STEP_MS) {
+        err = ESP_ERR_TIMEOUT;
+        goto out;
+    }
+    esp_http_client_set_timeout_ms(client, spotify_deadline_remaining_ms(deadline));
+    if (esp_http_client_fetch_headers(client) < 0) {
+        ESP_LOGE(TAG, "Failed to read response headers");
+        err = spotify_deadline_remaining_ms(deadline) == 0 ? ESP_ERR_TIMEOUT : ESP_FAIL;
+        goto out;
+    }
+    resp->status_code = esp_http_client_get_status_code(client);
+
+    if (capture && headers->encoding != SPOTIFY_ENCODING_IDENTITY) {
+        if (inflate != NULL && headers->encoding != SPOTIFY_ENCODING_UNSUPPORTED) {
+            err = spotify_client_read_inflated(client, deadline, inflate, headers->encoding, resp);
+        } else {
+            // Not what was asked for, fall back to identity like after a decode error
+            ESP_LOGE(TAG, "Response in an encoding that can't be decoded");
+            resp->body[0] = '\0';
+            spotify_client_count_body(false, 0, 0, true);
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+    } else if (capture) {
+        while (resp->body_len < resp->body_size - 1) {
+            int len;
+            err = spotify_client_read(client, deadline, resp->body + resp->body_len,
+                                      resp->body_size - 1 - resp->body_len, &len);
+            if (err != ESP_OK || len == 0) {
+                break;
+            }
+            resp->body_len += len;
+        }
+        resp->body[resp->body_len] = '\0';
+        resp->truncated = resp->body_len == resp->body_size - 1 && !esp_http_client_is_complete_data_received(client);
+        spotify_client_count_body(false, resp->body_len, resp->body_len, false);
+    } else {
+        esp_http_client_flush_response(client, NULL);
+    }
+
+out:
+    if (err == ESP_OK) {
+        TRACE(SPOTIFY_RESPONSE, resp->status_code, esp_timer_get_time() - start_us);
+    } else {
+        TRACE(SPOTIFY_FAILED, err, esp_timer_get_time() - start_us);
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    spotify_inflate_destroy(inflate);
+    power_request_end();
+    return err;
+}
+
+esp_err_t spotify_client_request(spotify_priority_t priority, const spotify_deadline_t *deadline,
+                                 esp_http_client_method_t method, const char *url,
+                                 const char *access_token, const char *body, spotify_response_t *resp)
+{
+    esp_err_t err = ESP_OK;
+    resp->status_code = 0;
+    char auth_header[300];
+    snprintf(auth_header, sizeof(auth_header), "Bearer %s", access_token);
+
+    for (int attempt = 0; attempt < SPOTIFY_CLIENT_MAX_ATTEMPTS; attempt++) {
+        // Superseded or out of time: don't start another request
+        err = spotify_client_check(deadline);
+        if (err != ESP_OK) {
+            break;
+        }
+        err = spotify_limiter_acquire(priority, priority == SPOTIFY_PRIORITY_USER ? deadline : NULL);
+        if (err != ESP_OK) {
+            resp->status_code = 0;
+            if (priority == SPOTIFY_PRIORITY_BACKGROUND) {
+                return err; // skipped for lack of spare tokens, not late
+            }
+            break;
+        }
+        // The wait for a token can take most of the budget, look again before anything goes out
+        err = spotify_client_check(deadline);
+        if (err != ESP_OK) {
+            break;
+        }
+        spotify_client_headers_t headers;
+        err = spotify_client_send(deadline, method, url, auth_header, "application/json", body, resp, &headers);
+        if (err == ESP_ERR_INVALID_RESPONSE && method == HTTP_METHOD_GET) {
+            continue; // compression is off now, and a GET is safe to repeat
+        }
+        if (err != ESP_OK) {
+            break;
+        }
+        spotify_limiter_note_response(resp->status_code, headers.retry_after_s);
+        // Only taps are retried, and only when the limiter's backoff fits in what's left of the deadline
+        if (priority != SPOTIFY_PRIORITY_USER || (resp->status_code != 429 && resp->status_code != 503)) {
+            break;
+        }
+    }
+
+    if (err == ESP_ERR_TIMEOUT || err == ESP_ERR_NOT_FINISHED) {
+        taskENTER_CRITICAL(&stats_lock);
+        if (err == ESP_ERR_TIMEOUT) {
+            counters.deadline_misses++;
+        } else {
+            counters.cancelled++;
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+        TRACE(SPOTIFY_DEADLINE, err == ESP_ERR_NOT_FINISHED, spotify_deadline_remaining_ms(deadline));
+    }
+    return err;
+}
+
+esp_err_t spotify_client_post_form(const spotify_deadline_t *deadline, const char *url, const char *authorization,
+                                   const char *form, spotify_response_t *resp)
+{
+    resp->status_code = 0;
+    esp_err_t err = spotify_client_check(deadline);
+    if (err != ESP_OK) {
+        return err;
+    }
+    spotify_client_headers_t headers;
+    err = spotify_client_send(deadline, HTTP_METHOD_POST, url, authorization, "application/x-www-form-urlencoded",
+                              form, resp, &headers);
+    if (err == ESP_ERR_TIMEOUT) {
+        taskENTER_CRITICAL(&stats_lock);
+        counters.deadline_misses++;
+        taskEXIT_CRITICAL(&stats_lock);
+        TRACE(SPOTIFY_DEADLINE, 0, spotify_deadline_remaining_ms(deadline));
+    }
+    return err;
+}
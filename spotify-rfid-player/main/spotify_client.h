@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "spotify_limiter.h"
+
+/**
+ * @brief End-to-end budget of one logical operation, such as a tap or a token refresh
+ *
+ * Every step of every request made for the operation (rate limiter wait,
+ * connect and TLS, response reads, retries) gets only what is left of the
+ * budget. An operation tied to a generation counter is cancelled once the
+ * counter moves on, e.g. when a newer tap supersedes it.
+ */
+typedef struct spotify_deadline {
+    int64_t expires_us;                 /*!< esp_timer time the operation must be done by */
+    const volatile uint32_t *generation; /*!< Counter bumped by whatever supersedes the operation, or NULL */
+    uint32_t started_generation;        /*!< Value of *generation when the operation started */
+} spotify_deadline_t;
+
+/**
+ * @brief Request path counters, for diagnostics
+ */
+typedef struct {
+    uint32_t deadline_misses; /*!< Operations that ran out of time */
+    uint32_t cancelled;       /*!< Operations abandoned because something newer superseded them */
+    uint32_t compressed;      /*!< Responses that arrived gzip or deflate encoded */
+    uint32_t inflate_errors;  /*!< Compressed bodies that failed to decode */
+    uint32_t wire_bytes;      /*!< Captured response body bytes as received */
+    uint32_t body_bytes;      /*!< The same bodies decoded, body_bytes - wire_bytes is the airtime saved */
+    bool compression_off;     /*!< Responses are requested uncompressed after a decode error */
+} spotify_client_stats_t;
+
+/**
+ * @brief Start the budget of an operation
+ *
+ * @param budget_ms Time the whole operation may take
+ * @param generation Supersede counter, or NULL if the operation is never cancelled
+ */
+spotify_deadline_t spotify_deadline_start(uint32_t budget_ms, const volatile uint32_t *generation);
+
+/**
+ * @brief Milliseconds left, 0 once expired
+ */
+uint32_t spotify_deadline_remaining_ms(const spotify_deadline_t *deadline);
+
+/**
+ * @brief Whether a newer operation has superseded this one
+ */
+bool spotify_deadline_cancelled(const spotify_deadline_t *deadline);
+
+/**
+ * @brief Copy the request path counters
+ */
+void spotify_client_get_stats(spotify_client_stats_t *stats);
+
+/**
+ * @brief Result of a Spotify Web API request
+ *
+ * Set body/body_size to a caller owned buffer to capture the response body,
+ * or leave them zero to discard it.
+ */
+typedef struct {
+    int status_code;  /*!< HTTP status, valid when the request returned ESP_OK */
+    char *body;       /*!< Optional buffer for the response body, always null-terminated */
+    size_t body_size; /*!< Size of body in bytes */
+    size_t body_len;  /*!< Bytes stored in body */
+    bool truncated;   /*!< The body did not fit in the buffer */
+} spotify_response_t;
+
+/**
+ * @brief Perform one authenticated request against the Spotify Web API
+ *
+ * Unlike the event handler based helpers in main.c this reads the response
+ * synchronously into the caller's buffer, so it is safe to use from any task.
+ *
+ * A captured body is requested gzip or deflate encoded when
+ * CONFIG_SPOTIFY_COMPRESSED_RESPONSES is set and decoded chunk by chunk as it
+ * arrives, so resp->body always holds plain JSON. Without the memory for the
+ * decoder the request goes out uncompressed instead. After a body fails to
+ * decode, compression stays off until reboot and a GET is repeated right away.
+ *
+ * Every call takes a token from the shared rate limiter first. User requests
+ * wait for it and are retried after a 429 or 503 while the limiter's backoff
+ * fits in what is left of the deadline; background requests are skipped when
+ * no spare token is free.
+ *
+ * @param priority Whether a user is waiting on the result
+ * @param deadline Budget of the operation this request belongs to
+ * @param method HTTP method
+ * @param url Full request URL
+ * @param access_token Bearer token
+ * @param body JSON request body, or NULL for none
+ * @param resp Response status and optional body
+ * @return ESP_OK if a response was received (check resp->status_code),
+ *         ESP_ERR_TIMEOUT if the deadline passed or the rate limiter held the request back,
+ *         ESP_ERR_NOT_FINISHED if the operation was cancelled, another error otherwise
+ */
+esp_err_t spotify_client_request(spotify_priority_t priority, const spotify_deadline_t *deadline,
+                                 esp_http_client_method_t method, const char *url,
+                                 const char *access_token, const char *body, spotify_response_t *resp);
+
+
+/**
+ * @brief POST a form to the Spotify accounts service, for token requests
+ *
+ * The response is read and decoded like spotify_client_request() does, but
+ * the accounts service is a separate host with its own limits, so the rate
+ * limiter is bypassed and nothing is retried.
+ *
+ * @param deadline Budget of the request
+ * @param url Full request URL
+ * @param authorization Authorization header value, or NULL for none
+ * @param form application/x-www-form-urlencoded request body
+ * @param resp Response status and body
+ * @return ESP_OK if a response was received (check resp->status_code),
+ *         ESP_ERR_TIMEOUT if the deadline passed, another error otherwise
+ */
+esp_err_t spotify_client_post_form(const spotify_deadline_t *deadline, const char *url, const char *authorization,
+                                   const char *form, spotify_response_t *resp);
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include "rom/miniz.h"
+#include "esp_rom_crc.h"
+#include "spotify_inflate.h"
+
+// gzip header flags, RFC 1952
+#define GZIP_FHCRC     0x02
+#define GZIP_FEXTRA    0x04
+#define GZIP_FNAME     0x08
+#define GZIP_FCOMMENT  0x10
+#define GZIP_FRESERVED 0xE0
+
+#define GZIP_FIXED_HEADER_LEN 10
+#define GZIP_TRAILER_LEN      8
+
+// Where in the stream the decoder is; the gzip header fields are skipped a byte at a time
+typedef enum {
+    INFLATE_GZIP_HEADER,
+    INFLATE_GZIP_EXTRA_LEN,
+    INFLATE_GZIP_EXTRA,
+    INFLATE_GZIP_NAME,
+    INFLATE_GZIP_COMMENT,
+    INFLATE_GZIP_HCRC,
+    INFLATE_DEFLATE_SNIFF, // first two bytes tell zlib from raw deflate
+    INFLATE_BODY,
+    INFLATE_GZIP_TRAILER,
+    INFLATE_DONE,
+    INFLATE_FAILED,
+} inflate_stage_t;
+
+struct spotify_inflate {
+    tinfl_decompressor tinfl;
+    uint32_t tinfl_flags;
+    spotify_encoding_t encoding;
+    inflate_stage_t stage;
+    uint8_t gzip_flags;
+    uint8_t field[GZIP_FIXED_HEADER_LEN]; // header or trailer bytes collected so far
+    size_t field_len;
+    size_t extra_left;
+    uint8_t *out;
+    size_t out_size;
+    size_t out_len;
+};
+
+spotify_encoding_t spotify_inflate_encoding(const char *content_encoding)
+{
+    if (content_encoding == NULL || content_encoding[0] == '\0' || strcasecmp(content_encoding, "identity") == 0) {
+        return SPOTIFY_ENCODING_IDENTITY;
+    }
+    if (strcasecmp(content_encoding, "gzip") == 0 || strcasecmp(content_encoding, "x-gzip") == 0) {
+        return SPOTIFY_ENCODING_GZIP;
+    }
+    if (strcasecmp(content_encoding, "deflate") == 0) {
+        return SPOTIFY_ENCODING_DEFLATE;
+    }
+    return SPOTIFY_ENCODING_UNSUPPORTED;
+}
+
+spotify_inflate_t *spotify_inflate_create(void)
+{
+    return malloc(sizeof(spotify_inflate_t));
+}
+
+void spotify_inflate_destroy(spotify_inflate_t *inflate)
+{
+    free(inflate);
+}
+
+void spotify_inflate_begin(spotify_inflate_t *inflate, spotify_encoding_t encoding, uint8_t *out, size_t out_size)
+{
+    tinfl_init(&inflate->tinfl);
+    // The output buffer holds the whole body, so it is also the window back references point into
+    inflate->tinfl_flags = TINFL_FLAG_HAS_MORE_INPUT | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+    inflate->encoding = encoding;
+    inflate->stage = encoding == SPOTIFY_ENCODING_GZIP ? INFLATE_GZIP_HEADER : INFLATE_DEFLATE_SNIFF;
+    inflate->gzip_flags = 0;
+    inflate->field_len = 0;
+    inflate->extra_left = 0;
+    inflate->out = out;
+    inflate->out_size = out_size;
+    inflate->out_len = 0;
+}
+
+bool spotify_inflate_done(const spotify_inflate_t *inflate)
+{
+    return inflate->stage == INFLATE_DONE;
+}
+
+size_t spotify_inflate_out_len(const spotify_inflate_t *inflate)
+{
+    return inflate->out_len;
+}
+
+// The stage after the gzip header field that just ended
+static inflate_stage_t gzip_next_field(uint8_t flags, inflate_stage_t done)
+{
+    if (done < INFLATE_GZIP_EXTRA_LEN && (flags & GZIP_FEXTRA)) {
+        return INFLATE_GZIP_EXTRA_LEN;
+    }
+    if (done < INFLATE_GZIP_NAME && (flags & GZIP_FNAME)) {
+        return INFLATE_GZIP_NAME;
+    }
+    if (done < INFLATE_GZIP_COMMENT && (flags & GZIP_FCOMMENT)) {
+        return INFLATE_GZIP_COMMENT;
+    }
+    if (done < INFLATE_GZIP_HCRC && (flags & GZIP_FHCRC)) {
+        return INFLATE_GZIP_HCRC;
+    }
+    return INFLATE_BODY;
+}
+
+// One byte of gzip header, false if the header is not one we can read
+static bool gzip_header_byte(spotify_inflate_t *inflate, uint8_t byte)
+{
+    switch (inflate->stage) {
+    case INFLATE_GZIP_HEADER:
+        inflate->field[inflate->field_len++] = byte;
+        if (inflate->field_len < GZIP_FIXED_HEADER_LEN) {
+            return true;
+        }
+        // Magic, deflate as the method, no reserved flags
+        if (inflate->field[0] != 0x1F || inflate->field[1] != 0x8B || inflate->field[2] != 8 ||
+            (inflate->field[3] & GZIP_FRESERVED)) {
+            return false;
+        }
+        inflate->gzip_flags = inflate->field[3];
+        break;
+    case INFLATE_GZIP_EXTRA_LEN:
+        inflate->field[inflate->field_len++] = byte;
+        if (inflate->field_len < 2) {
+            return true;
+        }
+        inflate->extra_left = inflate->field[0] | (inflate->field[1] << 8);
+        // Skip the extra field's bytes, or straight past it if it is empty
+        inflate->stage = INFLATE_GZIP_EXTRA;
+        if (inflate->extra_left > 0) {
+            inflate->field_len = 0;
+            return true;
+        }
+        break;
+    case INFLATE_GZIP_EXTRA:
+        if (--inflate->extra_left > 0) {
+            return true;
+        }
+        break;
+    case INFLATE_GZIP_NAME:
+    case INFLATE_GZIP_COMMENT:
+        if (byte != '\0') {
+            return true;
+        }
+        break;
+    case INFLATE_GZIP_HCRC:
+        if (++inflate->field_len < 2) {
+            return true;
+        }
+        break;
+    default:
+        return false;
+    }
+    inflate->stage = gzip_next_field(inflate->gzip_flags, inflate->stage);
+    inflate->field_len = 0;
+    return true;
+}
+
+// CRC-32 and length of the decoded body, the last 8 bytes of a gzip stream
+static bool gzip_trailer_ok(const spotify_inflate_t *inflate)
+{
+    const uint8_t *t = inflate->field;
+    uint32_t crc = t[0] | (t[1] << 8) | (t[2] << 16) | ((uint32_t)t[3] << 24);
+    uint32_t size = t[4] | (t[5] << 8) | (t[6] << 16) | ((uint32_t)t[7] << 24);
+    return size == (uint32_t)inflate->out_len && crc == esp_rom_crc32_le(0, inflate->out, inflate->out_len);
+}
+
+// Compressed data until the deflate stream ends, used says how much of it was taken
+static esp_err_t inflate_body(spotify_inflate_t *inflate, const uint8_t *in, size_t len, size_t *used)
+{
+    size_t in_size = len;
+    size_t out_size = inflate->out_size - inflate->out_len;
+    tinfl_status status = tinfl_decompress(&inflate->tinfl, in, &in_size, inflate->out,
+                                           inflate->out + inflate->out_len, &out_size, inflate->tinfl_flags);
+    inflate->out_len += out_size;
+    *used = in_size;
+    switch (status) {
+    case TINFL_STATUS_NEEDS_MORE_INPUT:
+        return in_size > 0 || len == 0 ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+    case TINFL_STATUS_DONE:
+        inflate->stage = inflate->encoding == SPOTIFY_ENCODING_GZIP ? INFLATE_GZIP_TRAILER : INFLATE_DONE;
+        inflate->field_len = 0;
+        return ESP_OK;
+    case TINFL_STATUS_HAS_MORE_OUTPUT:
+        return ESP_ERR_INVALID_SIZE;
+    default:
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+esp_err_t spotify_inflate_feed(spotify_inflate_t *inflate, const uint8_t *in, size_t len)
+{
+    while (len > 0 && inflate->stage != INFLATE_DONE) {
+        size_t used = 1;
+        esp_err_t err = ESP_OK;
+        switch (inflate->stage) {
+        case INFLATE_DEFLATE_SNIFF:
+            // "deflate" should mean zlib, but some servers send a bare deflate stream
+            inflate->field[inflate->field_len++] = *in;
+            if (inflate->field_len == 2) {
+                uint32_t header = (inflate->field[0] << 8) | inflate->field[1];
+                if ((inflate->field[0] & 0x0F) == 8 && header % 31 == 0) {
+                    inflate->tinfl_flags |= TINFL_FLAG_PARSE_ZLIB_HEADER;
+                }
+                inflate->stage = INFLATE_BODY;
+                size_t sniffed;
+                err = inflate_body(inflate, inflate->field, 2, &sniffed);
+            }
+            break;
+        case INFLATE_BODY:
+            err = inflate_body(inflate, in, len, &used);
+            break;
+        case INFLATE_GZIP_TRAILER:
+            inflate->field[inflate->field_len++] = *in;
+            if (inflate->field_len == GZIP_TRAILER_LEN) {
+                err = gzip_trailer_ok(inflate) ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+                inflate->stage = INFLATE_DONE;
+            }
+            break;
+        case INFLATE_FAILED:
+            err = ESP_ERR_INVALID_RESPONSE;
+            break;
+        default:
+            err = gzip_header_byte(inflate, *in) ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+            break;
+        }
+        if (err != ESP_OK) {
+            if (err == ESP_ERR_INVALID_RESPONSE) {
+                inflate->stage = INFLATE_FAILED;
+            }
+            return err;
+        }
+        in += used;
+        len -= used;
+    }
+    // Anything after the end of the stream is ignored
+    return ESP_OK;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Accept-Encoding header value for what spotify_inflate can decode
+ */
+#define SPOTIFY_INFLATE_ACCEPT "gzip, deflate"
+
+/**
+ * @brief Content-Encoding of a response body
+ */
+typedef enum {
+    SPOTIFY_ENCODING_IDENTITY,
+    SPOTIFY_ENCODING_GZIP,
+    SPOTIFY_ENCODING_DEFLATE,     /*!< zlib wrapped, or raw deflate from servers that get it wrong */
+    SPOTIFY_ENCODING_UNSUPPORTED,
+} spotify_encoding_t;
+
+/**
+ * @brief Streaming decoder for one compressed response body at a time
+ *
+ * The body is decoded straight into the caller's response buffer, which
+ * doubles as the deflate window, so no 32 KB history buffer is needed.
+ * Bodies are only decoded when they are captured in full, which is the case
+ * for every Spotify response the player reads.
+ */
+typedef struct spotify_inflate spotify_inflate_t;
+
+/**
+ * @brief Map a Content-Encoding header value, NULL or empty meaning identity
+ */
+spotify_encoding_t spotify_inflate_encoding(const char *content_encoding);
+
+/**
+ * @brief Allocate a decoder, about 11 KB of heap
+ *
+ * @return The decoder, or NULL if there is not enough memory, in which case
+ *         the response should be requested uncompressed
+ */
+spotify_inflate_t *spotify_inflate_create(void);
+
+/**
+ * @brief Free a decoder, NULL is ignored
+ */
+void spotify_inflate_destroy(spotify_inflate_t *inflate);
+
+/**
+ * @brief Start decoding a body
+ *
+ * @param encoding SPOTIFY_ENCODING_GZIP or SPOTIFY_ENCODING_DEFLATE
+ * @param out Buffer for the decoded body, it must stay put until the body is done
+ * @param out_size Size of out
+ */
+void spotify_inflate_begin(spotify_inflate_t *inflate, spotify_encoding_t encoding, uint8_t *out, size_t out_size);
+
+/**
+ * @brief Decode the next piece of the body, in whatever pieces it arrives
+ *
+ * @return ESP_OK if all of it was taken,
+ *         ESP_ERR_INVALID_SIZE if the decoded body does not fit the buffer (what fits is kept),
+ *         ESP_ERR_INVALID_RESPONSE if the stream is corrupt or not in the encoding it claims
+ */
+esp_err_t spotify_inflate_feed(spotify_inflate_t *inflate, const uint8_t *in, size_t len);
+
+/**
+ * @brief Whether the end of the compressed stream, including its checksum, has been seen
+ */
+bool spotify_inflate_done(const spotify_inflate_t *inflate);
+
+/**
+ * @brief Bytes of decoded body in the output buffer so far
+ */
+size_t spotify_inflate_out_len(const spotify_inflate_t *inflate);
@@ -0,0 +1,162 @@
+#include <sys/param.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "spotify_limiter.h"
+#include "spotify_client.h"
+#include "trace.h"
+
+#define TAG "SPOTIFY_LIMITER"
+
+#define LIMITER_TOKEN             1000 // one request, the bucket counts in thousandths
+#define LIMITER_MIN_RATE_PER_MIN  6    // never slow down below one request every 10 s
+#define LIMITER_RATE_STEP_PER_MIN (CONFIG_SPOTIFY_RATE_MAX_PER_MIN / 16 + 1) // won back per successful response
+#define LIMITER_BACKOFF_BASE_MS   500  // first backoff when a 429 or 5xx has no Retry-After
+#define LIMITER_BACKOFF_MAX_EXP   6    // backoff doubles up to 32 s
+#define LIMITER_CANCEL_POLL_MS    50   // a waiting request looks for cancellation this often
+
+_Static_assert(CONFIG_SPOTIFY_RATE_BURST >= 2, "background requests need two tokens in the bucket");
+
+static SemaphoreHandle_t limiter_mutex = NULL;
+static int32_t tokens;           // thousandths of a request
+static uint32_t rate_per_min;
+static int64_t last_refill_us;
+static int64_t blocked_until_us; // Retry-After or backoff deadline
+static uint8_t backoff_exp;
+static uint8_t users_waiting;
+static spotify_limiter_stats_t counters;
+
+esp_err_t spotify_limiter_init(void)
+{
+    limiter_mutex = xSemaphoreCreateMutex();
+    if (limiter_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    tokens = CONFIG_SPOTIFY_RATE_BURST * LIMITER_TOKEN;
+    rate_per_min = CONFIG_SPOTIFY_RATE_MAX_PER_MIN;
+    last_refill_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+// Called with limiter_mutex held
+static void limiter_refill(int64_t now)
+{
+    const int32_t capacity = CONFIG_SPOTIFY_RATE_BURST * LIMITER_TOKEN;
+    int64_t add = (now - last_refill_us) * rate_per_min / 60000;
+    if (tokens + add >= capacity) {
+        tokens = capacity;
+        last_refill_us = now;
+    } else if (add > 0) {
+        tokens += add;
+        // Carry the fraction over instead of losing it to rounding
+        last_refill_us += add * 60000 / rate_per_min;
+    }
+}
+
+esp_err_t spotify_limiter_acquire(spotify_priority_t priority, const struct spotify_deadline *deadline)
+{
+    // Background requests leave one token spare for a tap, the Kconfig range keeps that within the bucket
+    const int32_t needed = priority == SPOTIFY_PRIORITY_USER ? LIMITER_TOKEN : 2 * LIMITER_TOKEN;
+    bool waiting = false;
+    esp_err_t result;
+
+    xSemaphoreTake(limiter_mutex, portMAX_DELAY);
+    while (1) {
+        // Superseded while in line: give the place up without spending a token
+        if (deadline != NULL && spotify_deadline_cancelled(deadline)) {
+            result = ESP_ERR_NOT_FINISHED;
+            break;
+        }
+        int64_t now = esp_timer_get_time();
+        limiter_refill(now);
+        bool blocked = now < blocked_until_us;
+        if (!blocked && tokens >= needed && (priority == SPOTIFY_PRIORITY_USER || users_waiting == 0)) {
+            tokens -= LIMITER_TOKEN;
+            counters.granted++;
+            result = ESP_OK;
+            break;
+        }
+        if (priority == SPOTIFY_PRIORITY_BACKGROUND) {
+            counters.deferred++;
+            result = ESP_ERR_TIMEOUT;
+            break;
+        }
+
+        // Sleep until the token or the Retry-After is due, or give up now if that's past the budget
+        int64_t wait_us = blocked ? blocked_until_us - now : (int64_t)(needed - tokens) * 60000 / rate_per_min;
+        if (deadline == NULL || now + wait_us > deadline->expires_us) {
+            counters.timed_out++;
+            result = ESP_ERR_TIMEOUT;
+            break;
+        }
+        // In slices, so a cancellation is noticed while the wait is still long
+        TickType_t wait = MIN(pdMS_TO_TICKS(wait_us / 1000) + 1, pdMS_TO_TICKS(LIMITER_CANCEL_POLL_MS));
+        if (!waiting) {
+            users_waiting++;
+            waiting = true;
+        }
+        xSemaphoreGive(limiter_mutex);
+        vTaskDelay(wait);
+        xSemaphoreTake(limiter_mutex, portMAX_DELAY);
+    }
+    if (waiting) {
+        users_waiting--;
+    }
+    xSemaphoreGive(limiter_mutex);
+    return result;
+}
+
+void spotify_limiter_note_response(int status_code, int retry_after_s)
+{
+    if (status_code <= 0) {
+        return; // no response, nothing learned about the server
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t delay_us = 0;
+
+    xSemaphoreTake(limiter_mutex, portMAX_DELAY);
+    if (status_code == 429 || status_code >= 500) {
+        if (retry_after_s > 0) {
+            delay_us = retry_after_s * 1000000LL;
+        } else {
+            delay_us = (LIMITER_BACKOFF_BASE_MS * 1000LL) << backoff_exp;
+        }
+        // Up to 25% extra so retries from both sides of a burst don't land on the same tick
+        delay_us += esp_random() % (uint32_t)(delay_us / 4 + 1);
+        if (backoff_exp < LIMITER_BACKOFF_MAX_EXP) {
+            backoff_exp++;
+        }
+        if (now + delay_us > blocked_until_us) {
+            blocked_until_us = now + delay_us;
+        }
+        if (status_code == 429) {
+            counters.rate_limited++;
+            rate_per_min = MAX(rate_per_min / 2, LIMITER_MIN_RATE_PER_MIN);
+            tokens = 0;
+        }
+    } else {
+        backoff_exp = 0;
+        rate_per_min = MIN(rate_per_min + LIMITER_RATE_STEP_PER_MIN, CONFIG_SPOTIFY_RATE_MAX_PER_MIN);
+    }
+    uint32_t rate = rate_per_min;
+    xSemaphoreGive(limiter_mutex);
+
+    if (delay_us > 0) {
+        TRACE(SPOTIFY_BACKOFF, status_code, delay_us / 1000);
+        ESP_LOGW(TAG, "HTTP %d, holding requests for %" PRId64 " ms, rate %" PRIu32 "/min",
+                 status_code, delay_us / 1000, rate);
+    }
+}
+
+void spotify_limiter_get_stats(spotify_limiter_stats_t *stats)
+{
+    xSemaphoreTake(limiter_mutex, portMAX_DELAY);
+    *stats = counters;
+    stats->rate_per_min = rate_per_min;
+    stats->blocked_until_us = blocked_until_us;
+    xSemaphoreGive(limiter_mutex);
+}
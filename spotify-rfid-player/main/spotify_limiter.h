@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+/**
+ * @brief Who a Spotify Web API call is for
+ */
+typedef enum {
+    SPOTIFY_PRIORITY_USER,       /*!< Card taps and REST API commands: waits for a token */
+    SPOTIFY_PRIORITY_BACKGROUND, /*!< State polling: only runs on spare tokens and never waits */
+} spotify_priority_t;
+
+/**
+ * @brief Limiter counters, for diagnostics
+ */
+typedef struct {
+    uint32_t rate_per_min;     /*!< Current refill rate */
+    uint32_t granted;          /*!< Requests let through */
+    uint32_t deferred;         /*!< Background requests skipped for lack of spare tokens */
+    uint32_t timed_out;        /*!< User requests that gave up waiting */
+    uint32_t rate_limited;     /*!< 429 responses seen */
+    int64_t blocked_until_us;  /*!< esp_timer time until which no request is sent */
+} spotify_limiter_stats_t;
+
+/**
+ * @brief Create the shared token bucket
+ *
+ * The bucket holds CONFIG_SPOTIFY_RATE_BURST tokens and refills at up to
+ * CONFIG_SPOTIFY_RATE_MAX_PER_MIN. Every 429 halves the refill rate and each
+ * successful response adds a little back, so sustained traffic settles just
+ * under whatever rate Spotify currently allows.
+ */
+esp_err_t spotify_limiter_init(void);
+
+struct spotify_deadline; // spotify_client.h
+
+/**
+ * @brief Take a token before sending a request to api.spotify.com
+ *
+ * User requests wait for a token, or for a Retry-After to pass, as long as
+ * the deadline's budget allows. The wait ends early when the deadline is
+ * cancelled, so a superseded tap doesn't hold on to its place in line.
+ * Background requests leave one token spare for taps and return immediately
+ * if none is free, or while a user request is waiting.
+ *
+ * @param deadline Budget of the operation, or NULL to not wait at all
+ * @return ESP_OK if the request may be sent, ESP_ERR_NOT_FINISHED if the
+ *         deadline was cancelled, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t spotify_limiter_acquire(spotify_priority_t priority, const struct spotify_deadline *deadline);
+
+/**
+ * @brief Feed a response back into the limiter
+ *
+ * @param status_code HTTP status of the response
+ * @param retry_after_s Value of the Retry-After header, or 0 if there was none.
+ *        Without it, 429 and 5xx responses back off exponentially with jitter.
+ */
+void spotify_limiter_note_response(int status_code, int retry_after_s);
+
+/**
+ * @brief Copy the limiter counters
+ */
+void spotify_limiter_get_stats(spotify_limiter_stats_t *stats);
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "tap_buffer.h"
+
+#define TAP_KIND_BIT(kind) (1UL << ((kind) & 31))
+
+void tap_buffer_init(tap_buffer_t *buf)
+{
+    memset(buf, 0, sizeof(*buf));
+}
+
+bool tap_buffer_push(tap_buffer_t *buf, const tap_buffer_item_t *item)
+{
+    bool kept_all = true;
+    if (buf->count == TAP_BUFFER_CAPACITY) {
+        buf->head = (buf->head + 1) % TAP_BUFFER_CAPACITY;
+        buf->count--;
+        buf->dropped++;
+        kept_all = false;
+    }
+    buf->items[(buf->head + buf->count) % TAP_BUFFER_CAPACITY] = *item;
+    buf->count++;
+    return kept_all;
+}
+
+size_t tap_buffer_drain(tap_buffer_t *buf, tap_buffer_item_t *out, size_t out_len,
+                        uint32_t supersede_mask, uint32_t coalesce_mask,
+                        int64_t now_us, int64_t max_age_us)
+{
+    // Find where replay starts: the latest superseding item, if any
+    size_t start = 0;
+    for (size_t i = 0; i < buf->count; i++) {
+        const tap_buffer_item_t *item = &buf->items[(buf->head + i) % TAP_BUFFER_CAPACITY];
+        if (TAP_KIND_BIT(item->kind) & supersede_mask) {
+            start = i;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = start; i < buf->count && n < out_len; i++) {
+        const tap_buffer_item_t *item = &buf->items[(buf->head + i) % TAP_BUFFER_CAPACITY];
+        if (max_age_us > 0 && now_us - item->queued_us > max_age_us) {
+            continue;
+        }
+        if (TAP_KIND_BIT(item->kind) & coalesce_mask) {
+            // Skip it if a later item of the same kind follows
+            bool superseded = false;
+            for (size_t j = i + 1; j < buf->count; j++) {
+                if (buf->items[(buf->head + j) % TAP_BUFFER_CAPACITY].kind == item->kind) {
+                    superseded = true;
+                    break;
+                }
+            }
+            if (superseded) {
+                continue;
+            }
+        }
+        out[n++] = *item;
+    }
+
+    buf->head = 0;
+    buf->count = 0;
+    return n;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded buffer for commands issued while the network is down.
+ *
+ * Plain C with no ESP-IDF dependencies, so the same coalescing rules can be
+ * exercised on the host.
+ */
+
+#define TAP_BUFFER_CAPACITY    8
+#define TAP_BUFFER_PAYLOAD_LEN 24
+
+typedef struct {
+    uint8_t kind;                             // caller defined command kind, below 32
+    uint8_t payload[TAP_BUFFER_PAYLOAD_LEN];  // opaque command data
+    int64_t queued_us;                        // when the command was buffered
+} tap_buffer_item_t;
+
+typedef struct {
+    tap_buffer_item_t items[TAP_BUFFER_CAPACITY];
+    size_t head;      // oldest item
+    size_t count;
+    uint32_t dropped; // items overwritten because the buffer was full
+} tap_buffer_t;
+
+void tap_buffer_init(tap_buffer_t *buf);
+
+/**
+ * @brief Append an item, overwriting the oldest one when full
+ *
+ * @return false if an older item had to be dropped
+ */
+bool tap_buffer_push(tap_buffer_t *buf, const tap_buffer_item_t *item);
+
+/**
+ * @brief Empty the buffer into the list of commands worth replaying
+ *
+ * Items older than max_age_us are discarded. Everything before the latest
+ * item whose kind is in supersede_mask (e.g. "play") is discarded, since that
+ * item replaces them. Of the remaining items, kinds in coalesce_mask (e.g.
+ * "volume") only keep their latest instance. Order is preserved.
+ *
+ * @return Number of items written to out
+ */
+size_t tap_buffer_drain(tap_buffer_t *buf, tap_buffer_item_t *out, size_t out_len,
+                        uint32_t supersede_mask, uint32_t coalesce_mask,
+                        int64_t now_us, int64_t max_age_us);
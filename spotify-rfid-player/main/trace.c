@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "trace.h"
+
+typedef struct {
+    uint32_t timestamp_us; // low 32 bits of esp_timer, wraps every ~71 minutes
+    uint16_t event;
+    uint16_t reserved;
+    uint32_t args[2];
+} trace_entry_t;
+
+static const char *const trace_names[TRACE_EVENT_COUNT] = {
+#define TRACE_EVENT_NAME(name, level, format) #name,
+    TRACE_EVENTS(TRACE_EVENT_NAME)
+#undef TRACE_EVENT_NAME
+};
+
+static const char *const trace_formats[TRACE_EVENT_COUNT] = {
+#define TRACE_EVENT_FORMAT(name, level, format) format,
+    TRACE_EVENTS(TRACE_EVENT_FORMAT)
+#undef TRACE_EVENT_FORMAT
+};
+
+static trace_entry_t trace_ring[CONFIG_TRACE_BUFFER_ENTRIES];
+static uint32_t trace_written = 0; // events ever recorded, the next slot is trace_written % size
+static uint32_t trace_cleared = 0; // events before this index were dropped by ?clear=1
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void trace_record(trace_event_t event, uint32_t a0, uint32_t a1)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    taskENTER_CRITICAL(&trace_lock);
+    trace_entry_t *entry = &trace_ring[trace_written % CONFIG_TRACE_BUFFER_ENTRIES];
+    entry->timestamp_us = now;
+    entry->event = event;
+    entry->args[0] = a0;
+    entry->args[1] = a1;
+    trace_written++;
+    taskEXIT_CRITICAL(&trace_lock);
+}
+
+// Copy one entry out, unless it has been overwritten since the dump started
+static bool trace_read(uint32_t index, trace_entry_t *out)
+{
+    bool valid;
+    taskENTER_CRITICAL(&trace_lock);
+    valid = index >= trace_cleared && trace_written - index <= CONFIG_TRACE_BUFFER_ENTRIES;
+    if (valid) {
+        *out = trace_ring[index % CONFIG_TRACE_BUFFER_ENTRIES];
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+    return valid;
+}
+
+// GET /debug/trace: the ring oldest first, formatted one line per event
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    char query[16];
+    char value[4];
+    bool clear = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                 httpd_query_key_value(query, "clear", value, sizeof(value)) == ESP_OK &&
+                 value[0] == '1';
+
+    taskENTER_CRITICAL(&trace_lock);
+    uint32_t end = trace_written;
+    uint32_t start = trace_cleared;
+    taskEXIT_CRITICAL(&trace_lock);
+    uint32_t lost = 0;
+    if (end - start > CONFIG_TRACE_BUFFER_ENTRIES) {
+        lost = end - start - CONFIG_TRACE_BUFFER_ENTRIES;
+        start = end - CONFIG_TRACE_BUFFER_ENTRIES;
+    }
+
+    httpd_resp_set_type(req, "text/plain");
+    char line[128];
+    snprintf(line, sizeof(line), "# %" PRIu32 " events, %" PRIu32 " overwritten, level %d\n",
+             end - start, lost, CONFIG_TRACE_LEVEL);
+    esp_err_t err = httpd_resp_sendstr_chunk(req, line);
+
+    trace_entry_t entry;
+    for (uint32_t i = start; i != end && err == ESP_OK; i++) {
+        if (!trace_read(i, &entry) || entry.event >= TRACE_EVENT_COUNT) {
+            continue;
+        }
+        int len = snprintf(line, sizeof(line), "%10" PRIu32 " %-17s ", entry.timestamp_us, trace_names[entry.event]);
+        if (len > 0 && len < sizeof(line)) {
+            len += snprintf(line + len, sizeof(line) - len, trace_formats[entry.event], entry.args[0], entry.args[1]);
+        }
+        if (len >= sizeof(line) - 1) {
+            len = sizeof(line) - 2;
+        }
+        line[len] = '\n';
+        line[len + 1] = '\0';
+        err = httpd_resp_sendstr_chunk(req, line);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    if (clear) {
+        taskENTER_CRITICAL(&trace_lock);
+        trace_cleared = end;
+        taskEXIT_CRITICAL(&trace_lock);
+    }
+    return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+esp_err_t trace_register_handlers(httpd_handle_t server)
+{
+    httpd_uri_t trace_uri = {
+        .uri = "/debug/trace",
+        .method = HTTP_GET,
+        .handler = trace_get_handler,
+        .user_ctx = NULL};
+    return httpd_register_uri_handler(server, &trace_uri);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+#define TRACE_LEVEL_ERROR   1
+#define TRACE_LEVEL_WARN    2
+#define TRACE_LEVEL_INFO    3
+#define TRACE_LEVEL_DEBUG   4
+#define TRACE_LEVEL_VERBOSE 5
+
+/**
+ * @brief Trace event table: X(name, level, format)
+ *
+ * Each event carries up to two 32-bit arguments. The format is only applied
+ * when the ring is dumped, so it costs nothing on the recording side.
+ */
+#define TRACE_EVENTS(X) \
+    X(HTTP_ERROR,        TRACE_LEVEL_ERROR,   "err=0x%" PRIx32) \
+    X(HTTP_CONNECTED,    TRACE_LEVEL_DEBUG,   "") \
+    X(HTTP_HEADER_SENT,  TRACE_LEVEL_VERBOSE, "") \
+    X(HTTP_HEADER,       TRACE_LEVEL_VERBOSE, "key_len=%" PRIu32 " value_len=%" PRIu32) \
+    X(HTTP_DATA,         TRACE_LEVEL_DEBUG,   "len=%" PRIu32 " total=%" PRIu32) \
+    X(HTTP_FINISH,       TRACE_LEVEL_INFO,    "status=%" PRIu32 " len=%" PRIu32) \
+    X(HTTP_DISCONNECTED, TRACE_LEVEL_DEBUG,   "status=%" PRIu32) \
+    X(SPOTIFY_REQUEST,   TRACE_LEVEL_INFO,    "method=%" PRIu32 " body_len=%" PRIu32) \
+    X(SPOTIFY_RESPONSE,  TRACE_LEVEL_INFO,    "status=%" PRIu32 " elapsed_us=%" PRIu32) \
+    X(SPOTIFY_FAILED,    TRACE_LEVEL_ERROR,   "err=0x%" PRIx32 " elapsed_us=%" PRIu32) \
+    X(SPOTIFY_DEADLINE,  TRACE_LEVEL_WARN,    "cancelled=%" PRIu32 " left_ms=%" PRIu32) \
+    X(SPOTIFY_BACKOFF,   TRACE_LEVEL_WARN,    "status=%" PRIu32 " hold_ms=%" PRIu32) \
+    X(TAP_UART,          TRACE_LEVEL_INFO,    "uid=%08" PRIx32 " len=%" PRIu32) \
+    X(PLAYBACK_UNKNOWN,  TRACE_LEVEL_INFO,    "uid=%08" PRIx32) \
+    X(PLAYBACK_PLAYED,   TRACE_LEVEL_INFO,    "uid=%08" PRIx32 " status=%" PRIu32) \
+    X(PLAYBACK_BATCH,    TRACE_LEVEL_INFO,    "tracks=%" PRIu32 " requests=%" PRIu32) \
+    X(ALBUM_ART,         TRACE_LEVEL_INFO,    "uri_hash=%08" PRIx32 " elapsed_us=%" PRIu32) \
+    X(TOKEN_RECEIVED,    TRACE_LEVEL_INFO,    "expires_in=%" PRIu32 " refresh=%" PRIu32)
+
+typedef enum {
+#define TRACE_EVENT_ENUM(name, level, format) TRACE_##name,
+    TRACE_EVENTS(TRACE_EVENT_ENUM)
+#undef TRACE_EVENT_ENUM
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+enum {
+#define TRACE_EVENT_LEVEL(name, level, format) TRACE_LEVEL_OF_##name = level,
+    TRACE_EVENTS(TRACE_EVENT_LEVEL)
+#undef TRACE_EVENT_LEVEL
+};
+
+/**
+ * @brief Record an event, filtered at compile time against CONFIG_TRACE_LEVEL
+ *
+ * Events above the configured level compile to nothing. Recording takes a
+ * timestamp and copies 16 bytes into the ring; nothing is formatted.
+ */
+#define TRACE(name, a0, a1)                                                     \
+    do {                                                                        \
+        if (TRACE_LEVEL_OF_##name <= CONFIG_TRACE_LEVEL) {                      \
+            trace_record(TRACE_##name, (uint32_t)(a0), (uint32_t)(a1));         \
+        }                                                                       \
+    } while (0)
+
+/**
+ * @brief Pack the first four bytes of a card UID into one trace argument
+ */
+#define TRACE_UID32(uid) \
+    (((uint32_t)(uid)[0] << 24) | ((uint32_t)(uid)[1] << 16) | ((uint32_t)(uid)[2] << 8) | (uid)[3])
+
+/**
+ * @brief Append one event to the trace ring, overwriting the oldest when full
+ *
+ * Safe to call from any task. Use the TRACE() macro rather than calling this directly.
+ */
+void trace_record(trace_event_t event, uint32_t a0, uint32_t a1);
+
+/**
+ * @brief Register the GET /debug/trace handler on the given server
+ *
+ * The handler formats the ring oldest first as plain text, one event per line.
+ * Add ?clear=1 to empty the ring after the dump.
+ */
+esp_err_t trace_register_handlers(httpd_handle_t server);
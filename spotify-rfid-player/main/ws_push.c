@@ -0,0 +1,326 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "playback.h"
+#include "album_art.h"
+#include "health.h"
+#include "auth_pipeline.h"
+#include "ws_push.h"
+
+#define TAG "WS_PUSH"
+
+#define WS_PUSH_FRAME_SIZE      1024 // per client, a full snapshot with every string escaped fits
+#define WS_PUSH_RECV_MAX        128  // longest client frame accepted, clients aren't expected to talk
+#define WS_PUSH_SEND_TIMEOUT_MS 200  // a client that can't take a frame this fast is dropped
+#define WS_PUSH_TASK_STACK_SIZE 3072
+
+// Everything a client can be told about, compared field by field
+typedef struct {
+    playback_state_t playback;
+    size_t mood_count;
+    palette_color_t mood[PALETTE_MAX_COLORS];
+    uint32_t heap_free_kb;
+    uint32_t heap_min_kb;
+    auth_pipeline_state_t auth;
+} ws_push_snapshot_t;
+
+typedef struct {
+    int fd;                     // -1 when the slot is free
+    bool in_flight;             // frame is queued on the server task, which owns it until the send is done
+    bool synced;                // sent holds what the client was last told
+    ws_push_snapshot_t sent;
+    size_t frame_len;
+    char frame[WS_PUSH_FRAME_SIZE];
+} ws_push_client_t;
+
+// Bounded writer for one JSON object, overflow is sticky
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool first;
+} ws_push_writer_t;
+
+static httpd_handle_t ws_server = NULL;
+static TaskHandle_t push_task = NULL;
+static SemaphoreHandle_t clients_mutex = NULL;
+static ws_push_client_t clients[CONFIG_WS_PUSH_MAX_CLIENTS];
+
+static void ws_push_raw(ws_push_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void ws_push_raw(ws_push_writer_t *w, const char *fmt, ...)
+{
+    if (w->len >= w->size) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    w->len += vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+    va_end(args);
+}
+
+static void ws_push_key(ws_push_writer_t *w, const char *key)
+{
+    ws_push_raw(w, "%s\"%s\":", w->first ? "{" : ",", key);
+    w->first = false;
+}
+
+static void ws_push_string(ws_push_writer_t *w, const char *key, const char *value)
+{
+    ws_push_key(w, key);
+    ws_push_raw(w, "\"");
+    for (const char *c = value; *c != '\0' && w->len < w->size; c++) {
+        if (*c == '"' || *c == '\\') {
+            ws_push_raw(w, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            ws_push_raw(w, "\\u%04x", (unsigned char)*c);
+        } else {
+            w->buf[w->len++] = *c;
+        }
+    }
+    ws_push_raw(w, "\"");
+}
+
+// Only the fields that differ from old, or all of them if full; 0 if nothing changed or it didn't fit
+static size_t ws_push_diff(const ws_push_snapshot_t *old, const ws_push_snapshot_t *now, bool full,
+                           char *buf, size_t size)
+{
+    ws_push_writer_t w = {
+        .buf = buf,
+        .size = size,
+        .first = true,
+    };
+    const playback_state_t *a = &old->playback;
+    const playback_state_t *b = &now->playback;
+
+    if (full || a->is_playing != b->is_playing) {
+        ws_push_key(&w, "is_playing");
+        ws_push_raw(&w, b->is_playing ? "true" : "false");
+    }
+    if (full || a->has_uid != b->has_uid || memcmp(a->uid, b->uid, PLAYBACK_UID_LEN) != 0) {
+        ws_push_key(&w, "uid");
+        if (b->has_uid) {
+            ws_push_raw(&w, "\"%02X%02X%02X%02X\"", b->uid[0], b->uid[1], b->uid[2], b->uid[3]);
+        } else {
+            ws_push_raw(&w, "null");
+        }
+    }
+    if (full || strcmp(a->context_uri, b->context_uri) != 0) {
+        ws_push_string(&w, "context_uri", b->context_uri);
+    }
+    if (full || strcmp(a->label, b->label) != 0) {
+        ws_push_string(&w, "label", b->label);
+    }
+    if (full || a->volume_percent != b->volume_percent) {
+        ws_push_key(&w, "volume");
+        ws_push_raw(&w, "%d", b->volume_percent);
+    }
+    if (full || a->last_result != b->last_result) {
+        ws_push_string(&w, "last_result", esp_err_to_name(b->last_result));
+    }
+    if (full || a->online != b->online) {
+        ws_push_key(&w, "online");
+        ws_push_raw(&w, b->online ? "true" : "false");
+    }
+    if (full || old->mood_count != now->mood_count ||
+        memcmp(old->mood, now->mood, now->mood_count * sizeof(now->mood[0])) != 0) {
+        ws_push_key(&w, "mood");
+        ws_push_raw(&w, "[");
+        for (size_t i = 0; i < now->mood_count; i++) {
+            const uint8_t *rgb = now->mood[i].rgb;
+            ws_push_raw(&w, "%s\"#%02x%02x%02x\"", i > 0 ? "," : "", rgb[0], rgb[1], rgb[2]);
+        }
+        ws_push_raw(&w, "]");
+    }
+    if (full || old->auth != now->auth) {
+        ws_push_string(&w, "auth", auth_pipeline_state_name(now->auth));
+    }
+    if (full || old->heap_free_kb != now->heap_free_kb) {
+        ws_push_key(&w, "heap_free_kb");
+        ws_push_raw(&w, "%lu", (unsigned long)now->heap_free_kb);
+    }
+    if (full || old->heap_min_kb != now->heap_min_kb) {
+        ws_push_key(&w, "heap_min_kb");
+        ws_push_raw(&w, "%lu", (unsigned long)now->heap_min_kb);
+    }
+
+    if (w.first) {
+        return 0;
+    }
+    ws_push_raw(&w, "}");
+    if (w.len >= w.size) {
+        ESP_LOGW(TAG, "State does not fit a %u byte frame", (unsigned)size);
+        return 0;
+    }
+    return w.len;
+}
+
+static void ws_push_take_snapshot(ws_push_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    playback_get_state(&snapshot->playback);
+    snapshot->mood_count = album_art_get_mood(snapshot->mood);
+    auth_pipeline_status_t auth;
+    auth_pipeline_get_status(&auth);
+    snapshot->auth = auth.state;
+    health_summary_t health;
+    if (health_get_summary(&health) == ESP_OK) {
+        snapshot->heap_free_kb = health.free_heap / 1024;
+        snapshot->heap_min_kb = health.min_free_heap / 1024;
+    }
+}
+
+// Runs on the server task, which is the only one allowed to write to its sockets
+static void ws_push_send_work(void *arg)
+{
+    ws_push_client_t *client = arg;
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)client->frame,
+        .len = client->frame_len,
+    };
+    int fd = client->fd;
+    esp_err_t err = httpd_ws_send_frame_async(ws_server, fd, &frame);
+
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    client->in_flight = false;
+    if (err != ESP_OK && client->fd == fd) {
+        client->fd = -1;
+    }
+    xSemaphoreGive(clients_mutex);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Client %d too slow or gone, closing: %s", fd, esp_err_to_name(err));
+        httpd_sess_trigger_close(ws_server, fd);
+    }
+}
+
+static void ws_push_task(void *arg)
+{
+    static ws_push_snapshot_t now;
+    bool idle = true;
+    while (1) {
+        // Asleep until someone connects, then one look per interval
+        ulTaskNotifyTake(pdTRUE, idle ? portMAX_DELAY : pdMS_TO_TICKS(CONFIG_WS_PUSH_INTERVAL_MS));
+        ws_push_take_snapshot(&now);
+
+        idle = true;
+        xSemaphoreTake(clients_mutex, portMAX_DELAY);
+        for (size_t i = 0; i < CONFIG_WS_PUSH_MAX_CLIENTS; i++) {
+            ws_push_client_t *client = &clients[i];
+            if (client->fd < 0) {
+                continue;
+            }
+            idle = false;
+            if (client->in_flight) {
+                continue; // still on its last frame, it gets everything since then in one go
+            }
+            if (httpd_ws_get_fd_info(ws_server, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+                ESP_LOGI(TAG, "Client %d disconnected", client->fd);
+                client->fd = -1;
+                continue;
+            }
+            size_t len = ws_push_diff(&client->sent, &now, !client->synced, client->frame, sizeof(client->frame));
+            if (len == 0) {
+                continue;
+            }
+            client->frame_len = len;
+            client->in_flight = true;
+            if (httpd_queue_work(ws_server, ws_push_send_work, client) == ESP_OK) {
+                client->sent = now;
+                client->synced = true;
+            } else {
+                client->in_flight = false;
+            }
+        }
+        xSemaphoreGive(clients_mutex);
+    }
+}
+
+// Take a slot for a fresh connection, false if they are all in use
+static bool ws_push_claim(int fd)
+{
+    ws_push_client_t *slot = NULL;
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < CONFIG_WS_PUSH_MAX_CLIENTS; i++) {
+        // A reused descriptor means the old client is gone, its slot starts over
+        if (clients[i].fd == fd) {
+            slot = &clients[i];
+            break;
+        }
+        if (slot == NULL && clients[i].fd < 0 && !clients[i].in_flight) {
+            slot = &clients[i];
+        }
+    }
+    if (slot != NULL) {
+        slot->fd = fd;
+        slot->synced = false;
+    }
+    xSemaphoreGive(clients_mutex);
+    return slot != NULL;
+}
+
+static esp_err_t ws_push_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET) {
+        // Handshake done: take a slot, or close the connection if there is none
+        int fd = httpd_req_to_sockfd(req);
+        if (!ws_push_claim(fd)) {
+            ESP_LOGW(TAG, "All %d client slots in use, refusing %d", CONFIG_WS_PUSH_MAX_CLIENTS, fd);
+            return ESP_FAIL;
+        }
+        // Sends to this client give up quickly instead of blocking the server task
+        struct timeval timeout = {
+            .tv_sec = 0,
+            .tv_usec = WS_PUSH_SEND_TIMEOUT_MS * 1000,
+        };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        ESP_LOGI(TAG, "Client %d connected", fd);
+        xTaskNotifyGive(push_task);
+        return ESP_OK;
+    }
+
+    // Nothing is expected from clients, read whatever comes to keep the socket drained
+    uint8_t payload[WS_PUSH_RECV_MAX];
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (frame.len > sizeof(payload)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    frame.payload = payload;
+    return httpd_ws_recv_frame(req, &frame, sizeof(payload));
+}
+
+esp_err_t ws_push_register_handlers(httpd_handle_t server)
+{
+    if (push_task == NULL) {
+        clients_mutex = xSemaphoreCreateMutex();
+        if (clients_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        for (size_t i = 0; i < CONFIG_WS_PUSH_MAX_CLIENTS; i++) {
+            clients[i].fd = -1;
+        }
+        if (xTaskCreate(ws_push_task, "ws_push", WS_PUSH_TASK_STACK_SIZE, NULL, 3, &push_task) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ws_server = server;
+
+    httpd_uri_t ws_uri = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = ws_push_handler,
+        .user_ctx = NULL,
+        .is_websocket = true,
+    };
+    return httpd_register_uri_handler(server, &ws_uri);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+/**
+ * @brief Register the GET /ws push channel on the given server and start its task
+ *
+ * Each client gets one JSON text frame with the full state when it connects,
+ * then only the fields that changed: playback state, the album art mood
+ * palette, the authorization progress and a heap summary. Changes are collected every
+ * CONFIG_WS_PUSH_INTERVAL_MS, so a burst of updates goes out as one frame.
+ *
+ * There are CONFIG_WS_PUSH_MAX_CLIENTS slots, each with its own send buffer
+ * and at most one frame in flight. A client that is still busy with its last
+ * frame is skipped and catches up with a single combined diff later, and one
+ * that can't take a frame within a short send timeout is disconnected, so a
+ * slow client never holds up the server task. Frames from clients are read
+ * and dropped.
+ */
+esp_err_t ws_push_register_handlers(httpd_handle_t server);